@@ -0,0 +1,56 @@
+#include <stdlib.h>
+
+#include "bloom.h"
+
+// the word a hash selects, from its low bits
+static size_t bloom_word(BloomFilter* filter, uint64_t hash) {
+	return hash & (filter->num_words - 1);
+}
+
+// the bits a hash sets in its word, from BLOOM_HASH_BITS 6-bit fields of its high bits
+static uint64_t bloom_mask(uint64_t hash) {
+	uint64_t mask = 0;
+	for (int k = 0; k < BLOOM_HASH_BITS; k++)
+		mask |= (uint64_t) 1 << ((hash >> (64 - 6 * (k + 1))) & 63);
+	return mask;
+}
+
+/*
+ * bloom_init(BloomFilter* filter, size_t expected_keys)
+ * Gives filter an empty bit array sized for expected_keys keys.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int bloom_init(BloomFilter* filter, size_t expected_keys) {
+	size_t num_words = 1;
+	while (num_words * 64 < expected_keys * BLOOM_BITS_PER_KEY)
+		num_words *= 2;
+	filter->words = calloc(num_words, sizeof *filter->words);
+	filter->num_words = filter->words ? num_words : 0;
+	return filter->words ? 0 : -1;
+}
+
+void bloom_add(BloomFilter* filter, uint64_t hash) {
+	filter->words[bloom_word(filter, hash)] |= bloom_mask(hash);
+}
+
+/*
+ * bloom_select(BloomFilter* filter, const uint64_t* hashes, size_t n, uint32_t* selected)
+ * Writes the indexes of the hashes that may have been added to selected and returns their
+ * count. The loop has no branches: every index is written and the count only advances past
+ * the ones that pass, so a batch runs at the same speed whatever its hit rate.
+ */
+size_t bloom_select(BloomFilter* filter, const uint64_t* hashes, size_t n, uint32_t* selected) {
+	size_t k = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t mask = bloom_mask(hashes[i]);
+		selected[k] = i;
+		k += (filter->words[bloom_word(filter, hashes[i])] & mask) == mask;
+	}
+	return k;
+}
+
+void bloom_free(BloomFilter* filter) {
+	free(filter->words);
+	filter->words = NULL;
+	filter->num_words = 0;
+}
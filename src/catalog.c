@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "cs165_api.h"
+#include "utils.h"
+
+/*
+ * Catalog of the current db.
+ * Every table and column is interned under its fully qualified name in an open-addressing
+ * hash table (linear probing, power of two capacity, at most half full), so resolving a
+ * name from a query is one hash and usually one string compare. Entries point straight
+ * at the Table and Column structs; both arrays are allocated at full capacity when the
+ * table is created, so the pointers stay valid until the db is freed.
+ */
+
+static CatalogEntry* entries = NULL;
+static size_t catalog_capacity = 0;
+static size_t catalog_size = 0;
+
+static CatalogEntry* probe(CatalogEntry* table, size_t capacity, const char* name, uint32_t h) {
+	size_t mask = capacity - 1;
+	for (size_t i = h & mask;; i = (i + 1) & mask) {
+		CatalogEntry* entry = &table[i];
+		if (entry->name[0] == '\0'
+				|| (entry->hash == h && strcmp(entry->name, name) == 0))
+			return entry;
+	}
+}
+
+static int grow() {
+	size_t new_capacity = catalog_capacity ? catalog_capacity * 2 : CATALOG_BASE_CAPACITY;
+	CatalogEntry* new_entries = calloc(new_capacity, sizeof *new_entries);
+	if (!new_entries)
+		return -1;
+
+	for (size_t i = 0; i < catalog_capacity; i++) {
+		if (entries[i].name[0] == '\0')
+			continue;
+		*probe(new_entries, new_capacity, entries[i].name, entries[i].hash) = entries[i];
+	}
+	free(entries);
+	entries = new_entries;
+	catalog_capacity = new_capacity;
+	return 0;
+}
+
+static int insert(const char* name, Table* table, Column* column) {
+	if ((catalog_size + 1) * 2 > catalog_capacity && grow() < 0)
+		return -1;
+
+	uint32_t h = hash_string(name);
+	CatalogEntry* entry = probe(entries, catalog_capacity, name, h);
+	if (entry->name[0] == '\0') {
+		strcpy(entry->name, name);
+		entry->hash = h;
+		catalog_size++;
+	}
+	entry->table = table;
+	entry->column = column;
+	return 0;
+}
+
+void catalog_clear() {
+	free(entries);
+	entries = NULL;
+	catalog_capacity = 0;
+	catalog_size = 0;
+}
+
+int catalog_add_table(Db* db, Table* table) {
+	char name[MAX_SIZE_QUALIFIED_NAME];
+	snprintf(name, sizeof name, "%s.%s", db->name, table->name);
+	return insert(name, table, NULL);
+}
+
+int catalog_add_column(Db* db, Table* table, Column* column) {
+	char name[MAX_SIZE_QUALIFIED_NAME];
+	snprintf(name, sizeof name, "%s.%s.%s", db->name, table->name, column->name);
+	return insert(name, table, column);
+}
+
+// replaces the catalog with the tables and columns of db, e.g. after it is loaded from disk
+int catalog_build(Db* db) {
+	catalog_clear();
+	for (size_t i = 0; i < db->tables_size; i++) {
+		Table* table = &db->tables[i];
+		if (catalog_add_table(db, table) < 0)
+			return -1;
+		for (size_t j = 0; j < table->columns_size; j++)
+			if (catalog_add_column(db, table, &table->columns[j]) < 0)
+				return -1;
+	}
+	return 0;
+}
+
+/*
+ * catalog_find(const char* name)
+ * Returns the entry for a fully qualified table or column name, or NULL if the current
+ * db has no such table or column.
+ */
+CatalogEntry* catalog_find(const char* name) {
+	if (!entries)
+		return NULL;
+	CatalogEntry* entry = probe(entries, catalog_capacity, name, hash_string(name));
+	return entry->name[0] == '\0' ? NULL : entry;
+}
@@ -2,75 +2,45 @@
 #define _X_OPEN_SOURCE
 #include <string.h>
 
+#include "catalog.h"
 #include "client_context.h"
+#include "result_pool.h"
+#include "utils.h"
 
 /*
  * checks if table with table_name already exists in db with db_name
  */
 bool table_exists(char* db_name, char* table_name) {
-	if (!current_db || strcmp(current_db->name, db_name) != 0)
-		return false;
-	for (size_t i = 0; i < current_db->tables_size; i++)
-		if (strcmp(current_db->tables[i].name, table_name) == 0) 
-			return true; 
-
-	return false;
+	char name[MAX_SIZE_QUALIFIED_NAME];
+	snprintf(name, sizeof name, "%s.%s", db_name, table_name);
+	return lookup_table(name) != NULL;
 }
 
 /*
  * checks if a column with this name in specified table already exists
  */
 bool column_exists(char* db_name, char* table_name, char* column_name) {
-	if (!current_db || strcmp(current_db->name, db_name) != 0)
-		return false;
-
-	for (size_t i = 0; i < current_db->tables_size; i++) {
-		if (strcmp(current_db->tables[i].name, table_name) == 0) {
-			Table* table = &current_db->tables[i];
-			for (size_t j = 0; j < table->columns_size; j++) 
-				if (strcmp(table->columns[j].name, column_name) == 0)
-					return true;
-		}
-	}
-	return false;
+	char name[MAX_SIZE_QUALIFIED_NAME];
+	snprintf(name, sizeof name, "%s.%s.%s", db_name, table_name, column_name);
+	return lookup_column(name) != NULL;
 }
 
 /*
  * lookup_table(char* name)
- * Returns pointer to a Table given fully qualified column name
+ * Returns pointer to a Table given fully qualified table name
  */
 Table* lookup_table(char *name) {
-	char* name_copy = strdup(name);
-	char* db_name = strsep(&name_copy, "."); // advance name to just the table_name 
-	if (strcmp(db_name, current_db->name) != 0)
-		return NULL;
-
-	for (size_t i = 0; i < current_db->tables_size; i++) {
-		if (strcmp(current_db->tables[i].name, name_copy) == 0) {
-			return &current_db->tables[i];
-		}
-	}
-	return NULL;
+	CatalogEntry* entry = catalog_find(name);
+	return entry && !entry->column ? entry->table : NULL;
 }
 
 /*
  * lookup_table_for_column(char* name)
  * Returns pointer to table that has column with column name
  */
-
 Table* lookup_table_for_column(char* name) {
-	char* name_copy = strdup(name);
-	char* db_name = strsep(&name_copy, ".");
-	char* table_name = strsep(&name_copy, ".");
-	if (!db_name || !table_name) {
-		return NULL;
-	}
-	char* db_table_name = (char*) malloc(strlen(db_name) + strlen(table_name) + 1);
-	strcpy(db_table_name, db_name);
-	strcat(db_table_name, ".");
-	strcat(db_table_name, table_name);
-
-	return lookup_table(db_table_name);
+	CatalogEntry* entry = catalog_find(name);
+	return entry && entry->column ? entry->table : NULL;
 }
 
 /*
@@ -78,77 +48,146 @@ Table* lookup_table_for_column(char* name) {
  * Returns pointer to a Column given fully qualified column name
  */
 Column* lookup_column(char* name) {
-	char* name_copy = strdup(name);
-	char* db_name = strsep(&name_copy, ".");
-	char* table_name = strsep(&name_copy, ".");
-	if (!db_name || !table_name) {
-		return NULL;
-	}
-	char* db_table_name = (char*) malloc(strlen(db_name) + strlen(table_name) + 1);
-	strcpy(db_table_name, db_name);
-	strcat(db_table_name, ".");
-	strcat(db_table_name, table_name);
+	CatalogEntry* entry = catalog_find(name);
+	return entry ? entry->column : NULL;
+}
 
-	Table* table = lookup_table(db_table_name);
-	if (!table || !name_copy) 
-		return NULL;
-	
-	for (size_t i = 0; i < table->columns_size; i++) {
-		if (strcmp(table->columns[i].name, name_copy) == 0) {
-			return &table->columns[i];
-		}
+// returns the slot holding handle, or the free slot where it would be inserted
+static GeneralizedColumnHandle* probe_handle(GeneralizedColumnHandle* table, int slots,
+		const char* handle, uint32_t h) {
+	int mask = slots - 1;
+	for (int i = h & mask;; i = (i + 1) & mask) {
+		GeneralizedColumnHandle* slot = &table[i];
+		if (slot->name[0] == '\0' || (slot->hash == h && strcmp(slot->name, handle) == 0))
+			return slot;
 	}
+}
 
-	return NULL;
+static int grow_handles(ClientContext* context) {
+	int new_slots = context->chandle_slots * 2;
+	GeneralizedColumnHandle* new_table = calloc(new_slots, sizeof *new_table);
+	if (!new_table)
+		return -1;
+
+	for (int i = 0; i < context->chandle_slots; i++) {
+		GeneralizedColumnHandle* slot = &context->chandle_table[i];
+		if (slot->name[0] != '\0')
+			*probe_handle(new_table, new_slots, slot->name, slot->hash) = *slot;
+	}
+	free(context->chandle_table);
+	context->chandle_table = new_table;
+	context->chandle_slots = new_slots;
+	return 0;
 }
 
 /*
  * lookup_client_handle(char* handle_name)
- * Returns pointer to a Handle given fully qualified column name
+ * Returns pointer to a Handle given its name, or NULL if the client has no such handle.
+ * The pointer is valid until the next add_handle or remove_handle.
  */
 GeneralizedColumnHandle* lookup_client_handle(ClientContext* context, char* handle) {
-	for (int i = 0; i < context->chandles_in_use; i++) {
-		if (strcmp(context->chandle_table[i].name, handle) == 0) {
-			return &context->chandle_table[i];
-		}
-	}
-	return NULL;
+	GeneralizedColumnHandle* slot = probe_handle(context->chandle_table,
+			context->chandle_slots, handle, hash_string(handle));
+	return slot->name[0] == '\0' ? NULL : slot;
 }
 
 /*
  * add_handle(ClientContext* context, char* handle, bool result)
+ * Adds a handle to the client's handle map, growing it as needed. Re-assigning an
+ * existing handle keeps its single entry, whose value the executed operator replaces.
  * Returns 0 on success, -1 on failure
  */
 int add_handle(ClientContext* context, char* handle, bool result) {
-	if (context->chandles_in_use == context->chandle_slots) {
-		// cannot attach another handle
+	size_t length = strlen(handle);
+	if (length == 0 || length >= HANDLE_MAX_SIZE)
+		return -1;
+	if ((context->chandles_in_use + 1) * 2 > context->chandle_slots
+			&& grow_handles(context) < 0)
 		return -1;
-	}
 
-	GeneralizedColumnHandle new_handle;
-	for (int i = 0; i < HANDLE_MAX_SIZE; i++) {
-		new_handle.name[i] = '\0';
-	}
-	strncpy(new_handle.name, handle, strlen(handle));
-	new_handle.generalized_column.column_type = result ? RESULT : COLUMN; 
-	context->chandle_table[context->chandles_in_use] = new_handle;
-	context->chandles_in_use++;
+	uint32_t h = hash_string(handle);
+	GeneralizedColumnHandle* slot = probe_handle(context->chandle_table,
+			context->chandle_slots, handle, h);
+	if (slot->name[0] != '\0')
+		return 0;
 
+	memcpy(slot->name, handle, length + 1);
+	slot->hash = h;
+	slot->generalized_column.column_type = result ? RESULT : VECTOR; 
+	slot->generalized_column.column_pointer.vector = NULL;
+	context->chandles_in_use++;
 	return 0;
 }
 
 /*
  * remove_handle(ClientContext* context, char* handle)
- *
+ * Removes the handle, shifting back the entries of its probe sequence so that no
+ * tombstones are needed.
  */
 int remove_handle(ClientContext* context, char* handle) {
-	for (int i = 0; i < context->chandles_in_use; i++) {
-		if (strncmp(context->chandle_table[i].name, handle, strlen(handle)) == 0) {
-			for (int j = i; j < context->chandles_in_use - 1; j++)
-				context->chandle_table[j] = context->chandle_table[j+1];
-			context->chandles_in_use--;
-		}		
+	GeneralizedColumnHandle* table = context->chandle_table;
+	int mask = context->chandle_slots - 1;
+	GeneralizedColumnHandle* slot = probe_handle(table, context->chandle_slots, handle,
+			hash_string(handle));
+	if (slot->name[0] == '\0')
+		return 0;
+	release_generalized_column(&slot->generalized_column);
+
+	int hole = slot - table;
+	for (int i = (hole + 1) & mask; table[i].name[0] != '\0'; i = (i + 1) & mask) {
+		// move an entry into the hole unless its home slot lies cyclically in (hole, i]
+		int home = table[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			table[hole] = table[i];
+			hole = i;
+		}
 	}
+	table[hole].name[0] = '\0';
+	context->chandles_in_use--;
 	return 0;
 }
 
+/*
+ * assign_handle(ClientContext* context, char* handle, GeneralizedColumn value)
+ * Points an existing handle at value, taking a reference to it and releasing the value
+ * the handle referred to before.
+ * Returns the handle, or NULL if the client has no such handle.
+ */
+GeneralizedColumnHandle* assign_handle(ClientContext* context, char* handle,
+		GeneralizedColumn value) {
+	GeneralizedColumnHandle* slot = lookup_client_handle(context, handle);
+	if (!slot)
+		return NULL;
+
+	retain_generalized_column(&value);
+	release_generalized_column(&slot->generalized_column);
+	slot->generalized_column = value;
+	return slot;
+}
+
+GeneralizedColumnHandle* assign_vector_to_handle(Vector* vec, char* handle, ClientContext* context) {
+	GeneralizedColumn value;
+	value.column_type = VECTOR;
+	value.column_pointer.vector = vec;
+	return assign_handle(context, handle, value);
+}
+
+// returns the vector a handle refers to, or NULL if there is no such handle or it holds a result
+Vector* lookup_vector(ClientContext* context, char* handle) {
+	GeneralizedColumnHandle* slot = lookup_client_handle(context, handle);
+	if (!slot || slot->generalized_column.column_type != VECTOR)
+		return NULL;
+	return slot->generalized_column.column_pointer.vector;
+}
+
+/*
+ * free_client_context(ClientContext* context)
+ * Releases every value the client's handles refer to and frees the context.
+ */
+void free_client_context(ClientContext* context) {
+	for (int i = 0; i < context->chandle_slots; i++)
+		if (context->chandle_table[i].name[0] != '\0')
+			release_generalized_column(&context->chandle_table[i].generalized_column);
+	free(context->chandle_table);
+	free(context);
+}
@@ -0,0 +1,579 @@
+#include <string.h>
+
+#include "compression.h"
+#include "cs165_api.h"
+#include "data_types.h"
+#include "db_core_utils.h"
+#include "storage.h"
+#include "utils.h"
+
+/*
+ * Lightweight column compression.
+ * Base columns are encoded with frame-of-reference (FOR) bit-packing, dictionary
+ * encoding (bit-packed codes into a sorted dictionary) or run-length encoding (RLE),
+ * whichever is smallest. Selects, fetches and aggregates run directly on the encoded
+ * form; any operation that mutates the column decompresses it first. Operators that
+ * need the plain values of a compressed column decode them into a buffer of their own.
+ */
+
+static int bits_needed(uint32_t range) {
+	int bits = 0;
+	while (range) {
+		bits++;
+		range >>= 1;
+	}
+	return bits;
+}
+
+// one extra word so that unpacking the last value may always read packed[w + 1]
+static size_t packed_words(size_t num_values, int bit_width) {
+	return (num_values * bit_width + 63) / 64 + 1;
+}
+
+static void pack_value(uint64_t* packed, size_t i, int bit_width, uint32_t value) {
+	if (!bit_width)
+		return;
+	size_t bit = i * bit_width;
+	size_t w = bit >> 6;
+	unsigned s = bit & 63;
+	packed[w] |= (uint64_t) value << s;
+	if (s + bit_width > 64)
+		packed[w + 1] |= (uint64_t) value >> (64 - s);
+}
+
+static uint32_t unpack_value(const uint64_t* packed, size_t i, int bit_width) {
+	if (!bit_width)
+		return 0;
+	size_t bit = i * bit_width;
+	size_t w = bit >> 6;
+	unsigned s = bit & 63;
+	uint64_t v = (packed[w] >> s) | ((packed[w + 1] << 1) << (63 - s));
+	return (uint32_t) (v & ((1ULL << bit_width) - 1));
+}
+
+// Unpacks count values starting at index start into out.
+// The loop body is branch-free so that it is auto-vectorized when built with O=3.
+static void unpack_range(const uint64_t* packed, int bit_width, size_t start, size_t count,
+		uint32_t* out) {
+	if (!bit_width) {
+		memset(out, 0, count * sizeof *out);
+		return;
+	}
+	uint64_t mask = (1ULL << bit_width) - 1;
+	for (size_t i = 0; i < count; i++) {
+		size_t bit = (start + i) * bit_width;
+		size_t w = bit >> 6;
+		unsigned s = bit & 63;
+		out[i] = (uint32_t) (((packed[w] >> s) | ((packed[w + 1] << 1) << (63 - s))) & mask);
+	}
+}
+
+// returns index of the run containing position pos
+static size_t find_run(CompressedColumn* cc, size_t pos) {
+	size_t lo = 0;
+	size_t hi = cc->num_runs - 1;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ((size_t) cc->run_ends[mid] <= pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static Status encode_packed(Column* col, CompressedColumn* cc, CompressionType type) {
+	Status ret_status;
+	cc->num_words = packed_words(col->length, cc->bit_width);
+	cc->packed = calloc(cc->num_words, sizeof *cc->packed);
+	if (!cc->packed) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
+
+	for (size_t i = 0; i < col->length; i++) {
+		uint32_t code = type == FOR
+			? (uint32_t) ((long) col->data[i] - cc->min)
+			: (uint32_t) lower_bound(cc->dict, cc->dict_size, col->data[i]);
+		pack_value(cc->packed, i, cc->bit_width, code);
+	}
+
+	ret_status.code = OK;
+	return ret_status;
+}
+
+static Status encode_rle(Column* col, CompressedColumn* cc) {
+	Status ret_status;
+	cc->run_values = malloc(sizeof *cc->run_values * cc->num_runs);
+	cc->run_ends = malloc(sizeof *cc->run_ends * cc->num_runs);
+	if (!cc->run_values || !cc->run_ends) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
+
+	size_t run = 0;
+	cc->run_values[0] = col->data[0];
+	for (size_t i = 1; i < col->length; i++) {
+		if (col->data[i] != col->data[i-1]) {
+			cc->run_ends[run++] = i;
+			cc->run_values[run] = col->data[i];
+		}
+	}
+	cc->run_ends[run] = col->length;
+
+	ret_status.code = OK;
+	return ret_status;
+}
+
+/*
+ * compress_column(Column* col)
+ * Picks the smallest of FOR, dictionary and RLE encodings for the column and replaces
+ * its data with the encoded form. Columns for which no encoding is smaller than the raw
+ * data, or which have an index pointing into their data, are left uncompressed. Only int
+ * columns are compressed.
+ */
+Status compress_column(Column* col) {
+	Status ret_status;
+	ret_status.code = OK;
+	if (col->compression != UNCOMPRESSED || col->index || col->length == 0 || col->type != INT)
+		return ret_status;
+
+	size_t n = col->length;
+	int min = col->data[0];
+	int max = col->data[0];
+	size_t num_runs = 1;
+	for (size_t i = 1; i < n; i++) {
+		if (col->data[i] < min)
+			min = col->data[i];
+		if (col->data[i] > max)
+			max = col->data[i];
+		if (col->data[i] != col->data[i-1])
+			num_runs++;
+	}
+
+	int* sorted_copy = malloc(sizeof *sorted_copy * n);
+	if (!sorted_copy) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
+	memcpy(sorted_copy, col->data, sizeof *sorted_copy * n);
+	qsort(sorted_copy, n, sizeof *sorted_copy, compare_ints);
+	size_t num_distinct = 1;
+	for (size_t i = 1; i < n; i++)
+		if (sorted_copy[i] != sorted_copy[num_distinct - 1])
+			sorted_copy[num_distinct++] = sorted_copy[i];
+
+	int for_width = bits_needed((uint32_t) ((long) max - min));
+	int dict_width = bits_needed(num_distinct - 1);
+
+	size_t raw_size = n * sizeof(int);
+	size_t for_size = packed_words(n, for_width) * sizeof(uint64_t);
+	size_t dict_size = num_distinct <= MAX_DICTIONARY_SIZE
+		? num_distinct * sizeof(int) + packed_words(n, dict_width) * sizeof(uint64_t)
+		: raw_size;
+	size_t rle_size = num_runs * 2 * sizeof(int);
+
+	CompressionType type = UNCOMPRESSED;
+	size_t best_size = raw_size;
+	if (for_size < best_size) {
+		type = FOR;
+		best_size = for_size;
+	}
+	if (dict_size < best_size) {
+		type = DICTIONARY;
+		best_size = dict_size;
+	}
+	if (rle_size < best_size) {
+		type = RLE;
+		best_size = rle_size;
+	}
+
+	if (type == UNCOMPRESSED) {
+		free(sorted_copy);
+		return ret_status;
+	}
+
+	CompressedColumn* cc = calloc(1, sizeof *cc);
+	if (!cc) {
+		free(sorted_copy);
+		ret_status.code = ERROR;
+		return ret_status;
+	}
+	cc->min = min;
+	cc->max = max;
+
+	switch (type) {
+		case FOR:
+			free(sorted_copy);
+			cc->bit_width = for_width;
+			ret_status = encode_packed(col, cc, FOR);
+			break;
+		case DICTIONARY:
+			cc->dict = realloc(sorted_copy, sizeof *cc->dict * num_distinct);
+			cc->dict_size = num_distinct;
+			cc->bit_width = dict_width;
+			ret_status = encode_packed(col, cc, DICTIONARY);
+			break;
+		default:
+			free(sorted_copy);
+			cc->num_runs = num_runs;
+			ret_status = encode_rle(col, cc);
+			break;
+	}
+
+	col->compression = type;
+	col->compressed = cc;
+	if (ret_status.code != OK) {
+		log_err("Could not compress column %s.\n", col->name);
+		free_compressed_column(col);
+		return ret_status;
+	}
+
+	free_column_data(col);
+
+	log_info("COMPRESSED COLUMN %s: %zu bytes -> %zu bytes\n", col->name, raw_size, best_size);
+	return ret_status;
+}
+
+/*
+ * decompress_column(Column* col)
+ * Restores the raw data array of a compressed column so it can be modified in place.
+ */
+Status decompress_column(Column* col) {
+	Status ret_status;
+	ret_status.code = OK;
+	if (col->compression == UNCOMPRESSED)
+		return ret_status;
+
+	size_t capacity = col->capacity > col->length ? col->capacity : col->length;
+	if (capacity == 0)
+		capacity = COLUMN_BASE_CAPACITY;
+
+	if (alloc_column_data(col, capacity) < 0) {
+		log_err("Could not allocate memory to decompress column %s.\n", col->name);
+		ret_status.code = ERROR;
+		return ret_status;
+	}
+	decode_range(col, 0, col->length, col->data);
+
+	free_compressed_column(col);
+	return ret_status;
+}
+
+/*
+ * column_values(Column* col, Vector* values)
+ * Sets values to a view of the values of col, as column_vector does. A compressed column
+ * is decoded into a buffer owned by the view, which must be released with
+ * free_column_values; the column itself stays compressed. Returns 0 on success, -1 if
+ * out of memory.
+ */
+int column_values(Column* col, Vector* values) {
+	*values = column_vector(col);
+	if (col->compression == UNCOMPRESSED)
+		return 0;
+
+	values->data = malloc(sizeof *values->data * (col->length ? col->length : 1));
+	if (!values->data) {
+		log_err("Could not allocate memory to decode column %s.\n", col->name);
+		return -1;
+	}
+	decode_range(col, 0, col->length, values->data);
+	values->capacity = col->length;
+	return 0;
+}
+
+void free_column_values(Column* col, Vector* values) {
+	if (values->data != col->data)
+		free(values->data);
+	values->data = NULL;
+}
+
+// compresses each column of a table, unless one of its columns is indexed
+void compress_table(Table* table) {
+	for (size_t i = 0; i < table->columns_size; i++)
+		if (table->columns[i].index)
+			return;
+
+	for (size_t i = 0; i < table->columns_size; i++)
+		compress_column(&table->columns[i]);
+}
+
+void decompress_table(Table* table) {
+	for (size_t i = 0; i < table->columns_size; i++)
+		decompress_column(&table->columns[i]);
+}
+
+void free_compressed_column(Column* col) {
+	CompressedColumn* cc = col->compressed;
+	if (cc) {
+		free(cc->packed);
+		free(cc->dict);
+		free(cc->run_values);
+		free(cc->run_ends);
+		free(cc);
+	}
+	col->compressed = NULL;
+	col->compression = UNCOMPRESSED;
+}
+
+/*
+ * decode_range(Column* col, size_t start, size_t count, int* out)
+ * Writes the values at positions [start, start + count) of a compressed column to out.
+ */
+void decode_range(Column* col, size_t start, size_t count, int* out) {
+	CompressedColumn* cc = col->compressed;
+	uint32_t* codes = (uint32_t*) out;
+
+	switch (col->compression) {
+		case FOR:
+			unpack_range(cc->packed, cc->bit_width, start, count, codes);
+			for (size_t i = 0; i < count; i++)
+				out[i] = (int) ((long) cc->min + codes[i]);
+			break;
+		case DICTIONARY:
+			unpack_range(cc->packed, cc->bit_width, start, count, codes);
+			for (size_t i = 0; i < count; i++)
+				out[i] = cc->dict[codes[i]];
+			break;
+		case RLE: {
+			if (count == 0)
+				break;
+			size_t run = find_run(cc, start);
+			for (size_t i = 0; i < count; i++) {
+				if (start + i >= (size_t) cc->run_ends[run])
+					run++;
+				out[i] = cc->run_values[run];
+			}
+			break;
+		}
+		default:
+			memcpy(out, &col->data[start], count * sizeof *out);
+			break;
+	}
+}
+
+// scans bit-packed codes for lo <= code < hi, writing matching positions to out
+static size_t scan_packed(CompressedColumn* cc, size_t length, uint64_t lo, uint64_t hi,
+		int* out) {
+	if (hi <= lo)
+		return 0;
+
+	uint32_t codes[DECODE_BLOCK_SIZE];
+	uint64_t width = hi - lo;
+	size_t result_length = 0;
+	for (size_t i = 0; i < length; i += DECODE_BLOCK_SIZE) {
+		size_t n = length - i < DECODE_BLOCK_SIZE ? length - i : DECODE_BLOCK_SIZE;
+		unpack_range(cc->packed, cc->bit_width, i, n, codes);
+		for (size_t j = 0; j < n; j++) {
+			out[result_length] = i + j;
+			result_length += (uint64_t) codes[j] - lo < width;
+		}
+	}
+	return result_length;
+}
+
+/*
+ * select_compressed(Column* col, int low, int high, Vector* result)
+ * Writes positions of values in [low, high) to result without decompressing the column.
+ * The bounds are translated into code space so that the scan compares codes directly.
+ */
+void select_compressed(Column* col, int low, int high, Vector* result) {
+	CompressedColumn* cc = col->compressed;
+	size_t result_length = 0;
+
+	switch (col->compression) {
+		case FOR: {
+			uint64_t lo = low <= cc->min ? 0 : (uint64_t) ((long) low - cc->min);
+			uint64_t hi = high <= cc->min ? 0 : (uint64_t) ((long) high - cc->min);
+			result_length = scan_packed(cc, col->length, lo, hi, result->data);
+			break;
+		}
+		case DICTIONARY: {
+			uint64_t lo = lower_bound(cc->dict, cc->dict_size, low);
+			uint64_t hi = lower_bound(cc->dict, cc->dict_size, high);
+			result_length = scan_packed(cc, col->length, lo, hi, result->data);
+			break;
+		}
+		case RLE: {
+			size_t run_start = 0;
+			for (size_t r = 0; r < cc->num_runs; r++) {
+				if (cc->run_values[r] >= low && cc->run_values[r] < high)
+					for (size_t p = run_start; p < (size_t) cc->run_ends[r]; p++)
+						result->data[result_length++] = p;
+				run_start = cc->run_ends[r];
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	result->length = result_length;
+}
+
+/*
+ * fetch_compressed(Column* col, Vector* positions, Vector* result)
+ * Gathers the values at the given positions of a compressed column into result.
+ */
+void fetch_compressed(Column* col, Vector* positions, Vector* result) {
+	CompressedColumn* cc = col->compressed;
+
+	switch (col->compression) {
+		case FOR:
+			for (size_t i = 0; i < positions->length; i++)
+				result->data[i] = (int) ((long) cc->min
+						+ unpack_value(cc->packed, positions->data[i], cc->bit_width));
+			break;
+		case DICTIONARY:
+			for (size_t i = 0; i < positions->length; i++)
+				result->data[i] = cc->dict[unpack_value(cc->packed, positions->data[i],
+						cc->bit_width)];
+			break;
+		case RLE: {
+			// positions are usually sorted, so only search when we leave the current run
+			size_t run = 0;
+			for (size_t i = 0; i < positions->length; i++) {
+				size_t p = positions->data[i];
+				size_t run_start = run == 0 ? 0 : (size_t) cc->run_ends[run - 1];
+				if (p < run_start || p >= (size_t) cc->run_ends[run])
+					run = find_run(cc, p);
+				result->data[i] = cc->run_values[run];
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	result->length = positions->length;
+}
+
+long sum_compressed(Column* col) {
+	CompressedColumn* cc = col->compressed;
+	long sum = 0;
+
+	switch (col->compression) {
+		case FOR: {
+			uint32_t codes[DECODE_BLOCK_SIZE];
+			for (size_t i = 0; i < col->length; i += DECODE_BLOCK_SIZE) {
+				size_t n = col->length - i < DECODE_BLOCK_SIZE ? col->length - i : DECODE_BLOCK_SIZE;
+				unpack_range(cc->packed, cc->bit_width, i, n, codes);
+				for (size_t j = 0; j < n; j++)
+					sum += codes[j];
+			}
+			sum += (long) cc->min * (long) col->length;
+			break;
+		}
+		case DICTIONARY: {
+			// count occurrences of each code, then weight each dictionary entry once
+			long* counts = calloc(cc->dict_size, sizeof *counts);
+			uint32_t codes[DECODE_BLOCK_SIZE];
+			for (size_t i = 0; i < col->length; i += DECODE_BLOCK_SIZE) {
+				size_t n = col->length - i < DECODE_BLOCK_SIZE ? col->length - i : DECODE_BLOCK_SIZE;
+				unpack_range(cc->packed, cc->bit_width, i, n, codes);
+				for (size_t j = 0; j < n; j++)
+					counts[codes[j]]++;
+			}
+			for (int d = 0; d < cc->dict_size; d++)
+				sum += counts[d] * cc->dict[d];
+			free(counts);
+			break;
+		}
+		case RLE: {
+			size_t run_start = 0;
+			for (size_t r = 0; r < cc->num_runs; r++) {
+				sum += (long) cc->run_values[r] * (long) (cc->run_ends[r] - run_start);
+				run_start = cc->run_ends[r];
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return sum;
+}
+
+Status write_compressed_column(FILE* f, Column* col) {
+	Status ret_status;
+	CompressedColumn* cc = col->compressed;
+
+	fwrite(cc, sizeof *cc, 1, f);
+	switch (col->compression) {
+		case DICTIONARY:
+			fwrite(cc->dict, sizeof *cc->dict, cc->dict_size, f);
+			fwrite(cc->packed, sizeof *cc->packed, cc->num_words, f);
+			break;
+		case FOR:
+			fwrite(cc->packed, sizeof *cc->packed, cc->num_words, f);
+			break;
+		case RLE:
+			fwrite(cc->run_values, sizeof *cc->run_values, cc->num_runs, f);
+			fwrite(cc->run_ends, sizeof *cc->run_ends, cc->num_runs, f);
+			break;
+		default:
+			ret_status.code = ERROR;
+			return ret_status;
+	}
+
+	ret_status.code = OK;
+	return ret_status;
+}
+
+// reads count values of size bytes into a new array; returns NULL if they cannot be read
+static void* read_array(FILE* f, size_t size, size_t count) {
+	void* array = malloc(size * (count ? count : 1));
+	if (array && fread(array, size, count, f) != count) {
+		free(array);
+		return NULL;
+	}
+	return array;
+}
+
+Status read_compressed_column(FILE* f, Column* col) {
+	Status ret_status;
+	ret_status.code = ERROR;
+	ret_status.error_message = "Could not read compressed column\n";
+	CompressedColumn* cc = malloc(sizeof *cc);
+	if (!cc)
+		return ret_status;
+	if (fread(cc, sizeof *cc, 1, f) != 1) {
+		free(cc);
+		return ret_status;
+	}
+	cc->packed = NULL;
+	cc->dict = NULL;
+	cc->run_values = NULL;
+	cc->run_ends = NULL;
+
+	bool read = false;
+	switch (col->compression) {
+		case DICTIONARY:
+			cc->dict = read_array(f, sizeof *cc->dict, cc->dict_size);
+			cc->packed = cc->dict ? read_array(f, sizeof *cc->packed, cc->num_words) : NULL;
+			read = cc->packed != NULL;
+			break;
+		case FOR:
+			cc->packed = read_array(f, sizeof *cc->packed, cc->num_words);
+			read = cc->packed != NULL;
+			break;
+		case RLE:
+			cc->run_values = read_array(f, sizeof *cc->run_values, cc->num_runs);
+			cc->run_ends = cc->run_values
+				? read_array(f, sizeof *cc->run_ends, cc->num_runs) : NULL;
+			read = cc->run_ends != NULL;
+			break;
+		default:
+			break;
+	}
+	if (!read) {
+		free(cc->dict);
+		free(cc->packed);
+		free(cc->run_values);
+		free(cc->run_ends);
+		free(cc);
+		return ret_status;
+	}
+
+	col->compressed = cc;
+	col->data = NULL;
+	ret_status.code = OK;
+	return ret_status;
+}
@@ -0,0 +1,276 @@
+#include <limits.h>
+#include <string.h>
+
+#include "compression.h"
+#include "cracking.h"
+#include "cs165_api.h"
+#include "db_core_utils.h"
+#include "utils.h"
+
+/*
+ * Database cracking.
+ * A cracker column is an unordered copy of a base column that each select partitions
+ * around its bounds. The resulting piece boundaries are recorded in the cracker index, so
+ * repeated range queries touch ever smaller pieces and converge toward a sorted index
+ * without ever paying for an upfront sort.
+ */
+
+CrackerColumn* alloc_cracker() {
+	CrackerColumn* cracker = calloc(1, sizeof *cracker);
+	if (!cracker)
+		return NULL;
+
+	cracker->pivots_capacity = DEFAULT_CRACKER_INDEX_CAPACITY;
+	cracker->pivots = malloc(sizeof *cracker->pivots * cracker->pivots_capacity);
+	cracker->starts = malloc(sizeof *cracker->starts * cracker->pivots_capacity);
+
+	cracker->pending_capacity = DEFAULT_CRACKER_UPDATE_CAPACITY;
+	cracker->pending_positions = malloc(sizeof *cracker->pending_positions
+			* cracker->pending_capacity);
+	cracker->pending_old_values = malloc(sizeof *cracker->pending_old_values
+			* cracker->pending_capacity);
+
+	if (!cracker->pivots || !cracker->starts || !cracker->pending_positions
+			|| !cracker->pending_old_values) {
+		free_cracker(cracker);
+		return NULL;
+	}
+	return cracker;
+}
+
+void free_cracker(CrackerColumn* cracker) {
+	if (!cracker)
+		return;
+	free(cracker->values);
+	free(cracker->positions);
+	free(cracker->pivots);
+	free(cracker->starts);
+	free(cracker->pending_positions);
+	free(cracker->pending_old_values);
+	free(cracker);
+}
+
+// drops all cracked state; the cracker is rebuilt from the base column by the next select
+void reset_cracker(CrackerColumn* cracker) {
+	cracker->length = 0;
+	cracker->num_pivots = 0;
+	cracker->num_pending = 0;
+}
+
+/*
+ * cracker_record_update(CrackerColumn* cracker, int position, int old_value)
+ * Remembers that the base column value at position changed so that the next select can
+ * move the entry to its new piece. Must be called before the base column is overwritten.
+ * Returns 0 on success, -1 on failure
+ */
+int cracker_record_update(CrackerColumn* cracker, int position, int old_value) {
+	if ((size_t) position >= cracker->length) // not merged yet, appends pick up new value
+		return 0;
+
+	if (cracker->num_pending == cracker->pending_capacity) {
+		int new_capacity = cracker->pending_capacity * 2;
+		int* new_positions = realloc(cracker->pending_positions,
+				sizeof *new_positions * new_capacity);
+		if (!new_positions)
+			return -1;
+		cracker->pending_positions = new_positions;
+		int* new_values = realloc(cracker->pending_old_values, sizeof *new_values * new_capacity);
+		if (!new_values)
+			return -1;
+		cracker->pending_old_values = new_values;
+		cracker->pending_capacity = new_capacity;
+	}
+	cracker->pending_positions[cracker->num_pending] = position;
+	cracker->pending_old_values[cracker->num_pending++] = old_value;
+	return 0;
+}
+
+// returns the piece holding value, i.e. the number of pivots <= value
+static int find_piece(CrackerColumn* cracker, int value) {
+	int lo = 0;
+	int hi = cracker->num_pivots;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (cracker->pivots[mid] <= value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static size_t piece_start(CrackerColumn* cracker, int piece) {
+	return piece == 0 ? 0 : cracker->starts[piece - 1];
+}
+
+static size_t piece_end(CrackerColumn* cracker, int piece) {
+	return piece == cracker->num_pivots ? cracker->length : cracker->starts[piece];
+}
+
+static void swap_entries(CrackerColumn* cracker, size_t i, size_t j) {
+	int value = cracker->values[i];
+	int position = cracker->positions[i];
+	cracker->values[i] = cracker->values[j];
+	cracker->positions[i] = cracker->positions[j];
+	cracker->values[j] = value;
+	cracker->positions[j] = position;
+}
+
+// Moves the entry at ix from piece `from` to piece `to` by swapping it with the entry at
+// the edge of each piece in between and shifting that piece boundary by one.
+static void ripple(CrackerColumn* cracker, size_t ix, int from, int to) {
+	while (from < to) {
+		size_t last = cracker->starts[from] - 1;
+		swap_entries(cracker, ix, last);
+		cracker->starts[from]--;
+		ix = last;
+		from++;
+	}
+	while (from > to) {
+		size_t first = cracker->starts[from - 1];
+		swap_entries(cracker, ix, first);
+		cracker->starts[from - 1]++;
+		ix = first;
+		from--;
+	}
+}
+
+static Status merge_updates(Column* col, CrackerColumn* cracker) {
+	Status ret_status;
+	for (int u = 0; u < cracker->num_pending; u++) {
+		int position = cracker->pending_positions[u];
+		// if a later update to the same position already moved the entry it is not found
+		// here, and it already holds the current value
+		int piece = find_piece(cracker, cracker->pending_old_values[u]);
+		size_t end = piece_end(cracker, piece);
+		for (size_t i = piece_start(cracker, piece); i < end; i++) {
+			if (cracker->positions[i] != position)
+				continue;
+
+			int value;
+			decode_range(col, position, 1, &value);
+			cracker->values[i] = value;
+			ripple(cracker, i, piece, find_piece(cracker, value));
+			break;
+		}
+	}
+	cracker->num_pending = 0;
+
+	ret_status.code = OK;
+	return ret_status;
+}
+
+static Status merge_appends(Column* col, CrackerColumn* cracker) {
+	Status ret_status;
+	if (col->length > cracker->capacity) {
+		size_t new_capacity = cracker->capacity ? cracker->capacity : COLUMN_BASE_CAPACITY;
+		while (new_capacity < col->length)
+			new_capacity *= 2;
+		int* new_values = realloc(cracker->values, sizeof *new_values * new_capacity);
+		if (!new_values) {
+			ret_status.code = ERROR;
+			return ret_status;
+		}
+		cracker->values = new_values;
+		int* new_positions = realloc(cracker->positions, sizeof *new_positions * new_capacity);
+		if (!new_positions) {
+			ret_status.code = ERROR;
+			return ret_status;
+		}
+		cracker->positions = new_positions;
+		cracker->capacity = new_capacity;
+	}
+
+	size_t old_length = cracker->length;
+	decode_range(col, old_length, col->length - old_length, &cracker->values[old_length]);
+	for (size_t i = old_length; i < col->length; i++) {
+		cracker->positions[i] = i;
+		cracker->length++;
+		ripple(cracker, i, cracker->num_pivots, find_piece(cracker, cracker->values[i]));
+	}
+
+	ret_status.code = OK;
+	return ret_status;
+}
+
+static int grow_cracker_index(CrackerColumn* cracker) {
+	int new_capacity = cracker->pivots_capacity * 2;
+	int* new_pivots = realloc(cracker->pivots, sizeof *new_pivots * new_capacity);
+	if (!new_pivots)
+		return -1;
+	cracker->pivots = new_pivots;
+	size_t* new_starts = realloc(cracker->starts, sizeof *new_starts * new_capacity);
+	if (!new_starts)
+		return -1;
+	cracker->starts = new_starts;
+	cracker->pivots_capacity = new_capacity;
+	return 0;
+}
+
+// Partitions the piece holding pivot around it and records the new boundary.
+// Returns the index of the first entry >= pivot.
+static size_t crack(CrackerColumn* cracker, int pivot, Status* status) {
+	int piece = find_piece(cracker, pivot);
+	if (piece > 0 && cracker->pivots[piece - 1] == pivot)
+		return cracker->starts[piece - 1];
+
+	size_t i = piece_start(cracker, piece);
+	size_t j = piece_end(cracker, piece);
+	while (i < j) {
+		if (cracker->values[i] < pivot) {
+			i++;
+		} else {
+			j--;
+			swap_entries(cracker, i, j);
+		}
+	}
+
+	if (cracker->num_pivots == cracker->pivots_capacity && grow_cracker_index(cracker) < 0) {
+		status->code = ERROR;
+		return i;
+	}
+
+	int n = cracker->num_pivots - piece;
+	memmove(&cracker->pivots[piece + 1], &cracker->pivots[piece], sizeof *cracker->pivots * n);
+	memmove(&cracker->starts[piece + 1], &cracker->starts[piece], sizeof *cracker->starts * n);
+	cracker->pivots[piece] = pivot;
+	cracker->starts[piece] = i;
+	cracker->num_pivots++;
+	return i;
+}
+
+/*
+ * select_cracker(Column* col, int low, int high, Vector* result, Status* status)
+ * Selects positions of values in [low, high) using the column's cracker, cracking it
+ * on both bounds. Pending updates and appends are merged into the cracker first.
+ * Positions are returned in sorted order, like a scan would produce them.
+ */
+void select_cracker(Column* col, int low, int high, Vector* result, Status* status) {
+	CrackerColumn* cracker = col->cracker;
+	if (cracker->length > col->length)
+		reset_cracker(cracker);
+
+	*status = merge_updates(col, cracker);
+	if (status->code != OK)
+		return;
+	*status = merge_appends(col, cracker);
+	if (status->code != OK) {
+		log_err("Could not merge appended rows into cracker of column %s.\n", col->name);
+		return;
+	}
+
+	result->length = 0;
+	if (high <= low)
+		return;
+
+	size_t from = low == INT_MIN ? 0 : crack(cracker, low, status);
+	size_t to = crack(cracker, high, status);
+	if (status->code != OK)
+		return;
+
+	memcpy(result->data, &cracker->positions[from], sizeof *result->data * (to - from));
+	result->length = to - from;
+	qsort(result->data, result->length, sizeof *result->data, compare_ints);
+
+	status->code = OK;
+}
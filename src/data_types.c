@@ -0,0 +1,401 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cs165_api.h"
+#include "data_types.h"
+
+/*
+ * Typed column kernels.
+ * Every kernel is written once as a macro and instantiated for each DataType through
+ * FOR_EACH_DATA_TYPE, so each type gets its own monomorphic loop the compiler can
+ * vectorize. The dispatchers below pick the instance for a column's type.
+ */
+
+/*
+ * Negation as division by -1 defines it: integers wrap around in their unsigned type, so
+ * INT_MIN / -1 is INT_MIN (and LONG_MIN / -1 is LONG_MIN) rather than signed overflow.
+ */
+static inline int negate_INT(int x) {
+	return (int) (0u - (unsigned int) x);
+}
+
+static inline long negate_LONG(long x) {
+	return (long) (0ul - (unsigned long) x);
+}
+
+static inline float negate_FLOAT(float x) {
+	return -x;
+}
+
+#define DEFINE_KERNELS(TYPE, ctype, field, sum_type, format) \
+size_t select_scan_##TYPE(const ctype* data, size_t start, size_t end, ctype low, ctype high, \
+		int* out) { \
+	size_t k = 0; \
+	for (size_t i = start; i < end; i++) { /* branch-free: always write, advance on match */ \
+		out[k] = i; \
+		k += (data[i] >= low) & (data[i] < high); \
+	} \
+	return k; \
+} \
+\
+size_t select_fetch_scan_##TYPE(const int* positions, const ctype* values, size_t n, \
+		ctype low, ctype high, int* out) { \
+	size_t k = 0; \
+	for (size_t i = 0; i < n; i++) { \
+		out[k] = positions[i]; \
+		k += (values[i] >= low) & (values[i] < high); \
+	} \
+	return k; \
+} \
+\
+void gather_##TYPE(const ctype* data, const int* positions, size_t n, ctype* out) { \
+	for (size_t i = 0; i < n; i++) \
+		out[i] = data[positions[i]]; \
+} \
+\
+void gather_prefetch_##TYPE(const ctype* data, const int* positions, size_t n, ctype* out) { \
+	for (size_t i = 0; i < n; i++) { \
+		if (i + GATHER_PREFETCH_DISTANCE < n) \
+			__builtin_prefetch(&data[positions[i + GATHER_PREFETCH_DISTANCE]]); \
+		out[i] = data[positions[i]]; \
+	} \
+} \
+\
+void gather_scatter_##TYPE(const ctype* data, const int* positions, const int* order, \
+		size_t n, ctype* out) { \
+	for (size_t i = 0; i < n; i++) { \
+		if (i + GATHER_PREFETCH_DISTANCE < n) \
+			__builtin_prefetch(&data[positions[i + GATHER_PREFETCH_DISTANCE]]); \
+		out[order[i]] = data[positions[i]]; \
+	} \
+} \
+\
+sum_type sum_##TYPE(const ctype* data, size_t n) { \
+	sum_type sum = 0; \
+	for (size_t i = 0; i < n; i++) \
+		sum += data[i]; \
+	return sum; \
+} \
+\
+ctype min_##TYPE(const ctype* data, size_t n) { \
+	ctype min = data[0]; \
+	for (size_t i = 1; i < n; i++) \
+		min = data[i] < min ? data[i] : min; \
+	return min; \
+} \
+\
+ctype max_##TYPE(const ctype* data, size_t n) { \
+	ctype max = data[0]; \
+	for (size_t i = 1; i < n; i++) \
+		max = data[i] > max ? data[i] : max; \
+	return max; \
+} \
+\
+void add_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out) { \
+	for (size_t i = 0; i < n; i++) \
+		out[i] = a[i] + b[i]; \
+} \
+\
+void sub_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out) { \
+	for (size_t i = 0; i < n; i++) \
+		out[i] = a[i] - b[i]; \
+} \
+\
+void mul_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out) { \
+	for (size_t i = 0; i < n; i++) \
+		out[i] = a[i] * b[i]; \
+} \
+\
+bool div_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out) { \
+	bool divisible = true; \
+	for (size_t i = 0; i < n; i++) { /* -1 is a negation, so INT_MIN / -1 does not trap */ \
+		divisible &= b[i] != 0; \
+		out[i] = b[i] == -1 ? negate_##TYPE(a[i]) : a[i] / (b[i] != 0 ? b[i] : 1); \
+	} \
+	return divisible; \
+}
+
+FOR_EACH_DATA_TYPE(DEFINE_KERNELS)
+
+size_t data_type_size(DataType type) {
+	switch (type) {
+#define SIZE_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: return sizeof(ctype);
+		FOR_EACH_DATA_TYPE(SIZE_CASE)
+#undef SIZE_CASE
+	}
+	return sizeof(int);
+}
+
+// parses the optional type argument of create(col,...); returns 0 on success, -1 otherwise
+int parse_data_type(char* token, DataType* type) {
+	if (strcmp(token, "int") == 0)
+		*type = INT;
+	else if (strcmp(token, "long") == 0)
+		*type = LONG;
+	else if (strcmp(token, "float") == 0)
+		*type = FLOAT;
+	else
+		return -1;
+	return 0;
+}
+
+/*
+ * parse_value(char* token, DataType type, Value* value)
+ * Parses token as a value of the given type, ignoring surrounding whitespace.
+ * Returns 0 on success, -1 if token is not a valid value of that type.
+ */
+int parse_value(char* token, DataType type, Value* value) {
+	char* end;
+	errno = 0;
+	switch (type) {
+		case INT: {
+			long l = strtol(token, &end, 10);
+			if (l < INT_MIN || l > INT_MAX)
+				return -1;
+			value->i = (int) l;
+			break;
+		}
+		case LONG:
+			value->l = strtol(token, &end, 10);
+			break;
+		case FLOAT:
+			value->f = strtof(token, &end);
+			break;
+		default:
+			return -1;
+	}
+	while (*end == ' ' || *end == '\n' || *end == '\r' || *end == ')')
+		end++;
+	return end == token || *end != '\0' || errno ? -1 : 0;
+}
+
+/*
+ * Parses the bounds of a select on values of type; a null bound is unbounded.
+ * Returns 0 on success, -1 if a bound is not a value of type.
+ */
+int parse_bounds(char* low_arg, char* high_arg, DataType type, Value* low, Value* high) {
+	*low = data_type_min(type);
+	*high = data_type_max(type);
+	if (strcmp(low_arg, "null") != 0 && parse_value(low_arg, type, low) < 0)
+		return -1;
+	if (strcmp(high_arg, "null") != 0 && parse_value(high_arg, type, high) < 0)
+		return -1;
+	return 0;
+}
+
+// bound used for a null lower bound in select
+Value data_type_min(DataType type) {
+	Value v;
+	switch (type) {
+		case LONG: v.l = LONG_MIN; break;
+		case FLOAT: v.f = -INFINITY; break;
+		default: v.i = INT_MIN; break;
+	}
+	return v;
+}
+
+// bound used for a null upper bound in select
+Value data_type_max(DataType type) {
+	Value v;
+	switch (type) {
+		case LONG: v.l = LONG_MAX; break;
+		case FLOAT: v.f = INFINITY; break;
+		default: v.i = INT_MAX; break;
+	}
+	return v;
+}
+
+// returns <0, 0 or >0 as a is less than, equal to or greater than b
+int compare_values(Value a, Value b, DataType type) {
+	switch (type) {
+#define COMPARE_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: return (a.field > b.field) - (a.field < b.field);
+		FOR_EACH_DATA_TYPE(COMPARE_CASE)
+#undef COMPARE_CASE
+	}
+	return 0;
+}
+
+Value get_value(Column* col, size_t i) {
+	Value v;
+	switch (col->type) {
+#define GET_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: v.field = COLUMN_DATA(col, ctype)[i]; break;
+		FOR_EACH_DATA_TYPE(GET_CASE)
+#undef GET_CASE
+	}
+	return v;
+}
+
+void set_value(Column* col, size_t i, Value value) {
+	switch (col->type) {
+#define SET_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: COLUMN_DATA(col, ctype)[i] = value.field; break;
+		FOR_EACH_DATA_TYPE(SET_CASE)
+#undef SET_CASE
+	}
+}
+
+// prints the i-th value of vec into buf; returns the number of characters written
+int format_value(Vector* vec, size_t i, char* buf, size_t size) {
+	switch (vec->type) {
+#define FORMAT_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: return snprintf(buf, size, format, COLUMN_DATA(vec, ctype)[i]);
+		FOR_EACH_DATA_TYPE(FORMAT_CASE)
+#undef FORMAT_CASE
+	}
+	return -1;
+}
+
+/*
+ * column_vector(Column* col)
+ * Views the values of an uncompressed base column as a vector, so that kernels over
+ * intermediates also run over base columns. The view borrows col's data.
+ */
+Vector column_vector(Column* col) {
+	Vector vec;
+	memset(&vec, 0, sizeof vec);
+	vec.data = col->data;
+	vec.type = col->type;
+	vec.length = col->length;
+	vec.capacity = col->capacity;
+	vec.stats = col->stats;
+	return vec;
+}
+
+size_t select_scan(Vector* vec, Value low, Value high, int* out) {
+	return select_scan_range(vec, 0, vec->length, low, high, out);
+}
+
+// scans positions [start, end) of vec, e.g. one segment of a column
+size_t select_scan_range(Vector* vec, size_t start, size_t end, Value low, Value high,
+		int* out) {
+	switch (vec->type) {
+#define SCAN_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: \
+			return select_scan_##TYPE(COLUMN_DATA(vec, ctype), start, end, low.field, \
+					high.field, out);
+		FOR_EACH_DATA_TYPE(SCAN_CASE)
+#undef SCAN_CASE
+	}
+	return 0;
+}
+
+size_t select_fetch_scan(Vector* positions, Vector* values, Value low, Value high, int* out) {
+	switch (values->type) {
+#define FETCH_SCAN_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: \
+			return select_fetch_scan_##TYPE(positions->data, COLUMN_DATA(values, ctype), \
+					positions->length, low.field, high.field, out);
+		FOR_EACH_DATA_TYPE(FETCH_SCAN_CASE)
+#undef FETCH_SCAN_CASE
+	}
+	return 0;
+}
+
+/*
+ * Radix clusters positions into vec by the region of vec they fall in, at most
+ * GATHER_MAX_REGIONS regions of a power of two values each, keeping their order within
+ * a region. Sets *clustered to the clustered positions and *order to the index each had
+ * in positions. Returns 0 on success, -1 if out of memory.
+ */
+static int cluster_positions(Vector* vec, Vector* positions, int** clustered, int** order) {
+	int shift = 0;
+	while ((vec->length >> shift) >= GATHER_MAX_REGIONS)
+		shift++;
+	size_t num_regions = (vec->length >> shift) + 1;
+
+	size_t* offsets = calloc(num_regions + 1, sizeof *offsets);
+	*clustered = malloc(sizeof **clustered * positions->length);
+	*order = malloc(sizeof **order * positions->length);
+	if (!offsets || !*clustered || !*order) {
+		free(offsets);
+		free(*clustered);
+		free(*order);
+		return -1;
+	}
+
+	const int* data = positions->data;
+	for (size_t i = 0; i < positions->length; i++)
+		offsets[((unsigned) data[i] >> shift) + 1]++;
+	for (size_t r = 1; r <= num_regions; r++)
+		offsets[r] += offsets[r - 1];
+	for (size_t i = 0; i < positions->length; i++) {
+		size_t k = offsets[(unsigned) data[i] >> shift]++;
+		(*clustered)[k] = data[i];
+		(*order)[k] = i;
+	}
+	free(offsets);
+	return 0;
+}
+
+/*
+ * gather(Vector* vec, Vector* positions, void* out)
+ * Writes the values of vec at positions to out. Sorted positions are read in one
+ * sequential pass. Many unsorted positions into a column larger than the cache are first
+ * radix clustered by region of the column, so that the values are read a region at a
+ * time and only the writes to out are scattered; other unsorted positions are read in
+ * order with prefetching.
+ */
+void gather(Vector* vec, Vector* positions, void* out) {
+	size_t n = positions->length;
+	int* clustered = NULL;
+	int* order = NULL;
+	bool cluster = !positions->sorted && n >= GATHER_CLUSTER_MIN
+		&& vec->length * data_type_size(vec->type) > GATHER_CACHE_BYTES
+		&& cluster_positions(vec, positions, &clustered, &order) == 0;
+
+	switch (vec->type) {
+#define GATHER_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: \
+			if (cluster) \
+				gather_scatter_##TYPE(COLUMN_DATA(vec, ctype), clustered, order, n, out); \
+			else if (!positions->sorted) \
+				gather_prefetch_##TYPE(COLUMN_DATA(vec, ctype), positions->data, n, out); \
+			else \
+				gather_##TYPE(COLUMN_DATA(vec, ctype), positions->data, n, out); \
+			break;
+		FOR_EACH_DATA_TYPE(GATHER_CASE)
+#undef GATHER_CASE
+	}
+	free(clustered);
+	free(order);
+}
+
+double sum_values(Vector* vec) {
+	switch (vec->type) {
+#define SUM_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: return sum_##TYPE(COLUMN_DATA(vec, ctype), vec->length);
+		FOR_EACH_DATA_TYPE(SUM_CASE)
+#undef SUM_CASE
+	}
+	return 0;
+}
+
+// vec must not be empty
+Value min_value(Vector* vec) {
+	Value v;
+	switch (vec->type) {
+#define MIN_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: v.field = min_##TYPE(COLUMN_DATA(vec, ctype), vec->length); break;
+		FOR_EACH_DATA_TYPE(MIN_CASE)
+#undef MIN_CASE
+	}
+	return v;
+}
+
+// vec must not be empty
+Value max_value(Vector* vec) {
+	Value v;
+	switch (vec->type) {
+#define MAX_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: v.field = max_##TYPE(COLUMN_DATA(vec, ctype), vec->length); break;
+		FOR_EACH_DATA_TYPE(MAX_CASE)
+#undef MAX_CASE
+	}
+	return v;
+}
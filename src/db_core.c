@@ -2,10 +2,18 @@
 #include <string.h> 
 #include <limits.h>
 
+#include "catalog.h"
 #include "client_context.h"
+#include "compression.h"
+#include "cracking.h"
 #include "cs165_api.h"
+#include "data_types.h"
 #include "db_core_utils.h"
 #include "index.h"
+#include "join.h"
+#include "result_pool.h"
+#include "statistics.h"
+#include "storage.h"
 #include "utils.h"
 
 
@@ -55,9 +63,13 @@ Status sync_db(Db* db) {
 
 	fwrite(db, sizeof(Db), 1, f);
 	for (size_t i = 0; i < db->tables_size; i++) {
+		// tables with an indexed column stay uncompressed
+		compress_table(&db->tables[i]);
 		fwrite(&db->tables[i], sizeof(Table), 1, f);
 		for (size_t j = 0; j < db->tables[i].columns_size; j++) {
 			fwrite(&db->tables[i].columns[j], sizeof(Column), 1, f);
+			if (db->tables[i].columns[j].stats)
+				fwrite(db->tables[i].columns[j].stats, sizeof(ColumnStats), 1, f);
 			size_t num_rows = db->tables[i].columns[j].length;
 			if (db->tables[i].columns[j].index) { // sync index if column has one
 				fwrite(db->tables[i].columns[j].index, sizeof(ColumnIndex), 1, f);
@@ -71,7 +83,11 @@ Status sync_db(Db* db) {
 						fwrite(db->tables[i].columns[j].index->data[k], sizeof(int), num_rows, f);
 
 			}
-			fwrite(db->tables[i].columns[j].data, sizeof(int), num_rows, f);
+			if (db->tables[i].columns[j].compression != UNCOMPRESSED)
+				write_compressed_column(f, &db->tables[i].columns[j]);
+			else
+				fwrite(db->tables[i].columns[j].data, 
+						data_type_size(db->tables[i].columns[j].type), num_rows, f);
 		}
 	}
 	fclose(f);
@@ -100,6 +116,8 @@ Status create_db(const char* db_name) {
 	strncpy(new_db->name, db_name, MAX_SIZE_NAME);
 	new_db->tables = malloc(sizeof *new_db->tables * new_db->tables_capacity);
 	current_db = new_db;
+	catalog_clear();
+	clear_build_cache();
 
 	log_info("DB CREATED:\nNAME: %s\n", new_db->name);
 
@@ -140,6 +158,10 @@ Status create_table(Db* db, const char* name, size_t num_columns) {
 
 	db->tables[db->tables_size] = new_table;
 	db->tables_size++;
+	if (catalog_add_table(db, &db->tables[db->tables_size - 1]) < 0) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
 	
 	log_info("TABLE CREATED in DB %s:\nNAME: %s\nNUMBER OF COLUMNS: %zu\n", 
 			db->name, new_table.name, new_table.columns_capacity); 
@@ -149,14 +171,15 @@ Status create_table(Db* db, const char* name, size_t num_columns) {
 }
 
 /*
- * create_column(char* name, Table* table, bool sorted, Status* ret_status)
+ * create_column(char* name, Table* table, DataType type, bool sorted)
  * Creates a new column and adds it to the table specified.
  * - name: Name of the newly created column. Must be unique within a table.
  * - table: Pointer to the table where the column will be added.
+ * - type: Type of the values held by the column.
  * - sorted: Boolean value indicates whether or not the column is sorted.
  * Returns the status of the operation; status.code = OK on success, ERROR on failure
  */
-Status create_column(char* name, Table* table, bool sorted) {
+Status create_column(char* name, Table* table, DataType type, bool sorted) {
 	(void) sorted;
 	Status ret_status;
 	if (table->columns_size == table->columns_capacity) {
@@ -166,18 +189,39 @@ Status create_column(char* name, Table* table, bool sorted) {
 				table->name);
 		return ret_status;
 	}
+	// clustered indexes keep int copies of every column of their table
+	for (size_t i = 0; type != INT && i < table->columns_size; i++) {
+		if (table->columns[i].index && table->columns[i].clustered) {
+			log_err("Error: table %s has a clustered index; only int columns can be added.\n",
+					table->name);
+			ret_status.code = ERROR;
+			return ret_status;
+		}
+	}
 
 	Column new_column;
+	memset(&new_column, 0, sizeof new_column);
 	strncpy(new_column.name, name, MAX_SIZE_NAME);
-	new_column.data = malloc(COLUMN_BASE_CAPACITY * sizeof *new_column.data);
-	new_column.capacity = COLUMN_BASE_CAPACITY;
+	new_column.type = type;
+	if (alloc_column_data(&new_column, COLUMN_BASE_CAPACITY) < 0) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
 	new_column.length = 0;
 	new_column.num_updated = 0;
 	new_column.num_deleted = 0;
 	new_column.stale_index = false;
 	new_column.index = NULL;
+	new_column.compression = UNCOMPRESSED;
+	new_column.compressed = NULL;
+	new_column.cracker = NULL;
+	new_column.stats = NULL;
 	table->columns[table->columns_size] = new_column;
 	table->columns_size++;
+	if (catalog_add_column(current_db, table, &table->columns[table->columns_size - 1]) < 0) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
 
 	log_info("COLUMN CREATED in TABLE %s:\nNAME: %s\n", table->name, name);
 	ret_status.code = OK;
@@ -187,6 +231,22 @@ Status create_column(char* name, Table* table, bool sorted) {
 
 Status create_index(Column* col, IndexType type, bool clustered) {
 	Status ret_status;
+	Table* table = table_for_column(col);
+	for (size_t i = 0; i < table->columns_size; i++) {
+		Column* indexed = clustered ? &table->columns[i] : col;
+		if (indexed->type != INT) {
+			log_err("Error: indexes are only supported on int columns and tables.\n");
+			ret_status.code = ERROR;
+			return ret_status;
+		}
+	}
+
+	if (type == CRACKED) { // cracker is built lazily by the first select
+		col->cracker = alloc_cracker();
+		ret_status.code = col->cracker ? OK : ERROR;
+		return ret_status;
+	}
+
 	ColumnIndex* index = malloc(sizeof *index);
 	if (!index) {
 		log_err("Could not allocate memory for column index.\n");
@@ -234,6 +294,15 @@ Status open_db(char* db_name) {
 		for (size_t j = 0; j < num_columns; j++) {
 			Column* current_column = &current_table->columns[j];
 			fread(current_column, sizeof(Column), 1, f);
+			// the pointers read back are stale; data is reserved again below
+			current_column->data = NULL;
+			current_column->zones = NULL;
+			current_column->num_zones = 0;
+			current_column->zones_capacity = 0;
+			if (current_column->stats) {
+				current_column->stats = malloc(sizeof *current_column->stats);
+				fread(current_column->stats, sizeof *current_column->stats, 1, f);
+			}
 
 			size_t column_length = current_column->length;
 			size_t column_capacity = current_column->capacity;
@@ -265,35 +334,54 @@ Status open_db(char* db_name) {
 				current_column->index = index;
 			}
 
-			current_column->data = malloc(column_capacity * sizeof *current_column->data);
-			fread(current_db->tables[i].columns[j].data, sizeof *current_column->data, column_length, f);
+			if (current_column->compression != UNCOMPRESSED) {
+				ret_status = read_compressed_column(f, current_column);
+				if (ret_status.code != OK) {
+					// the partly read database is dropped rather than served
+					fclose(f);
+					current_db = NULL;
+					return ret_status;
+				}
+			} else {
+				if (alloc_column_data(current_column, column_capacity) < 0) {
+					fclose(f);
+					ret_status.code = ERROR;
+					return ret_status;
+				}
+				fread(current_column->data, data_type_size(current_column->type), column_length, f);
+			}
 
 
 			if (current_column->index && current_column->index->type == BTREE) 
 				construct_btree_index(current_column);
+
+			// cracked pieces are not persisted, the cracker starts over on first select
+			if (current_column->cracker)
+				current_column->cracker = alloc_cracker();
 		}
 	}
 	fclose(f);
 	
-	ret_status.code = OK;
+	ret_status.code = catalog_build(current_db) < 0 ? ERROR : OK;
 	return ret_status;
 }
 
-Status relational_insert(Table* table, int* values) {
+Status relational_insert(Table* table, Value* values) {
 	Status ret_status;
 	for (size_t i = 0; i < table->columns_size; i++) {
 		Column* column = &table->columns[i];
-		if (column->length == column->capacity) {
-			int* new_data = realloc(column->data, column->capacity * 2 * sizeof *new_data);
-			if (!new_data) {
-				ret_status.code = ERROR;
-				return ret_status;
-			}
-			column->data = new_data;
-			column->capacity *= 2;
+		if (column->compression != UNCOMPRESSED && decompress_column(column).code != OK) {
+			ret_status.code = ERROR;
+			return ret_status;
+		}
+		if (grow_column_data(column, column->length + 1) < 0) {
+			ret_status.code = ERROR;
+			return ret_status;
 		}
-		column->data[table->length] = values[i];
+		set_value(column, table->length, values[i]);
 		column->length++;
+		invalidate_zones(column, table->length);
+		record_column_changes(column, 1);
 
 		if (column->index)
 			column->stale_index = true;
@@ -304,10 +392,18 @@ Status relational_insert(Table* table, int* values) {
 	return ret_status;
 }
 
-Status relational_update(Column* column, Column* positions, Table* table, int value) {
-	Status ret_status;
+Status relational_update(Column* column, Vector* positions, Table* table, Value value) {
+	Status ret_status = decompress_column(column);
+	if (ret_status.code != OK)
+		return ret_status;
+
+	record_column_changes(column, positions->length);
 	for (size_t i = 0; i < positions->length; i++) {
-		column->data[positions->data[i]] = value;
+		if (column->cracker)
+			cracker_record_update(column->cracker, positions->data[i], 
+					column->data[positions->data[i]]);
+		set_value(column, positions->data[i], value);
+		invalidate_zones(column, positions->data[i]);
 
 		if (column->num_updated == UPDATE_BUF_SIZE) { // update buffer full, reconstruct index
 			construct_index(column, table);	
@@ -322,8 +418,10 @@ Status relational_update(Column* column, Column* positions, Table* table, int va
 	return ret_status;
 }
 
-Status relational_delete(Table* table, Column* positions) {
+Status relational_delete(Table* table, Vector* positions) {
 	Status ret_status;
+	for (size_t j = 0; j < table->columns_size; j++)
+		record_column_changes(&table->columns[j], positions->length);
 	for (size_t i = 0; i < positions->length; i++) {
 		for (size_t j = 0; j < table->columns_size; j++) {
 			Column* col = &table->columns[j];
@@ -340,7 +438,7 @@ Status relational_delete(Table* table, Column* positions) {
 	return ret_status;
 }
 
-void select_btree(Column* col, int low, int high, Column* result, Status* status) {
+void select_btree(Column* col, int low, int high, Vector* result, Status* status) {
 	Node* current = col->index->tree->root;
 	while (!current->is_leaf) {
 		for (int i = 0; i <= current->length; i++)
@@ -384,47 +482,31 @@ void select_btree(Column* col, int low, int high, Column* result, Status* status
 	return;
 }
 
-void select_sorted(Column* col, int low, int high, Column* result, Status* status) {
+void select_sorted(Column* col, int low, int high, Vector* result, Status* status) {
 	int* sorted_copy = col->index->data[0];
-	int lo = 0; 
-	int hi = col->length - 1;
-	int mid;
+	int start = lower_bound(sorted_copy, col->length, low);
+	int end = lower_bound(sorted_copy, col->length, high);
 
-	while (lo <= hi) {
-		mid = (lo + hi) / 2;
-		if (sorted_copy[mid] == low) {
-			break;
-		} else if (low > sorted_copy[mid]) {
-			lo = mid + 1;
-		} else {
-			hi = mid - 1;
-		}
-	}
-
-	int j = mid;
-	while (high > sorted_copy[j])
-		j++;
-
-	for (int i = 0; i < j - mid; i++) {
-		result->data[i] = col->clustered ? mid + i : col->index->positions[mid + i];
-	}
+	for (int i = start; i < end; i++)
+		result->data[i - start] = col->clustered ? i : col->index->positions[i];
 
-	result->length = j - mid;
+	result->length = end > start ? end - start : 0;
 	status->code = OK;
 	return;
 }
 
-void select_index(Column* col, int low, int high, Column* result, Status* status) {
+void select_index(Column* col, int low, int high, AccessPath path, Vector* result, 
+		Status* status) {
 	if (col->stale_index) {
 		Table* table = table_for_column(col);
 		construct_index(col, table);
 	}
 
-	switch (col->index->type) {
-		case SORTED:
+	switch (path) {
+		case SORTED_PROBE: // a btree index keeps the sorted copy as well
 			select_sorted(col, low, high, result, status);
 			break;
-		case BTREE:
+		case BTREE_PROBE:
 			select_btree(col, low, high, result, status);
 			break;
 		default:
@@ -433,7 +515,8 @@ void select_index(Column* col, int low, int high, Column* result, Status* status
 			break;
 	}
 
-	sort(result->data, result->length, NULL, NULL);
+	if (!col->clustered) // clustered positions come out in order already
+		sort(result->data, result->length, NULL, NULL);
 	sort(col->updated_positions, col->num_updated, NULL, NULL);
 
 /*	for (int i = 0; i < result->length; i++) {
@@ -452,7 +535,7 @@ void select_index(Column* col, int low, int high, Column* result, Status* status
 	return;
 }
 
-void update_result_with_deletes(Column* result, int* deleted, int num_deleted) {
+void update_result_with_deletes(Vector* result, int* deleted, int num_deleted) {
 	for (size_t i = 0; i < result->length; i++) {
 		for (int j = 0; j < num_deleted; j++) {
 			if (result->data[i] == deleted[j]) {
@@ -466,94 +549,135 @@ void update_result_with_deletes(Column* result, int* deleted, int num_deleted) {
 	}
 }
 
-Column* select_all(Column* col, int low, int high, Status* status) {
-	Column* result = malloc(sizeof(*result));
-	if (!result) {
+/*
+ * select_all(Column* col, Value low, Value high, AccessPath* path, Status* status)
+ * Returns positions of values in [low, high), using whichever access path the cost
+ * model picks for this predicate. The chosen path is stored in path if it is not null.
+ * Indexes, crackers and compression only exist on int columns; other types are scanned.
+ */
+Vector* select_all(Column* col, Value low, Value high, AccessPath* path, Status* status) {
+	Vector* result = alloc_vector(INT);
+	if (!result || vector_reserve(result, col->length) < 0) {
 		status->code = ERROR;
+		release_vector(result);
 		return NULL;
 	}
 
-	result->data = malloc(sizeof(int) * col->capacity); 
-	result->capacity = col->capacity;
-	if (!result->data) {
-		status->code = ERROR;
-		return NULL;
-	}
-	int result_length = 0;
+	AccessPath chosen_path = col->type == INT ? choose_access_path(col, low.i, high.i) : SCAN;
+	if (path)
+		*path = chosen_path;
 
-	if (col->index) {
-		select_index(col, low, high, result, status);
-		if (status->code != OK) 
+	if (chosen_path == SORTED_PROBE || chosen_path == BTREE_PROBE) {
+		select_index(col, low.i, high.i, chosen_path, result, status);
+		if (status->code != OK) {
+			release_vector(result);
 			return NULL;
-	} else {
-		for (size_t i = 0; i < col->length; i++) {
-			if (col->data[i] >= low && col->data[i] < high) {
-				result->data[result_length++] = i;
-			}
 		}
-		result->length = result_length;
+	} else if (chosen_path == CRACKER_PROBE) {
+		select_cracker(col, low.i, high.i, result, status);
+		if (status->code != OK) {
+			release_vector(result);
+			return NULL;
+		}
+	} else if (col->compression != UNCOMPRESSED) {
+		select_compressed(col, low.i, high.i, result);
+	} else {
+		result->length = select_segments(col, low, high, result->data);
 	}
-	realloc_column(result, status);
-	if (status->code == ERROR)
-		return NULL;
 
 	update_result_with_deletes(result, col->deleted_positions, col->num_deleted);
-
+	vector_trim(result);
+	vector_mark_sorted(result);
 	return result;
 }
 
-Column* select_fetch(Column* positions, Column* values, int low, int high, Status* status) {
-	Column* result = malloc(sizeof *result);
-	if (!result) {
-		status->code = ERROR;
-		return NULL;
-	}
-
-	result->data = malloc(sizeof(int) * positions->capacity); 
-	if (!result->data) {
+/*
+ * select_fetch(Vector* positions, Vector* values, Value low, Value high, Status* status)
+ * Returns the positions[i] with low <= values[i] < high. Without positions, values is
+ * filtered on its own and the result holds indexes into it.
+ */
+Vector* select_fetch(Vector* positions, Vector* values, Value low, Value high, Status* status) {
+	Vector* result = alloc_vector(INT);
+	if (!result || vector_reserve(result, values->length) < 0) {
 		status->code = ERROR;
+		release_vector(result);
 		return NULL;
 	}
-	result->capacity = positions->capacity;
-	int result_length = 0;
 
-	for (size_t i = 0; i < positions->length; i++) {
-		if (values->data[i] >= low && values->data[i] < high) {
-			result->data[result_length++] = positions->data[i];
-		}
+	if (positions) {
+		result->length = select_fetch_scan(positions, values, low, high, result->data);
+		vector_trim(result);
+		if (positions->sorted)
+			vector_mark_sorted(result);
+	} else {
+		result->length = select_scan(values, low, high, result->data);
+		vector_trim(result);
+		vector_mark_sorted(result);
 	}
-	result->length = result_length;
-	realloc_column(result, status);
-	if (status->code == ERROR)
-		return NULL;
-
 	return result;
 }
 
-Column* fetch(Column* col, Column* positions, Status* status) {
-	Column* result = malloc(sizeof *result);
+// positions fetch_multi gathers from every column before moving on, small enough that
+// they stay in the L1 cache between columns
+#define FETCH_BLOCK_ROWS 1024
+
+Vector* fetch(Column* col, Vector* positions, Status* status) {
+	Vector* result = alloc_fetch_result(col, positions->length);
 	if (!result) {
 		status->code = ERROR;
 		return NULL;
 	}
 
-	result->data = malloc(sizeof(int) * positions->capacity); 
-	if (!result->data) {
+	if (col->compression != UNCOMPRESSED) {
+		fetch_compressed(col, positions, result);
+	} else {
+		Vector values = column_vector(col);
+		gather(&values, positions, result->data);
+		result->length = positions->length;
+	}
+	return result;
+}
+
+/*
+ * fetch_multi(Column** cols, int num_columns, Vector* positions, Status* status)
+ * Fetches the values of each of cols at positions, reading the positions once: they are
+ * walked in blocks that stay cached while every uncompressed column gathers its values
+ * for the block. Returns an array of num_columns vectors, one per column.
+ */
+Vector** fetch_multi(Column** cols, int num_columns, Vector* positions, Status* status) {
+	Vector** results = calloc(num_columns, sizeof *results);
+	if (!results) {
 		status->code = ERROR;
 		return NULL;
 	}
-	result->capacity = col->capacity;
-	size_t result_length = 0;
-
-	for (size_t i = 0; i < positions->length; i++) {
-		result->data[result_length++] = col->data[positions->data[i]];
+	for (int c = 0; c < num_columns; c++) {
+		results[c] = alloc_fetch_result(cols[c], positions->length);
+		if (!results[c]) {
+			for (int r = 0; r < c; r++)
+				release_vector(results[r]);
+			free(results);
+			status->code = ERROR;
+			return NULL;
+		}
+		results[c]->length = positions->length;
+		if (cols[c]->compression != UNCOMPRESSED)
+			fetch_compressed(cols[c], positions, results[c]);
+	}
+
+	Vector block = *positions;
+	for (size_t start = 0; start < positions->length; start += FETCH_BLOCK_ROWS) {
+		block.data = positions->data + start;
+		block.length = positions->length - start < FETCH_BLOCK_ROWS
+			? positions->length - start : FETCH_BLOCK_ROWS;
+		for (int c = 0; c < num_columns; c++) {
+			if (cols[c]->compression != UNCOMPRESSED)
+				continue;
+			Vector values = column_vector(cols[c]);
+			gather(&values, &block,
+					(char*) results[c]->data + start * data_type_size(cols[c]->type));
+		}
 	}
-	result->length = result_length;
-	realloc_column(result, status);
-	if (status->code == ERROR)
-		return NULL;
-
-	return result;
+	return results;
 }
 
 Status shutdown_database(Db* db) {
@@ -590,13 +714,18 @@ Status shutdown_database(Db* db) {
 void free_db(Db* db) {
 	for (size_t i = 0; i < db->tables_size; i++) {
 		for (size_t j = 0; j < db->tables[i].columns_size; j++) {
-			free(db->tables[i].columns[j].data); //free data array
+			free_column_data(&db->tables[i].columns[j]);
+			free_compressed_column(&db->tables[i].columns[j]);
+			free_cracker(db->tables[i].columns[j].cracker);
+			free_column_stats(db->tables[i].columns[j].stats);
 			//free(db->tables[i].columns[j].index);		
 		}
 		free(db->tables[i].columns);
 	}
 	free(db->tables);
 	free(db);
+	catalog_clear();
+	clear_build_cache();
 	return;	
 }
 
@@ -606,7 +735,12 @@ void free_db(Db* db) {
  * Returns the status of the operation; status.code = OK on success, ERROR on failure
  */
 
-Status load(char* header_line, int* data, int data_length) {
+/*
+ * load(char* header_line, char* data, size_t data_length)
+ * Appends the csv rows in data to the table named in the header line, parsing each
+ * field according to the type of its column.
+ */
+Status load(char* header_line, char* data, size_t data_length) {
 	Status ret_status;
 
 	// read in first line with db, table, col names and construct db
@@ -640,10 +774,23 @@ Status load(char* header_line, int* data, int data_length) {
 	}
 
 	// load data line by line
-	int row[num_cols];
-	for (int i = 0; i < data_length; i += num_cols) {
-		for (int j = 0; j < num_cols; j++) {
-			row[j] = data[i+j]; 
+	Value row[num_cols];
+	data[data_length] = '\0';
+	char* line;
+	while ((line = strsep(&data, "\n"))) {
+		if (*line == '\0' || *line == '\r')
+			continue;
+		int j = 0;
+		char* token;
+		while (j < num_cols && (token = strsep(&line, ","))) {
+			if (parse_value(token, table->columns[j].type, &row[j]) < 0)
+				break;
+			j++;
+		}
+		if (j < num_cols) {
+			log_err("Malformed row in loaded file.\n");
+			ret_status.code = ERROR;
+			return ret_status;
 		}
 		ret_status = relational_insert(table, row);	
 		if (ret_status.code != OK) {
@@ -658,6 +805,8 @@ Status load(char* header_line, int* data, int data_length) {
 			construct_index(&table->columns[i], table);
 		}
 	}
+	compress_table(table);
+	analyze_table(table);
 
 
 	log_info("DB LOADED:\nNAME: %s\n", current_db->name); // 
@@ -667,6 +816,13 @@ Status load(char* header_line, int* data, int data_length) {
 }
 
 double average_column(Column* column)  {
+	if (column->compression != UNCOMPRESSED)
+		return (double) sum_compressed(column) / column->length;
+	if (column->type != INT) {
+		Vector values = column_vector(column);
+		return sum_values(&values) / column->length;
+	}
+
 	double average = 0;
 	for (int i = 0; i < (int) column->length; i++) {
 		average += column->data[i];
@@ -675,7 +831,13 @@ double average_column(Column* column)  {
 	return average; 
 }
 
+// int and long columns only; float sums are computed with sum_values
 long sum_column(Column* column) {
+	if (column->compression != UNCOMPRESSED)
+		return sum_compressed(column);
+	if (column->type == LONG)
+		return sum_LONG(COLUMN_DATA(column, long), column->length);
+
 	long sum = 0;
 	for (int i = 0; i < (int) column->length; i++) {
 		sum += column->data[i];
@@ -683,7 +845,11 @@ long sum_column(Column* column) {
 	return sum; 
 }
 
+// int columns only; other types use min_value
 int min_column(Column* column) {
+	if (column->compression != UNCOMPRESSED)
+		return column->compressed->min;
+
 	int min = INT_MAX;
 	for (size_t i = 0; i < column->length; i++) {
 		if (column->data[i] < min)
@@ -692,7 +858,11 @@ int min_column(Column* column) {
 	return min;
 }
 
+// int columns only; other types use max_value
 int max_column(Column* column) {
+	if (column->compression != UNCOMPRESSED)
+		return column->compressed->max;
+
 	int max = INT_MIN;
 	for (size_t i = 0; i < column->length; i++) {
 		if (column->data[i] > max)
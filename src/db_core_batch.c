@@ -1,71 +1,207 @@
 #include <limits.h>
 
+#include "compression.h"
 #include "cs165_api.h"
+#include "data_types.h"
+#include "db_core_utils.h"
+#include "result_pool.h"
+#include "storage.h"
 
-Column** select_batch(Column* col, int* lows, int* highs, int num_ops, Status* status) {
-	Column** result = malloc((sizeof *result) * num_ops);
+// column values a shared fetch reads per block, which stays cached while each position
+// list gathers from it
+#define FETCH_BATCH_BLOCK_VALUES (1 << 14)
+
+Vector** select_batch(Column* col, int* lows, int* highs, int num_ops, Status* status) {
+	Vector** result = malloc((sizeof *result) * num_ops);
 	int* result_lengths = malloc(sizeof(int) * num_ops);
 	for (int i = 0; i < num_ops; i++) {
-		result[i] = malloc(sizeof *result[i]);
-		if (!result[i]) {
-			status->code = ERROR;
-			return NULL;
-		}
-		result[i]->data = malloc(sizeof(int) * col->capacity);
-		result[i]->capacity = col->capacity;
-		if (!result[i]->data) {
+		result[i] = alloc_vector(INT);
+		if (!result[i] || vector_reserve(result[i], col->length) < 0) {
 			status->code = ERROR;
 			return NULL;
 		}
 		result_lengths[i] = 0;
 	}
 
-	for (size_t i = 0; i < col->length; i++) {
-		for (int j = 0; j < num_ops; j++) {
-			if (col->data[i] >= lows[j] && col->data[i] < highs[j]) {
-				result[j]->data[result_lengths[j]++] = i;
+	if (col->compression != UNCOMPRESSED) {
+		// decode one block at a time and evaluate all predicates over it
+		int block[DECODE_BLOCK_SIZE];
+		for (size_t i = 0; i < col->length; i += DECODE_BLOCK_SIZE) {
+			size_t n = col->length - i < DECODE_BLOCK_SIZE ? col->length - i : DECODE_BLOCK_SIZE;
+			decode_range(col, i, n, block);
+			for (size_t k = 0; k < n; k++) {
+				for (int j = 0; j < num_ops; j++) {
+					if (block[k] >= lows[j] && block[k] < highs[j]) {
+						result[j]->data[result_lengths[j]++] = i + k;
+					}
+				}
+			}
+		}
+	} else {
+		// a segment is scanned for the predicates its zone map overlaps; zone maps are
+		// refreshed before the shared scans start
+		bool use_zones = col->num_zones * COLUMN_SEGMENT_VALUES >= col->length;
+		int active[num_ops];
+		for (size_t start = 0; start < col->length; start += COLUMN_SEGMENT_VALUES) {
+			size_t end = col->length - start < COLUMN_SEGMENT_VALUES
+				? col->length : start + COLUMN_SEGMENT_VALUES;
+			int num_active = 0;
+			for (int j = 0; j < num_ops; j++) {
+				Value low = {.i = lows[j]};
+				Value high = {.i = highs[j]};
+				if (!use_zones || zone_may_match(col, start / COLUMN_SEGMENT_VALUES, low, high))
+					active[num_active++] = j;
+			}
+			if (num_active == 0)
+				continue;
+
+			for (size_t i = start; i < end; i++) {
+				for (int a = 0; a < num_active; a++) {
+					int j = active[a];
+					if (col->data[i] >= lows[j] && col->data[i] < highs[j]) {
+						result[j]->data[result_lengths[j]++] = i;
+					}
+				}
 			}
 		}
 	}
 
 	for (int i = 0; i < num_ops; i++) {
 		result[i]->length = result_lengths[i];
+		vector_trim(result[i]);
+		vector_mark_sorted(result[i]);
 	}
+	free(result_lengths);
 
 	status->code = OK;
 	return result;
 }
 
-Column** fetch_batch(Column* col, Column** position_columns, int num_ops, Status* status) {
-	Column** result = malloc((sizeof *result) * num_ops);
-	int* position_ixs = malloc(sizeof *position_ixs * num_ops);
-	for (int i = 0; i < num_ops; i++) {
-		result[i] = malloc(sizeof *result[i]);
-		if (!result[i]) {
-			status->code = ERROR;
-			return NULL;
+/*
+ * fetch_batch(Column* col, Vector** position_columns, int num_ops, Status* status)
+ * Fetches the values of col at each of the position lists in one pass over the column.
+ * The column is walked a cache block at a time and every sorted list gathers the values
+ * of its positions inside the block before the pass moves on, so a block is read from
+ * memory once however many lists fetch from it. Unsorted lists are fetched on their own.
+ */
+Vector** fetch_batch(Column* col, Vector** position_columns, int num_ops, Status* status) {
+	Vector** result = calloc(num_ops, sizeof *result);
+	size_t* position_ixs = calloc(num_ops, sizeof *position_ixs);
+	if (!result || !position_ixs) {
+		free(result);
+		free(position_ixs);
+		status->code = ERROR;
+		return NULL;
+	}
+
+	int shared[num_ops];
+	int num_shared = 0;
+	for (int j = 0; j < num_ops; j++) {
+		if (position_columns[j]->sorted) {
+			result[j] = alloc_fetch_result(col, position_columns[j]->length);
+			shared[num_shared++] = j;
+		} else {
+			result[j] = fetch(col, position_columns[j], status);
 		}
-		result[i]->data = malloc(sizeof(int) * position_columns[i]->capacity);
-		result[i]->capacity = col->capacity;
-		if (!result[i]->data) {
+		if (!result[j]) {
+			for (int i = 0; i < j; i++)
+				release_vector(result[i]);
+			free(result);
+			free(position_ixs);
 			status->code = ERROR;
 			return NULL;
 		}
-		position_ixs[i] = 0;
+		result[j]->length = position_columns[j]->length;
 	}
 
-	for (int i = 0; i < (int) col->length; i++) {
-		for (int j = 0; j < num_ops; j++) {
-			if (i == position_columns[j]->data[position_ixs[j]]) {
-				result[j]->data[position_ixs[j]++] = i;
+	if (col->compression != UNCOMPRESSED) {
+		// decode one block at a time and let every list read its values from it
+		int block[DECODE_BLOCK_SIZE];
+		for (size_t start = 0; start < col->length && num_shared > 0;
+				start += DECODE_BLOCK_SIZE) {
+			size_t n = col->length - start < DECODE_BLOCK_SIZE
+				? col->length - start : DECODE_BLOCK_SIZE;
+			bool decoded = false;
+			for (int s = 0; s < num_shared; s++) {
+				int j = shared[s];
+				Vector* positions = position_columns[j];
+				size_t k = position_ixs[j];
+				for (; k < positions->length && (size_t) positions->data[k] < start + n; k++) {
+					if (!decoded) {
+						decode_range(col, start, n, block);
+						decoded = true;
+					}
+					result[j]->data[k] = block[positions->data[k] - start];
+				}
+				position_ixs[j] = k;
+			}
+		}
+	} else {
+		Vector values = column_vector(col);
+		size_t width = data_type_size(col->type);
+		for (size_t start = 0; start < col->length && num_shared > 0;
+				start += FETCH_BATCH_BLOCK_VALUES) {
+			size_t end = start + FETCH_BATCH_BLOCK_VALUES;
+			for (int s = 0; s < num_shared; s++) {
+				int j = shared[s];
+				Vector* positions = position_columns[j];
+				size_t k = position_ixs[j];
+				while (k < positions->length && (size_t) positions->data[k] < end)
+					k++;
+				if (k == position_ixs[j])
+					continue;
+
+				Vector run = *positions;
+				run.data = positions->data + position_ixs[j];
+				run.length = k - position_ixs[j];
+				gather(&values, &run, (char*) result[j]->data + position_ixs[j] * width);
+				position_ixs[j] = k;
 			}
 		}
 	}
+	free(position_ixs);
 
-	for (int i = 0; i < num_ops; i++) {
-		result[i]->length = position_columns[i]->length;
+	status->code = OK;
+	return result;
+}
+
+/*
+ * refine_select(Column* col, Vector* positions, int low, int high, Status* status)
+ * Returns the positions of an int column, out of the given ones, whose values lie in
+ * [low, high). Used instead of a scan when positions already hold the result of a select
+ * over a range containing [low, high).
+ */
+Vector* refine_select(Column* col, Vector* positions, int low, int high, Status* status) {
+	Vector* result = alloc_vector(INT);
+	if (!result || vector_reserve(result, positions->length) < 0) {
+		release_vector(result);
+		status->code = ERROR;
+		return NULL;
 	}
 
+	if (col->compression != UNCOMPRESSED) {
+		Vector* values = fetch(col, positions, status);
+		if (!values) {
+			release_vector(result);
+			return NULL;
+		}
+		Value low_value = {.i = low};
+		Value high_value = {.i = high};
+		result->length = select_fetch_scan(positions, values, low_value, high_value,
+				result->data);
+		release_vector(values);
+	} else {
+		size_t k = 0;
+		for (size_t i = 0; i < positions->length; i++) {
+			int p = positions->data[i];
+			result->data[k] = p;
+			k += (col->data[p] >= low) & (col->data[p] < high);
+		}
+		result->length = k;
+	}
+	vector_trim(result);
+	if (positions->sorted)
+		vector_mark_sorted(result);
 	status->code = OK;
 	return result;
 }
@@ -1,38 +1,30 @@
+#include <string.h>
+
+#include "compression.h"
+#include "cracking.h"
 #include "cs165_api.h"
+#include "data_types.h"
 #include "index.h"
+#include "result_pool.h"
+#include "storage.h"
 #include "db_core_utils.h"
 
-// reallocates column data to only occupy memory as big as column length 
-// rather than multiple of default column capacity
-// used to relieve memory pressure 
-void realloc_column(Column* col, Status* status) {
-	if (col->length == 0 || col->length == col->capacity)
-		return;
-
-	int* new_data = realloc(col->data, col->length * sizeof *col->data);
-	if (!new_data) {
-		status->code = ERROR;
-		return;
-	}
-	col->data = new_data;
-	col->capacity = col->length;
-	return;
-}
-
 void update_column_with_deletes(Column* col) {
+	decompress_column(col);
 	sort(col->deleted_positions, col->num_deleted, NULL, NULL);
+	if (col->num_deleted > 0)
+		invalidate_zones(col, col->deleted_positions[0]);
+	size_t width = data_type_size(col->type);
+	char* data = (char*) col->data;
 	for (int i = 0; i < col->num_deleted - 1; i++) {
-		if (i < col->num_deleted - 1) {
-			for (int j = col->deleted_positions[i]; j < col->deleted_positions[i+1]; j++) 
-				col->data[j - i] = col->data[j + 1];
-		}
-		else {
-			for (int j = col->deleted_positions[col->num_deleted-1]; j < (int) col->length; j++)
-				col->data[j - i] = col->data[j + 1];
-		}
+		int from = col->deleted_positions[i];
+		int to = col->deleted_positions[i+1];
+		memmove(data + (from - i) * width, data + (from + 1) * width, (to - from) * width);
 	}
 	col->length -= col->num_deleted;
 	col->num_deleted = 0;
+	if (col->cracker) // positions shifted
+		reset_cracker(col->cracker);
 }
 
 Table* table_for_column(Column* col) {
@@ -46,3 +38,39 @@ Table* table_for_column(Column* col) {
 	return NULL;
 }
 
+
+// returns index of first element in sorted arr that is >= val
+int lower_bound(int* arr, int len, long val) {
+	int lo = 0;
+	int hi = len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (arr[mid] < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// qsort comparator for ints
+int compare_ints(const void* a, const void* b) {
+	int x = *(const int*) a;
+	int y = *(const int*) b;
+	return (x > y) - (x < y);
+}
+
+// allocates the vector receiving the values of col at length positions
+Vector* alloc_fetch_result(Column* col, size_t length) {
+	Vector* result = alloc_vector(col->type);
+	if (!result || vector_reserve(result, length) < 0) {
+		release_vector(result);
+		return NULL;
+	}
+	// borrowed so that consumers such as join can estimate the result's distinct values;
+	// owned by col and must not be freed through the result
+	result->stats = col->stats;
+	result->column = col;
+	result->column_version = col->version;
+	return result;
+}
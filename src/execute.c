@@ -2,22 +2,33 @@
 #include <string.h>
 
 #include "client_context.h"
+#include "compression.h"
 #include "cs165_api.h"
+#include "data_types.h"
 #include "execute.h"
+#include "expression.h"
 #include "join.h"
+#include "result_pool.h"
+#include "statistics.h"
 #include "utils.h"
 
 #define DEFAULT_PRINT_BUFFER_SIZE 4096
-
-GeneralizedColumnHandle* assign_column_to_handle(Column* col, char* handle, ClientContext* context) {
-	GeneralizedColumnHandle* result = lookup_client_handle(context, handle);
-	if (!result)
-		return NULL;
-
-	result->generalized_column.column_pointer.column = col;
-	result->generalized_column.column_type = COLUMN;
-	return result;
-}
+#define MAX_VALUE_LENGTH 64
+
+// indexed by AccessPath
+static char* select_path_messages[] = {
+	"-- Select executed (scan)",
+	"-- Select executed (sorted index)",
+	"-- Select executed (btree index)",
+	"-- Select executed (cracker index)"
+};
+
+static char* join_messages[] = {
+	"-- Joined columns (nested-loop)",
+	"-- Joined columns (hash)",
+	"-- Joined columns (sort-merge)",
+	"-- Joined columns (index)"
+};
 
 /** execute_DbOperator takes as input the DbOperator and executes the query.
  * This should be replaced in your implementation (and its implementation possibly moved to a different file).
@@ -42,8 +53,12 @@ char* execute_db_operator(DbOperator* query) {
 			return execute_select(query);
 		case FETCH:
 			return execute_fetch(query);
+		case FETCH_MULTI:
+			return execute_fetch_multi(query);
 		case JOIN:
 			return execute_join(query);
+		case STAR_JOIN:
+			return execute_star_join(query);
 		case PRINT:
 			return execute_print(query);
 		case AVERAGE:
@@ -53,7 +68,11 @@ char* execute_db_operator(DbOperator* query) {
 			return execute_unary_aggregate(query);
 		case ADD:
 		case SUB:
+		case MUL:
+		case DIV:
 			return execute_binary_aggregate(query);
+		case ANALYZE:
+			return execute_analyze(query);
 		case SHUTDOWN:
 			return execute_shutdown();
 		default:
@@ -106,7 +125,9 @@ char* execute_create_col(DbOperator* query) {
 	char* name = query->operator_fields.create_operator.name;
 	Table* table = query->operator_fields.create_operator.table;
 
-    Status ret_status = create_column(name, table, false);
+	DataType type = query->operator_fields.create_operator.data_type;
+
+    Status ret_status = create_column(name, table, type, false);
     if (ret_status.code != OK) {
         return "-- Could not complete create(col) query";
     }
@@ -141,14 +162,12 @@ char* execute_update(DbOperator* query) {
 	Status ret_status;
 	UpdateOperator op = query->operator_fields.update_operator;
 
-	GeneralizedColumnHandle* positions_handle = lookup_client_handle(query->context, 
-			op.positions_handle);
-	if (!positions_handle) {
+	Vector* positions = lookup_vector(query->context, op.positions_handle);
+	if (!positions) {
 		ret_status.code = ERROR;
 		return "-- Error: could not find positions vector";
 	}
-	Column* positions_col =  positions_handle->generalized_column.column_pointer.column;
-	ret_status = relational_update(op.column, positions_col, op.table, op.value);
+	ret_status = relational_update(op.column, positions, op.table, op.value);
 
 	if (ret_status.code == ERROR)
 		return ret_status.error_message;
@@ -160,14 +179,12 @@ char* execute_delete(DbOperator* query) {
 	Status ret_status;
 	DeleteOperator op = query->operator_fields.delete_operator;
 
-	GeneralizedColumnHandle* positions_handle = lookup_client_handle(query->context, 
-			op.positions_handle);
-	if (!positions_handle) {
+	Vector* positions = lookup_vector(query->context, op.positions_handle);
+	if (!positions) {
 		ret_status.code = ERROR;
 		return "-- Error: could not find positions vector";
 	}
-	Column* positions_col =  positions_handle->generalized_column.column_pointer.column;
-	ret_status = relational_delete(op.table, positions_col);
+	ret_status = relational_delete(op.table, positions);
 	
 	if (ret_status.code == ERROR)
 		return ret_status.error_message;
@@ -177,140 +194,234 @@ char* execute_delete(DbOperator* query) {
 
 char* execute_select(DbOperator* query) {
 	Status ret_status;
+	ret_status.code = OK; // kernels only set the code on failure
 	SelectOperator op = query->operator_fields.select_operator;
 
-	Column* result_col;
-	if (!op.values) { // regular select
-		result_col = select_all(op.column, op.low, op.high, &ret_status);
-	} else { // fetch select
-		result_col = select_fetch(op.column, op.values, op.low, op.high, &ret_status);
+	Vector* result;
+	AccessPath path = SCAN;
+	if (op.column) { // regular select
+		result = select_all(op.column, op.low, op.high, &path, &ret_status);
+	} else {
+		Vector* positions = NULL;
+		if (op.positions_handle[0] != '\0'
+				&& !(positions = lookup_vector(query->context, op.positions_handle)))
+			return "-- Error: could not find positions vector";
+
+		// bounds are parsed as values of the type being filtered
+		Vector* values = NULL;
+		DataType data_type;
+		if (op.expression.num_instructions > 0) {
+			if (expression_type(&op.expression, query->context, &data_type) < 0)
+				return "-- Error: could not find values to select from";
+		} else {
+			values = lookup_vector(query->context, op.values_handle);
+			if (!values)
+				return "-- Error: could not find values vector";
+			data_type = values->type;
+		}
+		if (parse_bounds(op.low_arg, op.high_arg, data_type, &op.low, &op.high) < 0)
+			return "-- Error: select bounds are not values of the selected type";
+
+		if (values) // fetch select
+			result = select_fetch(positions, values, op.low, op.high, &ret_status);
+		else
+			result = select_expression(&op.expression, query->context, positions, op.low,
+					op.high, &ret_status);
 	}
+	if (!result)
+		return "-- Error: could not execute select";
 
-	if (!assign_column_to_handle(result_col, op.result_handle, query->context)) {
+	if (!assign_vector_to_handle(result, op.result_handle, query->context)) {
 		ret_status.code = ERROR;
+		release_vector(result);
 		return "-- Error in assigning select result to client context";
 	}
 
-	return "-- Select executed";
+	return select_path_messages[path];
 }
 
 char* execute_fetch(DbOperator* query) {
 	Status ret_status;
+	ret_status.code = OK; // kernels only set the code on failure
 	FetchOperator op = query->operator_fields.fetch_operator;
 
-	GeneralizedColumnHandle* positions_handle = lookup_client_handle(query->context, op.positions_handle);
-	if (!positions_handle) {
+	Vector* positions = lookup_vector(query->context, op.positions_handle);
+	if (!positions) {
 		ret_status.code = ERROR;
 		return "-- Error: could not find positions vector";
 	}
-	Column* positions_col =  positions_handle->generalized_column.column_pointer.column;
-	Column* result_col = fetch(op.column, positions_col, &ret_status);
+	Vector* result = fetch(op.column, positions, &ret_status);
+	if (!result)
+		return "-- Error: could not execute fetch";
 
-	if (!assign_column_to_handle(result_col, op.result_handle, query->context)) {
+	if (!assign_vector_to_handle(result, op.result_handle, query->context)) {
 		ret_status.code = ERROR;
+		release_vector(result);
 		return "-- Error in assigning fetch result to client context";
 	}
 
 	return "-- Fetch executed";
 }
 
-char* execute_join(DbOperator* query) {
+char* execute_fetch_multi(DbOperator* query) {
 	Status ret_status;
-	JoinOperator op = query->operator_fields.join_operator;
+	ret_status.code = OK; // kernels only set the code on failure
+	FetchMultiOperator op = query->operator_fields.fetch_multi_operator;
 
-	GeneralizedColumnHandle* positions_1_handle = lookup_client_handle(query->context, op.positions_1);
-	if (!positions_1_handle) {
-		ret_status.code = ERROR;
+	Vector* positions = lookup_vector(query->context, op.positions_handle);
+	if (!positions)
 		return "-- Error: could not find positions vector";
+	Vector** results = fetch_multi(op.columns, op.num_columns, positions, &ret_status);
+	if (!results)
+		return "-- Error: could not execute fetch";
+
+	bool assigned = true;
+	for (int c = 0; c < op.num_columns; c++) {
+		if (assigned)
+			assigned = assign_vector_to_handle(results[c], op.result_handles[c], query->context);
+		else
+			release_vector(results[c]);
 	}
-	Column* positions_1 =  positions_1_handle->generalized_column.column_pointer.column;
+	free(results);
+	if (!assigned)
+		return "-- Error in assigning fetch result to client context";
 
-	GeneralizedColumnHandle* positions_2_handle = lookup_client_handle(query->context, op.positions_2);
-	if (!positions_2_handle) {
+	return "-- Fetch executed";
+}
+
+char* execute_join(DbOperator* query) {
+	Status ret_status;
+	ret_status.code = OK; // kernels only set the code on failure
+	JoinOperator op = query->operator_fields.join_operator;
+
+	Vector* positions_1 = lookup_vector(query->context, op.positions_1);
+	Vector* positions_2 = lookup_vector(query->context, op.positions_2);
+	if (!positions_1 || !positions_2) {
 		ret_status.code = ERROR;
 		return "-- Error: could not find positions vector";
 	}
-	Column* positions_2 =  positions_2_handle->generalized_column.column_pointer.column;
-
-	GeneralizedColumnHandle* values_1_handle = lookup_client_handle(query->context, op.values_1);
-	if (!values_1_handle) {
+	Vector* values_1 = lookup_vector(query->context, op.values_1);
+	Vector* values_2 = lookup_vector(query->context, op.values_2);
+	if (!values_1 || !values_2) {
 		ret_status.code = ERROR;
-		return "-- Error: could not find positions vector";
+		return "-- Error: could not find values vector";
 	}
-	Column* values_1 =  values_1_handle->generalized_column.column_pointer.column;
 
-	GeneralizedColumnHandle* values_2_handle = lookup_client_handle(query->context, op.values_2);
-	if (!positions_2_handle) {
+	JoinPlan plan;
+	Vector** results = join(positions_1, positions_2, values_1, values_2, op.type,
+			op.cache_build, &plan, &ret_status);
+	if (!results)
+		return "-- Error: could not join columns";
+
+	bool assigned = assign_vector_to_handle(results[0], op.result_1, query->context)
+		&& assign_vector_to_handle(results[1], op.result_2, query->context);
+	free(results);
+	if (!assigned) {
 		ret_status.code = ERROR;
-		return "-- Error: could not find positions vector";
+		return "-- Error in assigning join result to client context";
 	}
-	Column* values_2 =  values_2_handle->generalized_column.column_pointer.column;
 
-	Column** result_columns = join(positions_1, positions_2, values_1, values_2, op.type, &ret_status);	
+	return plan.spill ? "-- Joined columns (grace hash)" : join_messages[plan.type];
+}
 
-	if (!assign_column_to_handle(result_columns[0], op.result_1, query->context)) {
-		ret_status.code = ERROR;
-		return "-- Error in assigning fetch result to client context";
+char* execute_star_join(DbOperator* query) {
+	Status ret_status;
+	ret_status.code = OK; // kernels only set the code on failure
+	StarJoinOperator op = query->operator_fields.star_join_operator;
+
+	Vector* fact_positions = lookup_vector(query->context, op.fact_positions);
+	if (!fact_positions)
+		return "-- Error: could not find positions vector";
+
+	// foreign keys given as base columns are read through views at the fact positions
+	Column* key_columns[MAX_STAR_DIMENSIONS] = {NULL};
+	Vector views[MAX_STAR_DIMENSIONS];
+	StarDimension dimensions[MAX_STAR_DIMENSIONS];
+	char* error = NULL;
+	for (int d = 0; d < op.num_dimensions && !error; d++) {
+		StarDimension* dim = &dimensions[d];
+		dim->fact_keys = lookup_vector(query->context, op.fact_keys[d]);
+		dim->gather = false;
+		if (!dim->fact_keys) {
+			Column* column = lookup_column(op.fact_keys[d]);
+			if (!column || column_values(column, &views[d]) < 0) {
+				error = "-- Error: could not find foreign keys";
+				continue;
+			}
+			key_columns[d] = column;
+			dim->fact_keys = &views[d];
+			dim->gather = true;
+		}
+		dim->values = lookup_vector(query->context, op.values[d]);
+		dim->positions = lookup_vector(query->context, op.positions[d]);
+		if (!dim->values || !dim->positions)
+			error = "-- Error: could not find values vector";
 	}
 
-	if (!assign_column_to_handle(result_columns[1], op.result_2, query->context)) {
-		ret_status.code = ERROR;
-		return "-- Error in assigning fetch result to client context";
+	Vector** results = error ? NULL
+		: star_join(fact_positions, dimensions, op.num_dimensions, &ret_status);
+	for (int d = 0; d < op.num_dimensions; d++)
+		if (key_columns[d])
+			free_column_values(key_columns[d], &views[d]);
+	if (error)
+		return error;
+	if (!results)
+		return "-- Error: could not join columns";
+
+	bool assigned = true;
+	for (int r = 0; r <= op.num_dimensions; r++) {
+		if (assigned)
+			assigned = assign_vector_to_handle(results[r], op.results[r], query->context);
+		else
+			release_vector(results[r]);
 	}
+	free(results);
+	if (!assigned)
+		return "-- Error in assigning join result to client context";
 
-	return "-- Joined columns!";
+	return "-- Joined columns (star)";
 }
 
-int print_column(Column* column, char** buf_ptr, int* buf_size, int* buf_capacity) {
+int print_column(Vector* column, char** buf_ptr, int* buf_size, int* buf_capacity) {
+	char value[MAX_VALUE_LENGTH];
 	for (size_t i = 0; i < column->length; i++) {
-		int len = column->data[i] < 0 ? 2 : 1;
-		int data_copy = column->data[i] < 0 ? column->data[i] * -1 : column->data[i] * 1;
-		data_copy /= 10;
-		while (data_copy > 0) {
-			len++;
-			data_copy /= 10;
-		}
+		int len = format_value(column, i, value, sizeof value);
 
-		if (*buf_size + len >= *buf_capacity) { // enlarge buffer size
+		if (*buf_size + len + 1 >= *buf_capacity) { // enlarge buffer size
 			char* new_buf = realloc(*buf_ptr, *buf_capacity * 2);
 			if (!new_buf) {
-				log_err("Could not reallocate bigger buffer for printing column %s.\n",
-						column->name);
+				log_err("Could not reallocate bigger buffer for printing column.\n");
+				return -1;
 			}
 			*buf_ptr = new_buf;
 			*buf_capacity *= 2;
 		}
 
-		sprintf(*buf_ptr + *buf_size, "%d%s", column->data[i], i < column->length - 1 ? "\n" : "\0");
+		sprintf(*buf_ptr + *buf_size, "%s%s", value, i < column->length - 1 ? "\n" : "\0");
 		*buf_size += len + 1;
 	}
 
 	return *buf_size;
 }
 
-int print_columns(Column** columns, int num_columns, char** buf_ptr, int* buf_size,
+int print_columns(Vector** columns, int num_columns, char** buf_ptr, int* buf_size,
 		int* buf_capacity) {
+	char value[MAX_VALUE_LENGTH];
 	for (size_t i = 0; i < columns[0]->length; i++) {
 		for (int j = 0; j < num_columns; j++) {
-			int len = columns[j]->data[i] < 0 ? 2 : 1;
-			int data_copy = columns[j]->data[i] < 0 ? columns[j]->data[i] * -1 : columns[j]->data[i] * 1;
-			data_copy /= 10;
-			while (data_copy > 0) {
-				len++;
-				data_copy /= 10;
-			}
+			int len = format_value(columns[j], i, value, sizeof value);
 
-			if (*buf_size + len >= *buf_capacity) { // enlarge buffer size
+			if (*buf_size + len + 2 >= *buf_capacity) { // enlarge buffer size
 				char* new_buf = realloc(*buf_ptr, *buf_capacity * 2);
 				if (!new_buf) {
-					log_err("Could not reallocate bigger buffer for printing column %s.\n",
-							columns[i]->name);
+					log_err("Could not reallocate bigger buffer for printing columns.\n");
+					return -1;
 				}
 				*buf_ptr = new_buf;
 				*buf_capacity *= 2;
 			}
 
-			sprintf(*buf_ptr + *buf_size, "%d", columns[j]->data[i]);
+			memcpy(*buf_ptr + *buf_size, value, len);
 			*buf_size += len;
 			if (j < num_columns - 1) {
 				sprintf(*buf_ptr + *buf_size, ",");
@@ -370,7 +481,9 @@ char* execute_print(DbOperator* query) {
 			for (int i = 0; i < op.num_handles; i++) {
 				GeneralizedColumnHandle* handle = lookup_client_handle(query->context,
 						op.handles[i]);
-				if (!handle) {
+				// the handle of an aggregate over no values holds no result
+				if (!handle || handle->generalized_column.column_type != RESULT
+						|| !handle->generalized_column.column_pointer.result) {
 					free(results);
 					return "-- Could not find column to print.";
 				}
@@ -378,31 +491,36 @@ char* execute_print(DbOperator* query) {
 			}
 			if (print_results(results, op.num_handles, buf_ptr, buf_size) < 0)
 				return "-- Print execution failed.";
-		} else if (generalized_handle->generalized_column.column_type == COLUMN) {
-			Column** columns = malloc(sizeof *columns * op.num_handles);
+		} else if (generalized_handle->generalized_column.column_type == VECTOR) {
+			Vector* columns[MAX_NUM_PRINT_HANDLES];
 			for (int i = 0; i < op.num_handles; i++) {
-				GeneralizedColumnHandle* handle = lookup_client_handle(query->context,
-						op.handles[i]);
-				if (!handle) {
-					free(columns);
+				columns[i] = lookup_vector(query->context, op.handles[i]);
+				if (!columns[i])
 					return "-- Could not find column to print.";
-				}
-				columns[i] = handle->generalized_column.column_pointer.column;
 			}
 			if (print_columns(columns, op.num_handles, buf_ptr, buf_size, buf_capacity) < 0)
 				return "-- Print execution failed.";
 		}
 	} else {
-		Column** columns = malloc(sizeof *columns * op.num_handles);
-		for (int i = 0; i < op.num_handles; i++) {
-			Column* column = lookup_column(op.handles[i]);
-			if (!column) {
-				free(columns);
-				return "-- Could not find column to print.";
-			}
-			columns[i] = column;
+		// base columns are printed through vector views of their data
+		Column* base_columns[MAX_NUM_PRINT_HANDLES];
+		Vector views[MAX_NUM_PRINT_HANDLES];
+		Vector* columns[MAX_NUM_PRINT_HANDLES];
+		int num_views = 0;
+		for (; num_views < op.num_handles; num_views++) {
+			base_columns[num_views] = lookup_column(op.handles[num_views]);
+			if (!base_columns[num_views]
+					|| column_values(base_columns[num_views], &views[num_views]) < 0)
+				break;
+			columns[num_views] = &views[num_views];
 		}
-		if (print_columns(columns, op.num_handles, buf_ptr, buf_size, buf_capacity) < 0)
+		int r = num_views == op.num_handles
+			? print_columns(columns, op.num_handles, buf_ptr, buf_size, buf_capacity) : -1;
+		for (int i = 0; i < num_views; i++)
+			free_column_values(base_columns[i], &views[i]);
+		if (num_views < op.num_handles)
+			return "-- Could not find column to print.";
+		if (r < 0)
 			return "-- Print execution failed.";
 	}
 
@@ -411,7 +529,61 @@ char* execute_print(DbOperator* query) {
 		: "-- Could not find column to print";
 }
 
+bool execute_unary_aggregate_vector(Vector* values, Result* result, OperatorType type) {
+	switch(type) {
+		case AVERAGE:{
+			double* average = malloc(sizeof *average);
+			*average = sum_values(values) / values->length;
+			result->payload = average;
+			result->data_type = FLOAT;
+			return true;
+		}
+		case SUM:{
+			if (values->type == FLOAT) {
+				double* sum = malloc(sizeof *sum);
+				*sum = sum_values(values);
+				result->payload = sum;
+				result->data_type = FLOAT;
+				return true;
+			}
+			long* sum = malloc(sizeof *sum);
+			*sum = values->type == LONG ? sum_LONG(COLUMN_DATA(values, long), values->length)
+				: sum_INT(values->data, values->length);
+			result->payload = sum;
+			result->data_type = LONG;
+			return true;
+		}
+		case MAX:
+		case MIN:{
+			Value extreme = type == MAX ? max_value(values) : min_value(values);
+			if (values->type == INT) {
+				int* payload = malloc(sizeof *payload);
+				*payload = extreme.i;
+				result->payload = payload;
+			} else if (values->type == LONG) {
+				long* payload = malloc(sizeof *payload);
+				*payload = extreme.l;
+				result->payload = payload;
+			} else { // float results are printed from doubles
+				double* payload = malloc(sizeof *payload);
+				*payload = extreme.f;
+				result->payload = payload;
+			}
+			result->data_type = values->type;
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+// compressed columns hold ints and are aggregated without decompressing them
 bool execute_unary_aggregate_column(Column* column, Result* result, OperatorType type) {
+	if (column->compression == UNCOMPRESSED) {
+		Vector values = column_vector(column);
+		return execute_unary_aggregate_vector(&values, result, type);
+	}
+
 	switch(type) {
 		case AVERAGE:{
 			double* average = malloc(sizeof *average);
@@ -427,17 +599,11 @@ bool execute_unary_aggregate_column(Column* column, Result* result, OperatorType
 			result->data_type = LONG;
 			return true;
 		}
-		case MAX:{
-			int* max = malloc(sizeof *max);
-			*max = max_column(column);
-			result->payload = max;
-			result->data_type = INT;
-			return true;
-		}
+		case MAX:
 		case MIN:{
-			int* min = malloc(sizeof *min);
-			*min = min_column(column);
-			result->payload = min;
+			int* extreme = malloc(sizeof *extreme);
+			*extreme = type == MAX ? max_column(column) : min_column(column);
+			result->payload = extreme;
 			result->data_type = INT;
 			return true;
 		}
@@ -446,89 +612,114 @@ bool execute_unary_aggregate_column(Column* column, Result* result, OperatorType
 	}
 }
 
+// aggregates an expression in one pass, with the result types of the vector aggregates
+bool execute_unary_aggregate_expression(Expression* expr, ClientContext* context,
+		Result* result, OperatorType type) {
+	ExpressionFold fold;
+	fold.type = type;
+	if (fold_expression(expr, context, &fold) < 0 || fold.count == 0)
+		return false;
+
+	if (type == AVERAGE || (type == SUM && fold.data_type == FLOAT)) {
+		double* value = malloc(sizeof *value);
+		*value = type == AVERAGE ? fold.float_sum / fold.count : fold.float_sum;
+		result->payload = value;
+		result->data_type = FLOAT;
+	} else if (type == SUM) {
+		long* sum = malloc(sizeof *sum);
+		*sum = fold.sum;
+		result->payload = sum;
+		result->data_type = LONG;
+	} else if (fold.data_type == INT) {
+		int* payload = malloc(sizeof *payload);
+		*payload = fold.extreme.i;
+		result->payload = payload;
+		result->data_type = INT;
+	} else if (fold.data_type == LONG) {
+		long* payload = malloc(sizeof *payload);
+		*payload = fold.extreme.l;
+		result->payload = payload;
+		result->data_type = LONG;
+	} else { // float results are printed from doubles
+		double* payload = malloc(sizeof *payload);
+		*payload = fold.extreme.f;
+		result->payload = payload;
+		result->data_type = FLOAT;
+	}
+	return true;
+}
+
 char* execute_unary_aggregate(DbOperator* query) {
 	UnaryAggOperator op = query->operator_fields.unary_aggregate_operator;
+	bool expression = op.expression.num_instructions > 0;
 
-	GeneralizedColumnHandle* generalized_handle = lookup_client_handle(query->context, op.handle);
+	Vector* values = NULL;
 	Column* column = NULL;
-	if (!generalized_handle)
-		column = lookup_column(op.handle);
-	else 
-		column = generalized_handle->generalized_column.column_pointer.column;
-	if (column->length <= 0) {
-		remove_handle(query->context, op.result_handle);	
-		return "-- Could not execute aggregate; column is empty";
+	if (!expression) {
+		values = lookup_vector(query->context, op.handle);
+		column = values ? NULL : lookup_column(op.handle);
+		if (!values && !column)
+			return "-- Could not find column to aggregate";
+		if ((values ? values->length : column->length) == 0) {
+			// the handle is cleared in place: removing it would move entries of the handle
+			// map that operators of the same batch may be looking up
+			GeneralizedColumn empty;
+			empty.column_type = RESULT;
+			empty.column_pointer.result = NULL;
+			assign_handle(query->context, op.result_handle, empty);
+			return "-- Could not execute aggregate; column is empty";
+		}
 	}
 
-	GeneralizedColumnHandle* result_handle = lookup_client_handle(query->context, op.result_handle);
-	if (!result_handle) {
-		return "Error: could not find results vector";
-	}
-	Result* result = malloc(sizeof(Result));
+	Result* result = alloc_result();
+	if (!result)
+		return "-- Could not execute unary aggregation";
 	result->num_tuples = 1;
-	result->payload = result;
-	result_handle->generalized_column.column_type = RESULT;
-	result_handle->generalized_column.column_pointer.result = result;
-
-
-	return execute_unary_aggregate_column(column, result, query->type) 
-		? "-- Unary aggregation executed." 
-		: "-- Could not execute unary aggregation";
-}
-
-bool execute_binary_aggregate_columns(Column* column1, Column* column2, Column* result_column, 
-		OperatorType type) {
-	result_column->data = malloc(column1->length * sizeof *(result_column->data));
-	result_column->length = column1->length;
-	if (column1->length != column2->length || !result_column->data)
-		return false;
+	bool computed;
+	if (expression) {
+		computed = execute_unary_aggregate_expression(&op.expression, query->context, result,
+				query->type);
+	} else {
+		computed = values ? execute_unary_aggregate_vector(values, result, query->type)
+			: execute_unary_aggregate_column(column, result, query->type);
+	}
+	if (!computed) {
+		release_result(result);
+		return "-- Could not execute unary aggregation";
+	}
 
-	switch (type) {
-		case ADD:
-			for (size_t i = 0; i < column1->length; i++) {
-				result_column->data[i] = column1->data[i] + column2->data[i];
-			}
-			break;
-		case SUB:
-			for (size_t i = 0; i < column1->length; i++) {
-				result_column->data[i] = column1->data[i] - column2->data[i];
-			}
-			break;
-		default:
-			return false;
+	GeneralizedColumn value;
+	value.column_type = RESULT;
+	value.column_pointer.result = result;
+	if (!assign_handle(query->context, op.result_handle, value)) {
+		release_result(result);
+		return "Error: could not find results vector";
 	}
-	return true;
+	return "-- Unary aggregation executed.";
 }
 
 char* execute_binary_aggregate(DbOperator* query) {
 	BinaryAggOperator op = query->operator_fields.binary_aggregate_operator;
+	Status ret_status;
+	ret_status.code = OK;
 
-	GeneralizedColumnHandle* result_handle = lookup_client_handle(query->context, op.result_handle);
-	if (!result_handle) {
+	// the result is assigned only once computed, since it may replace one of the inputs
+	Vector* result = evaluate_expression(&op.expression, query->context, &ret_status);
+	if (!result)
+		return "-- Could not execute binary aggregation";
+	if (!assign_vector_to_handle(result, op.result_handle, query->context)) {
+		release_vector(result);
 		return "Error: could not find results vector";
 	}
-	Column* result_column = malloc(sizeof(Column));
-	result_handle->generalized_column.column_type = COLUMN;
-	result_handle->generalized_column.column_pointer.column = result_column;
-
-	GeneralizedColumnHandle* generalized_handle1 = lookup_client_handle(query->context, op.handle1);
-	GeneralizedColumnHandle* generalized_handle2 = lookup_client_handle(query->context, op.handle2);
-	Column* column1 = NULL;
-	Column* column2 = NULL;
-	if (!generalized_handle1)
-		column1 = lookup_column(op.handle1);
-	else 
-		column1 = generalized_handle1->generalized_column.column_pointer.column;
-	if (!generalized_handle2)
-		column2 = lookup_column(op.handle2);
-	else 
-		column2 = generalized_handle2->generalized_column.column_pointer.column;
-
-	return (column1 
-			&& column2 
-			&& execute_binary_aggregate_columns(column1, column2, result_column, query->type))
-		? "-- Binary aggregation executed."
-		: "-- Could not execute binary aggregation";
+	return "-- Binary aggregation executed.";
+}
+
+char* execute_analyze(DbOperator* query) {
+	Status ret_status = analyze_table(query->operator_fields.analyze_operator.table);
+	if (ret_status.code != OK)
+		return "-- Error: could not compute table statistics";
+
+	return "-- Table analyzed";
 }
 
 char* execute_shutdown() {
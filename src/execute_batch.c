@@ -1,146 +1,443 @@
 #define _BSD_SOURCE
+#include <limits.h>
 #include <pthread.h>
 #include <string.h>
 
 #include "client_context.h"
+#include "execute_batch.h"
+#include "result_pool.h"
+#include "storage.h"
 
 #define DEFAULT_BATCH_CAPACITY 4
+// most handles a batch node reads or assigns: one per operator of a shared node, which is
+// more than the 13 a star join over every dimension reads
+#define BATCH_MAX_HANDLES MAX_NUM_SHARED_SCAN
+
+/*
+ * Batches are scheduled as a DAG. Operators become nodes in arrival order, and a node
+ * depends on every earlier node that assigns a handle it reads or assigns, or reads a
+ * handle it assigns. A node also depends on every earlier node that touches a base column
+ * it touches: even reading a column may decompress it, collect its statistics, crack it,
+ * rebuild its index or refresh its zone maps. Operators that change base data or the
+ * catalog are barriers, ordered against every other node. Selects and fetches over the
+ * same column join a shared node when nothing they depend on comes after it. Nodes run
+ * on a pool of workers as soon as all of their dependencies have run.
+ *
+ * A select whose range lies within that of an earlier select on the same column, whose
+ * result is still held by its handle, does not scan the column: it reuses that result if
+ * the ranges are equal and filters it otherwise.
+ */
+
+// the handles a batch node reads and assigns, and the base columns it touches
+typedef struct BatchHandles {
+	const char* uses[BATCH_MAX_HANDLES];
+	int num_uses;
+	const char* defs[BATCH_MAX_HANDLES];
+	int num_defs;
+	Column* columns[BATCH_MAX_HANDLES];
+	int num_columns;
+	bool any_column; // touches the columns its input vectors were fetched from
+	bool barrier;
+} BatchHandles;
+
+typedef struct BatchSchedule {
+	BatchOperator* batch;
+	int* ready; // queue of nodes whose dependencies have all run
+	int head;
+	int tail;
+	int num_done;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} BatchSchedule;
 
 int init_batch(BatchOperator* batch) {
-	batch->num_ops_select = 0;
-	batch->ops_capacity_select = DEFAULT_BATCH_CAPACITY;
-	batch->batch_select = malloc(sizeof *(batch->batch_select) * batch->ops_capacity_select);
-
-	batch->num_ops_fetch = 0;
-	batch->ops_capacity_fetch = DEFAULT_BATCH_CAPACITY;
-	batch->batch_fetch = malloc(sizeof *(batch->batch_fetch) * batch->ops_capacity_fetch);
-	if (!batch->batch_select || !batch->batch_fetch || !batch->batch_select->lows 
-			|| !batch->batch_select->highs || !batch->batch_fetch->positions_handles)
+	batch->num_nodes = 0;
+	batch->nodes_capacity = DEFAULT_BATCH_CAPACITY;
+	batch->nodes = malloc(sizeof *batch->nodes * batch->nodes_capacity);
+	if (!batch->nodes)
 		return -1;
+	return 0;
+}
 
-	batch->num_ops_other = 0;
-	batch->ops_capacity_other = DEFAULT_BATCH_CAPACITY;
-	batch->other_ops = malloc(sizeof *(batch->other_ops) * batch->ops_capacity_other);
-	if (!batch->other_ops)
-		return -1;
+static void add_column(BatchHandles* handles, Column* col) {
+	if (col)
+		handles->columns[handles->num_columns++] = col;
+}
 
-	return 0;
+// names of base columns are read like handles
+static void add_use(BatchHandles* handles, const char* name) {
+	if (name[0] == '\0')
+		return;
+	handles->uses[handles->num_uses++] = name;
+	add_column(handles, lookup_column((char*) name));
 }
 
-BatchSelect* find_select(Column* col, BatchOperator* batch) { 
-	for (int i = 0; i < batch->num_ops_select; i++) {
-		if (batch->batch_select[i].column == col 
-				&& batch->batch_select[i].num_ops < MAX_NUM_SHARED_SCAN)
-			return &batch->batch_select[i];
-	}
-	return NULL;
+static void add_def(BatchHandles* handles, const char* name) {
+	handles->defs[handles->num_defs++] = name;
+}
+
+// operands are only set for operators that were given an expression
+static void add_expression_uses(BatchHandles* handles, const Expression* expr) {
+	if (expr->num_instructions == 0)
+		return;
+	for (int i = 0; i < expr->num_operands; i++)
+		add_use(handles, expr->operands[i]);
 }
 
-BatchFetch* find_fetch(Column* col, BatchOperator* batch) {
-	for (int i = 0; i < batch->num_ops_fetch; i++) {
-		if (batch->batch_fetch[i].column == col)
-			return &batch->batch_fetch[i];
+static void clear_handles(BatchHandles* handles) {
+	handles->num_uses = 0;
+	handles->num_defs = 0;
+	handles->num_columns = 0;
+	handles->any_column = false;
+	handles->barrier = false;
+}
+
+static void operator_handles(DbOperator* op, BatchHandles* handles) {
+	clear_handles(handles);
+
+	OperatorFields* fields = &op->operator_fields;
+	switch (op->type) {
+		case SELECT:
+			add_use(handles, fields->select_operator.positions_handle);
+			add_use(handles, fields->select_operator.values_handle);
+			add_expression_uses(handles, &fields->select_operator.expression);
+			add_column(handles, fields->select_operator.column);
+			add_def(handles, fields->select_operator.result_handle);
+			break;
+		case FETCH:
+			add_use(handles, fields->fetch_operator.positions_handle);
+			add_column(handles, fields->fetch_operator.column);
+			add_def(handles, fields->fetch_operator.result_handle);
+			break;
+		case FETCH_MULTI:
+			add_use(handles, fields->fetch_multi_operator.positions_handle);
+			for (int c = 0; c < fields->fetch_multi_operator.num_columns; c++) {
+				add_column(handles, fields->fetch_multi_operator.columns[c]);
+				add_def(handles, fields->fetch_multi_operator.result_handles[c]);
+			}
+			break;
+		case JOIN:
+			add_use(handles, fields->join_operator.positions_1);
+			add_use(handles, fields->join_operator.values_1);
+			add_use(handles, fields->join_operator.positions_2);
+			add_use(handles, fields->join_operator.values_2);
+			add_def(handles, fields->join_operator.result_1);
+			add_def(handles, fields->join_operator.result_2);
+			// may walk the index of the column its values were fetched from
+			handles->any_column = true;
+			break;
+		case STAR_JOIN: {
+			StarJoinOperator* star_op = &fields->star_join_operator;
+			add_use(handles, star_op->fact_positions);
+			for (int d = 0; d < star_op->num_dimensions; d++) {
+				add_use(handles, star_op->fact_keys[d]);
+				add_use(handles, star_op->values[d]);
+				add_use(handles, star_op->positions[d]);
+			}
+			for (int r = 0; r <= star_op->num_dimensions; r++)
+				add_def(handles, star_op->results[r]);
+			break;
+		}
+		case PRINT:
+			for (int i = 0; i < fields->print_operator.num_handles; i++)
+				add_use(handles, fields->print_operator.handles[i]);
+			break;
+		case AVERAGE:
+		case SUM:
+		case MIN:
+		case MAX:
+			add_use(handles, fields->unary_aggregate_operator.handle);
+			add_expression_uses(handles, &fields->unary_aggregate_operator.expression);
+			add_def(handles, fields->unary_aggregate_operator.result_handle);
+			break;
+		case ADD:
+		case SUB:
+		case MUL:
+		case DIV:
+			add_expression_uses(handles, &fields->binary_aggregate_operator.expression);
+			add_def(handles, fields->binary_aggregate_operator.result_handle);
+			break;
+		default: // creates, inserts, updates, deletes, analyze and shutdown
+			handles->barrier = true;
+			break;
 	}
-	return NULL;
 }
 
-int handle_select_operator(DbOperator* op, BatchOperator* batch) {
-	SelectOperator select_op = op->operator_fields.select_operator;
-	BatchSelect* match = find_select(select_op.column, batch);
-	if (match && match->num_ops < MAX_NUM_SHARED_SCAN) {
-		match->lows[match->num_ops] = select_op.low;
-		match->highs[match->num_ops] = select_op.high;
-		match->result_handles[match->num_ops] = malloc(strlen(select_op.result_handle));
-		strcpy(match->result_handles[match->num_ops], select_op.result_handle);
-		match->num_ops++;
-		return 0;
+static void node_handles(BatchNode* node, BatchHandles* handles) {
+	clear_handles(handles);
+	switch (node->type) {
+		case BATCH_SELECT:
+			add_column(handles, node->select.column);
+			for (int i = 0; i < node->select.num_ops; i++)
+				add_def(handles, node->select.result_handles[i]);
+			break;
+		case BATCH_FETCH:
+			add_column(handles, node->fetch.column);
+			for (int i = 0; i < node->fetch.num_ops; i++) {
+				add_use(handles, node->fetch.positions_handles[i]);
+				add_def(handles, node->fetch.result_handles[i]);
+			}
+			break;
+		case BATCH_REFINE:
+			add_use(handles, node->refine.source_handle);
+			add_column(handles, node->refine.column);
+			add_def(handles, node->refine.result_handle);
+			break;
+		default:
+			operator_handles(node->op, handles);
+			break;
 	}
+}
+
+static bool contains_handle(const char* const* names, int num_names, const char* name) {
+	for (int i = 0; i < num_names; i++)
+		if (strcmp(names[i], name) == 0)
+			return true;
+	return false;
+}
+
+// whether the handles of later and earlier conflict, ignoring the columns they touch
+static bool handles_conflict(BatchHandles* later, BatchHandles* earlier) {
+	if (later->barrier || earlier->barrier)
+		return true;
+	for (int i = 0; i < later->num_uses; i++)
+		if (contains_handle(earlier->defs, earlier->num_defs, later->uses[i]))
+			return true;
+	for (int i = 0; i < later->num_defs; i++)
+		if (contains_handle(earlier->defs, earlier->num_defs, later->defs[i])
+				|| contains_handle(earlier->uses, earlier->num_uses, later->defs[i]))
+			return true;
+	return false;
+}
+
+static bool columns_conflict(BatchHandles* later, BatchHandles* earlier) {
+	if ((later->any_column && (earlier->num_columns > 0 || earlier->any_column))
+			|| (earlier->any_column && later->num_columns > 0))
+		return true;
+	for (int i = 0; i < later->num_columns; i++)
+		for (int j = 0; j < earlier->num_columns; j++)
+			if (later->columns[i] == earlier->columns[j])
+				return true;
+	return false;
+}
+
+// whether an operator with handles later must run after a node with handles earlier
+static bool depends_on(BatchHandles* later, BatchHandles* earlier) {
+	return handles_conflict(later, earlier) || columns_conflict(later, earlier);
+}
 
-	if (batch->num_ops_select == batch->ops_capacity_select) {
-		batch->ops_capacity_select *= 2;
-		BatchSelect* new_ops = realloc(batch->batch_select, 
-				sizeof *new_ops * batch->ops_capacity_select);
-		if (!new_ops)
+// makes node to run after node from; returns 0 on success, -1 if out of memory
+static int add_dependency(BatchOperator* batch, int from, int to) {
+	BatchNode* node = &batch->nodes[from];
+	for (int i = 0; i < node->num_successors; i++)
+		if (node->successors[i] == to)
+			return 0;
+
+	if (node->num_successors == node->successors_capacity) {
+		int capacity = node->successors_capacity ? node->successors_capacity * 2
+			: DEFAULT_BATCH_CAPACITY;
+		int* successors = realloc(node->successors, sizeof *successors * capacity);
+		if (!successors)
 			return -1;
-		batch->batch_select = new_ops;
+		node->successors = successors;
+		node->successors_capacity = capacity;
 	}
-	
-	BatchSelect* new_select = &batch->batch_select[batch->num_ops_select];
-	new_select->context = op->context;
-	new_select->column = select_op.column;
-	new_select->num_ops = 1;
-
-	new_select->lows[0] = select_op.low;
-	new_select->highs[0] = select_op.high;
-	new_select->result_handles[0] = malloc(strlen(select_op.result_handle));
-	strcpy(new_select->result_handles[0], select_op.result_handle);
-	batch->num_ops_select++;
-	
+	node->successors[node->num_successors++] = to;
+	batch->nodes[to].num_pending++;
 	return 0;
 }
 
-int handle_fetch_operator(DbOperator* op, BatchOperator* batch) {
-	FetchOperator fetch_op = op->operator_fields.fetch_operator;
-	BatchFetch* match = find_fetch(fetch_op.column, batch);
-	if (match && match->num_ops < MAX_NUM_SHARED_SCAN) {
-		match->positions_handles[match->num_ops] = fetch_op.positions_handle;
-		match->result_handles[match->num_ops] = malloc(strlen(fetch_op.result_handle));
-		strcpy(match->result_handles[match->num_ops], fetch_op.result_handle);
-		match->num_ops++;
-		return 0;
+// whether an operator of the given type over col can join node
+static bool joinable(BatchNode* node, BatchNodeType type, Column* col) {
+	if (node->type != type)
+		return false;
+	if (type == BATCH_SELECT)
+		return node->select.column == col && node->select.num_ops < MAX_NUM_SHARED_SCAN;
+	if (type == BATCH_FETCH)
+		return node->fetch.column == col && node->fetch.num_ops < MAX_NUM_SHARED_SCAN;
+	return false;
+}
+
+// returns the shared node after node first that the operator can join, or -1
+static int find_group(BatchOperator* batch, BatchNodeType type, Column* col, int first) {
+	for (int i = first; i < batch->num_nodes; i++)
+		if (joinable(&batch->nodes[i], type, col))
+			return i;
+	return -1;
+}
+
+// whether no node after node first assigns handle
+static bool handle_unchanged_after(BatchOperator* batch, int first, const char* handle) {
+	BatchHandles later;
+	for (int i = first; i < batch->num_nodes; i++) {
+		node_handles(&batch->nodes[i], &later);
+		if (later.barrier || contains_handle(later.defs, later.num_defs, handle))
+			return false;
 	}
+	return true;
+}
 
-	if (batch->num_ops_fetch == batch->ops_capacity_fetch) {
-		batch->ops_capacity_fetch *= 2;
-		BatchFetch* new_ops = realloc(batch->batch_fetch, sizeof *new_ops * batch->ops_capacity_fetch);
-		if (!new_ops)
-			return -1;
-		batch->batch_fetch = new_ops;
+// points refine at the result of a select over [low, high) held by handle in node if that
+// range contains refine's and is narrower than the best one found so far
+static void consider_source(BatchOperator* batch, int node, int low, int high,
+		const char* handle, BatchRefine* refine, long* best_width) {
+	long width = (long) high - low;
+	if (low > refine->low || high < refine->high || width >= *best_width
+			|| !handle_unchanged_after(batch, node + 1, handle))
+		return;
+	*best_width = width;
+	strcpy(refine->source_handle, handle);
+	refine->alias = low == refine->low && high == refine->high;
+}
+
+/*
+ * Finds the narrowest earlier select of refine's column over a range containing its own
+ * whose result is still held by its handle, and points refine at it.
+ * Returns whether there is one.
+ */
+static bool find_source(BatchOperator* batch, BatchRefine* refine) {
+	long best_width = LONG_MAX;
+	for (int i = 0; i < batch->num_nodes; i++) {
+		BatchNode* node = &batch->nodes[i];
+		if (node->type == BATCH_SELECT && node->select.column == refine->column) {
+			for (int k = 0; k < node->select.num_ops; k++)
+				consider_source(batch, i, node->select.lows[k], node->select.highs[k],
+						node->select.result_handles[k], refine, &best_width);
+		} else if (node->type == BATCH_REFINE && node->refine.column == refine->column) {
+			consider_source(batch, i, node->refine.low, node->refine.high,
+					node->refine.result_handle, refine, &best_width);
+		}
 	}
-	
-	BatchFetch* new_fetch = &batch->batch_fetch[batch->num_ops_fetch];
-	new_fetch->context = op->context;
-	new_fetch->column = fetch_op.column;
-	new_fetch->num_ops = 1;
-
-	new_fetch->positions_handles[0] = fetch_op.result_handle;
-	new_fetch->result_handles[0] = malloc(strlen(fetch_op.result_handle));
-	strcpy(new_fetch->result_handles[0], fetch_op.result_handle);
-	
-	return 0;
+	return best_width < LONG_MAX;
 }
 
-int handle_other_operator(DbOperator* op, BatchOperator* batch) {
-	if (batch->num_ops_other == batch->ops_capacity_other) {
-		batch->ops_capacity_other *= 2;
-		DbOperator** new_ops = realloc(batch->other_ops, batch->ops_capacity_other);
-		if (!new_ops)
-			return -1;
-		batch->other_ops = new_ops;
+static char* copy_handle(const char* handle) {
+	char* copy = malloc(strlen(handle) + 1);
+	if (copy)
+		strcpy(copy, handle);
+	return copy;
+}
+
+static void add_select_operator(DbOperator* op, BatchSelect* group) {
+	SelectOperator select_op = op->operator_fields.select_operator;
+	if (group->num_ops == 0) {
+		group->context = op->context;
+		group->column = select_op.column;
 	}
-	batch->other_ops[batch->num_ops_other++] = op;
-	return 0;
+	group->lows[group->num_ops] = select_op.low.i;
+	group->highs[group->num_ops] = select_op.high.i;
+	group->result_handles[group->num_ops] = copy_handle(select_op.result_handle);
+	group->num_ops++;
+}
+
+static void add_fetch_operator(DbOperator* op, BatchFetch* group) {
+	FetchOperator fetch_op = op->operator_fields.fetch_operator;
+	if (group->num_ops == 0) {
+		group->context = op->context;
+		group->column = fetch_op.column;
+	}
+	group->positions_handles[group->num_ops] = copy_handle(fetch_op.positions_handle);
+	group->result_handles[group->num_ops] = copy_handle(fetch_op.result_handle);
+	group->num_ops++;
 }
 
+// the kind of node an operator runs in
+static BatchNodeType batch_node_type(DbOperator* op, Column** col) {
+	*col = NULL;
+	if (op->type == FETCH) {
+		*col = op->operator_fields.fetch_operator.column;
+		return BATCH_FETCH;
+	}
+	// shared scans run over int columns; other selects execute on their own
+	if (op->type == SELECT && op->operator_fields.select_operator.column
+			&& op->operator_fields.select_operator.column->type == INT) {
+		*col = op->operator_fields.select_operator.column;
+		return BATCH_SELECT;
+	}
+	return BATCH_OTHER;
+}
+
+/*
+ * handle_db_operator(DbOperator* op, BatchOperator* batch)
+ * Adds op to the batch, either to a shared node over its column or as a new node, and
+ * records the nodes it depends on. Selects and fetches are copied into their node and op
+ * is freed; other operators are kept until the batch executes.
+ * Returns 0 on success, -1 if out of memory.
+ */
 int handle_db_operator(DbOperator* op, BatchOperator* batch) {
 	if (!op)
 		return 0;
-	int r;
-	switch (op->type) {
-		case SELECT:
-			r = handle_select_operator(op, batch);
-			if (r < 0)
+
+	Column* col;
+	BatchNodeType type = batch_node_type(op, &col);
+	BatchHandles handles;
+	BatchHandles earlier;
+	operator_handles(op, &handles);
+
+	BatchRefine refine;
+	if (type == BATCH_SELECT) {
+		SelectOperator* select_op = &op->operator_fields.select_operator;
+		refine.column = col;
+		refine.low = select_op->low.i;
+		refine.high = select_op->high.i;
+		strcpy(refine.result_handle, select_op->result_handle);
+		refine.context = op->context;
+		if (find_source(batch, &refine)) {
+			type = BATCH_REFINE;
+			handles.num_uses = 0;
+			add_use(&handles, refine.source_handle);
+		}
+	}
+
+	// a shared node the operator can join only touches the same column
+	int last_dependency = -1;
+	for (int i = batch->num_nodes - 1; i >= 0 && last_dependency < 0; i--) {
+		node_handles(&batch->nodes[i], &earlier);
+		if (joinable(&batch->nodes[i], type, col) ? handles_conflict(&handles, &earlier)
+				: depends_on(&handles, &earlier))
+			last_dependency = i;
+	}
+
+	// a shared node must come after everything the operator depends on
+	int target = type == BATCH_SELECT || type == BATCH_FETCH
+		? find_group(batch, type, col, last_dependency + 1) : -1;
+	if (target < 0) {
+		if (batch->num_nodes == batch->nodes_capacity) {
+			int capacity = batch->nodes_capacity * 2;
+			BatchNode* nodes = realloc(batch->nodes, sizeof *nodes * capacity);
+			if (!nodes)
 				return -1;
+			batch->nodes = nodes;
+			batch->nodes_capacity = capacity;
+		}
+		target = batch->num_nodes++;
+		BatchNode* node = &batch->nodes[target];
+		memset(node, 0, sizeof *node);
+		node->type = type;
+	}
+
+	for (int i = 0; i <= last_dependency; i++) {
+		node_handles(&batch->nodes[i], &earlier);
+		if (depends_on(&handles, &earlier) && add_dependency(batch, i, target) < 0)
+			return -1;
+	}
+
+	BatchNode* node = &batch->nodes[target];
+	switch (type) {
+		case BATCH_SELECT:
+			add_select_operator(op, &node->select);
+			db_operator_free(op);
 			break;
-		case FETCH:
-			r = handle_fetch_operator(op, batch);
-			if (r < 0)
-				return -1;
+		case BATCH_FETCH:
+			add_fetch_operator(op, &node->fetch);
+			db_operator_free(op);
+			break;
+		case BATCH_REFINE:
+			node->refine = refine;
+			db_operator_free(op);
 			break;
 		default:
-			r = handle_other_operator(op, batch);
-			if (r < 0)
-				return -1;
+			node->op = op;
 			break;
 	}
 	return 0;
@@ -148,114 +445,168 @@ int handle_db_operator(DbOperator* op, BatchOperator* batch) {
 
 char* execute_batch_select(BatchSelect* batch_select) {
 	Status ret_status;
-	Column** result_columns = select_batch(batch_select->column, batch_select->lows, 
+	Vector** result_columns = select_batch(batch_select->column, batch_select->lows,
 			batch_select->highs, batch_select->num_ops, &ret_status);
 	if (ret_status.code != OK)
 		return "-- Error occurred when executing batch select";
 
 	for (int i = 0; i < batch_select->num_ops; i++) {
-		GeneralizedColumnHandle* result_handle = lookup_client_handle(batch_select->context,
-				batch_select->result_handles[i]);	
-		if (!result_handle) {
+		if (!assign_vector_to_handle(result_columns[i], batch_select->result_handles[i], batch_select->context)) {
 			ret_status.code = ERROR;
 			return "-- Error: could not find results vector in batch";
 		}
-		result_handle->generalized_column.column_pointer.column = result_columns[i];
-		result_handle->generalized_column.column_type = COLUMN;
 	}
+	free(result_columns);
 	ret_status.code = OK;
 	return "-- Shared select executed";
 }
 
 char* execute_batch_fetch(BatchFetch* batch_fetch) {
 	Status ret_status;
-	Column** position_columns = malloc(sizeof *position_columns * batch_fetch->num_ops);
+	Vector** position_columns = malloc(sizeof *position_columns * batch_fetch->num_ops);
 	for (int i = 0; i < batch_fetch->num_ops; i++) {
-		GeneralizedColumnHandle* positions_handle = lookup_client_handle(batch_fetch->context,
-				batch_fetch->positions_handles[i]);	
-		if (!positions_handle) {
+		position_columns[i] = lookup_vector(batch_fetch->context,
+				batch_fetch->positions_handles[i]);
+		if (!position_columns[i]) {
 			ret_status.code = ERROR;
 			return "-- Error: could not find positions vector in batch";
 		}
-		position_columns[i] = positions_handle->generalized_column.column_pointer.column;
 	}
 
-	Column** result_columns = fetch_batch(batch_fetch->column, position_columns, 
+	Vector** result_columns = fetch_batch(batch_fetch->column, position_columns,
 			batch_fetch->num_ops, &ret_status);
+	free(position_columns);
 	if (ret_status.code != OK)
 		return "-- Error occurred when executing batch fetch";
 
 	for (int i = 0; i < batch_fetch->num_ops; i++) {
-		GeneralizedColumnHandle* result_handle = lookup_client_handle(batch_fetch->context,
-				batch_fetch->result_handles[i]);	
-		if (!result_handle) {
+		if (!assign_vector_to_handle(result_columns[i], batch_fetch->result_handles[i], batch_fetch->context)) {
 			ret_status.code = ERROR;
 			return "-- Error: could not find results vector in batch";
 		}
-		result_handle->generalized_column.column_pointer.column = result_columns[i];
-		result_handle->generalized_column.column_type = COLUMN;
 	}
+	free(result_columns);
 	ret_status.code = OK;
 	return "-- Shared fetch executed";
 }
 
-// pthread routine for batch select
-void* run_batch_select(void* batch_select) {
-	execute_batch_select((BatchSelect*) batch_select);
-	pthread_exit(NULL);
-}
+char* execute_batch_refine(BatchRefine* refine) {
+	Status ret_status;
+	Vector* source = lookup_vector(refine->context, refine->source_handle);
+	if (!source)
+		return "-- Error: could not find positions vector in batch";
 
-// pthread routine for batch fetch 
-void* run_batch_fetch(void* batch_fetch) {
-	execute_batch_fetch((BatchFetch*) batch_fetch);
-	pthread_exit(NULL);
+	Vector* result = source;
+	if (!refine->alias) {
+		result = refine_select(refine->column, source, refine->low, refine->high, &ret_status);
+		if (!result)
+			return "-- Error occurred when executing batch select";
+	}
+	// an alias shares the source's vector, which the handle takes its own reference to
+	if (!assign_vector_to_handle(result, refine->result_handle, refine->context)) {
+		if (!refine->alias)
+			release_vector(result);
+		return "-- Error: could not find results vector in batch";
+	}
+	return "-- Shared select executed";
 }
 
-// pthread routine for other operator execution 
-void* run_batch_other(void* other) {
-	execute_db_operator((DbOperator*) other);
-	pthread_exit(NULL);
+static void run_batch_node(BatchNode* node) {
+	switch (node->type) {
+		case BATCH_SELECT:
+			execute_batch_select(&node->select);
+			break;
+		case BATCH_FETCH:
+			execute_batch_fetch(&node->fetch);
+			break;
+		case BATCH_REFINE:
+			execute_batch_refine(&node->refine);
+			break;
+		default:
+			execute_db_operator(node->op);
+			break;
+	}
 }
 
-char* execute_db_batch(BatchOperator* batch) {
-	pthread_t select_threads[MAX_NUM_THREADS];
-	for (int i = 0; i < batch->num_ops_select; i+= MAX_NUM_THREADS) {
-		for (int j = 0; j < MAX_NUM_THREADS && i + j < batch->num_ops_select; j++) {
-			pthread_create(&select_threads[j % MAX_NUM_THREADS], NULL, run_batch_select, 
-					(void*) &batch->batch_select[i + j]);
-		}
-		for (int j = 0; j < MAX_NUM_THREADS && i + j < batch->num_ops_select; j++) {
-			int r = pthread_join(select_threads[j % MAX_NUM_THREADS], NULL);
-			if (r != 0)
-				return "-- Error occurred in batch execution";
-		}
+// runs ready nodes until every node of the batch has run
+static void* run_batch_worker(void* arg) {
+	BatchSchedule* schedule = arg;
+	BatchOperator* batch = schedule->batch;
+
+	pthread_mutex_lock(&schedule->lock);
+	while (true) {
+		while (schedule->head == schedule->tail && schedule->num_done < batch->num_nodes)
+			pthread_cond_wait(&schedule->changed, &schedule->lock);
+		if (schedule->head == schedule->tail)
+			break;
+		BatchNode* node = &batch->nodes[schedule->ready[schedule->head++]];
+		pthread_mutex_unlock(&schedule->lock);
+
+		run_batch_node(node);
+
+		pthread_mutex_lock(&schedule->lock);
+		schedule->num_done++;
+		for (int i = 0; i < node->num_successors; i++)
+			if (--batch->nodes[node->successors[i]].num_pending == 0)
+				schedule->ready[schedule->tail++] = node->successors[i];
+		pthread_cond_broadcast(&schedule->changed);
 	}
+	pthread_mutex_unlock(&schedule->lock);
+	return NULL;
+}
 
-	pthread_t fetch_threads[batch->num_ops_fetch];
-	for (int i = 0; i < batch->num_ops_fetch; i += MAX_NUM_THREADS) {
-		for (int j = 0; j < MAX_NUM_THREADS && i + j < batch->num_ops_fetch; j++) {
-			pthread_create(&fetch_threads[j % MAX_NUM_THREADS], NULL, run_batch_fetch, 
-					(void*) &batch->batch_fetch[i + j]);
-		}
-		for (int j = 0; j < MAX_NUM_THREADS && i + j < batch->num_ops_fetch; j++) {
-			int r = pthread_join(fetch_threads[j % MAX_NUM_THREADS], NULL);
-			if (r != 0)
-				return "-- Error occurred in batch execution";
+// frees what the batch's nodes hold and empties it for the next batch
+static void clear_batch(BatchOperator* batch) {
+	for (int i = 0; i < batch->num_nodes; i++) {
+		BatchNode* node = &batch->nodes[i];
+		for (int j = 0; j < node->select.num_ops; j++)
+			free(node->select.result_handles[j]);
+		for (int j = 0; j < node->fetch.num_ops; j++) {
+			free(node->fetch.positions_handles[j]);
+			free(node->fetch.result_handles[j]);
 		}
+		db_operator_free(node->op);
+		free(node->successors);
 	}
+	batch->num_nodes = 0;
+}
 
-	pthread_t other_threads[batch->num_ops_other];
-	for (int i = 0; i < batch->num_ops_other; i += MAX_NUM_THREADS) {
-		for (int j = 0; j < MAX_NUM_THREADS && i + j < batch->num_ops_other; j++) {
-			pthread_create(&other_threads[j % MAX_NUM_THREADS], NULL, run_batch_other, 
-					(void*) batch->other_ops[i + j]);
-		}
-		for (int j = 0; j < MAX_NUM_THREADS && i + j < batch->num_ops_other; j++) {
-			int r = pthread_join(other_threads[j % MAX_NUM_THREADS], NULL);
-			if (r != 0)
-				return "-- Error occurred in batch execution";
-		}
+char* execute_db_batch(BatchOperator* batch) {
+	// shared scans only read the zone maps of their column, so they are refreshed first
+	for (int i = 0; i < batch->num_nodes; i++)
+		if (batch->nodes[i].type == BATCH_SELECT
+				&& batch->nodes[i].select.column->compression == UNCOMPRESSED)
+			refresh_zones(batch->nodes[i].select.column);
+
+	BatchSchedule schedule;
+	schedule.batch = batch;
+	schedule.ready = malloc(sizeof *schedule.ready * (batch->num_nodes + 1));
+	if (!schedule.ready) {
+		clear_batch(batch);
+		return "-- Error occurred in batch execution";
 	}
+	schedule.head = 0;
+	schedule.tail = 0;
+	schedule.num_done = 0;
+	for (int i = 0; i < batch->num_nodes; i++)
+		if (batch->nodes[i].num_pending == 0)
+			schedule.ready[schedule.tail++] = i;
+	pthread_mutex_init(&schedule.lock, NULL);
+	pthread_cond_init(&schedule.changed, NULL);
+
+	// the calling thread works too; missing helpers only cost parallelism
+	pthread_t threads[MAX_NUM_THREADS];
+	int num_threads = 0;
+	while (num_threads < MAX_NUM_THREADS - 1 && num_threads < batch->num_nodes - 1
+			&& pthread_create(&threads[num_threads], NULL, run_batch_worker, &schedule) == 0)
+		num_threads++;
+	run_batch_worker(&schedule);
+	for (int t = 0; t < num_threads; t++)
+		pthread_join(threads[t], NULL);
+
+	pthread_cond_destroy(&schedule.changed);
+	pthread_mutex_destroy(&schedule.lock);
+	free(schedule.ready);
+	clear_batch(batch);
 	return "-- Batch executed!";
 }
-
@@ -0,0 +1,542 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "client_context.h"
+#include "compression.h"
+#include "cs165_api.h"
+#include "data_types.h"
+#include "expression.h"
+#include "result_pool.h"
+#include "utils.h"
+
+/*
+ * Arithmetic expressions.
+ * An expression such as add(a,mul(b,2)) is compiled to a postfix program over its
+ * operands and constants. The program is evaluated a block of EXPRESSION_BLOCK_VALUES
+ * positions at a time: every instruction runs a typed kernel over the block, leaving its
+ * result in a register that stays in cache for the next instruction. Consumers (select,
+ * the aggregates) read each block as it is produced, so sum(add(a,b)) or a select over
+ * sub(a,b) makes one pass over the data and never materializes the intermediates.
+ *
+ * All instructions compute in one type, the widest of the operands': INT, then LONG, then
+ * FLOAT. Integer constants take the expression's type unless they do not fit an int.
+ */
+
+typedef struct Function {
+	const char* name;
+	ExpressionOpcode opcode;
+} Function;
+
+static const Function functions[] = {
+	{"add", EXPR_ADD},
+	{"div", EXPR_DIV},
+	{"mul", EXPR_MUL},
+	{"sub", EXPR_SUB}
+};
+
+/**
+ * ExpressionProgram
+ * An expression bound to the vectors of its operands, ready to be evaluated.
+ * - blocks: one register block per stack slot, overwritten by any instruction that leaves
+ *   its result at that depth, followed by one block per instruction that holds the
+ *   broadcast value of an EXPR_CONSTANT
+ **/
+typedef struct ExpressionProgram {
+	Expression* expr;
+	DataType type;
+	size_t width;
+	size_t length;
+	Vector* operands[MAX_EXPRESSION_OPERANDS];
+	Vector views[MAX_EXPRESSION_OPERANDS];
+	Column* columns[MAX_EXPRESSION_OPERANDS]; // base column behind each view, if any
+	char* blocks;
+} ExpressionProgram;
+
+// whether a query argument is an expression rather than a handle, column or constant
+bool is_expression(const char* arg) {
+	return strchr(arg, '(') != NULL;
+}
+
+static int emit(Expression* expr, ExpressionInstruction* instr) {
+	if (expr->num_instructions == MAX_EXPRESSION_INSTRUCTIONS)
+		return -1;
+	expr->instructions[expr->num_instructions++] = *instr;
+	return 0;
+}
+
+// emits a constant, or a reference to the handle or column called name
+static int emit_leaf(Expression* expr, char* name) {
+	ExpressionInstruction instr;
+	memset(&instr, 0, sizeof instr);
+
+	bool number = isdigit((unsigned char) name[0]) || ((name[0] == '-' || name[0] == '.')
+			&& isdigit((unsigned char) name[1]));
+	if (number) {
+		char* end;
+		errno = 0;
+		instr.opcode = EXPR_CONSTANT;
+		if (strpbrk(name, ".eE")) {
+			instr.constant_type = FLOAT;
+			instr.constant.f = strtof(name, &end);
+		} else {
+			instr.constant_type = LONG;
+			instr.constant.l = strtol(name, &end, 10);
+		}
+		return *end != '\0' || errno ? -1 : emit(expr, &instr);
+	}
+
+	instr.opcode = EXPR_OPERAND;
+	for (instr.operand = 0; instr.operand < expr->num_operands; instr.operand++) {
+		if (strcmp(expr->operands[instr.operand], name) == 0)
+			return emit(expr, &instr);
+	}
+	if (expr->num_operands == MAX_EXPRESSION_OPERANDS
+			|| strlen(name) >= MAX_SIZE_QUALIFIED_NAME)
+		return -1;
+	strcpy(expr->operands[expr->num_operands++], name);
+	return emit(expr, &instr);
+}
+
+static int compile_node(Expression* expr, char** cursor);
+
+// compiles the two arguments of a call and then the call itself
+static int compile_call(Expression* expr, ExpressionOpcode opcode, char** cursor) {
+	char* p = *cursor;
+	if (compile_node(expr, &p) < 0 || *p != ',')
+		return -1;
+	p++;
+	if (compile_node(expr, &p) < 0 || *p != ')')
+		return -1;
+	*cursor = p + 1;
+
+	ExpressionInstruction instr;
+	memset(&instr, 0, sizeof instr);
+	instr.opcode = opcode;
+	return emit(expr, &instr);
+}
+
+// compiles the expression at *cursor, leaving *cursor after it
+static int compile_node(Expression* expr, char** cursor) {
+	char* start = *cursor;
+	char* p = start;
+	while (*p && *p != '(' && *p != ',' && *p != ')')
+		p++;
+	if (p == start)
+		return -1;
+
+	char separator = *p;
+	*p = '\0';
+	if (separator != '(') { // a leaf; restore the separator for the caller
+		int r = emit_leaf(expr, start);
+		*p = separator;
+		*cursor = p;
+		return r;
+	}
+
+	for (size_t i = 0; i < sizeof functions / sizeof functions[0]; i++) {
+		if (strcmp(functions[i].name, start) == 0) {
+			*cursor = p + 1;
+			return compile_call(expr, functions[i].opcode, cursor);
+		}
+	}
+	return -1;
+}
+
+/*
+ * compile_expression(Expression* expr, char* text)
+ * Compiles text, e.g. "add(a,mul(b,2))", into expr. The text is modified.
+ * Returns 0 on success, -1 if text is malformed or too large.
+ */
+int compile_expression(Expression* expr, char* text) {
+	expr->num_instructions = 0;
+	expr->num_operands = 0;
+	char* p = text;
+	return compile_node(expr, &p) < 0 || *p != '\0' ? -1 : 0;
+}
+
+/*
+ * compile_arithmetic(Expression* expr, OperatorType type, char** args)
+ * Compiles the call type(args[0],args[1]) of add, sub, mul or div, whose arguments may
+ * themselves be expressions. Returns 0 on success, -1 otherwise.
+ */
+int compile_arithmetic(Expression* expr, OperatorType type, char** args) {
+	ExpressionInstruction instr;
+	memset(&instr, 0, sizeof instr);
+	switch (type) {
+		case ADD: instr.opcode = EXPR_ADD; break;
+		case SUB: instr.opcode = EXPR_SUB; break;
+		case MUL: instr.opcode = EXPR_MUL; break;
+		case DIV: instr.opcode = EXPR_DIV; break;
+		default: return -1;
+	}
+
+	expr->num_instructions = 0;
+	expr->num_operands = 0;
+	for (int i = 0; i < 2; i++) {
+		char* p = args[i];
+		if (compile_node(expr, &p) < 0 || *p != '\0')
+			return -1;
+	}
+	return emit(expr, &instr);
+}
+
+// resolves the operands of expr to vectors, viewing base columns through views; if columns
+// is given, compressed columns are decoded and each viewed column is recorded in columns
+static int resolve_operands(Expression* expr, ClientContext* context, Vector** operands,
+		Vector* views, Column** columns) {
+	for (int i = 0; i < expr->num_operands; i++) {
+		operands[i] = lookup_vector(context, expr->operands[i]);
+		if (operands[i])
+			continue;
+		Column* column = lookup_column(expr->operands[i]);
+		if (!column) {
+			log_err("Could not find operand %s.\n", expr->operands[i]);
+			return -1;
+		}
+		if (!columns) {
+			views[i] = column_vector(column);
+		} else if (column_values(column, &views[i]) < 0) {
+			return -1;
+		} else {
+			columns[i] = column;
+		}
+		operands[i] = &views[i];
+	}
+	return 0;
+}
+
+static DataType wider_type(DataType a, DataType b) {
+	return a > b ? a : b;
+}
+
+static DataType program_type(Expression* expr, Vector** operands) {
+	DataType type = INT;
+	for (int i = 0; i < expr->num_operands; i++)
+		type = wider_type(type, operands[i]->type);
+	for (int i = 0; i < expr->num_instructions; i++) {
+		ExpressionInstruction* instr = &expr->instructions[i];
+		if (instr->opcode != EXPR_CONSTANT)
+			continue;
+		if (instr->constant_type == FLOAT)
+			type = FLOAT;
+		else if (instr->constant.l < INT_MIN || instr->constant.l > INT_MAX)
+			type = wider_type(type, LONG);
+	}
+	return type;
+}
+
+/*
+ * expression_type(Expression* expr, ClientContext* context, DataType* type)
+ * Sets type to the type expr evaluates to with its operands as they are now bound.
+ * Returns 0 on success, -1 if an operand does not exist.
+ */
+int expression_type(Expression* expr, ClientContext* context, DataType* type) {
+	Vector* operands[MAX_EXPRESSION_OPERANDS];
+	Vector views[MAX_EXPRESSION_OPERANDS];
+	if (resolve_operands(expr, context, operands, views, NULL) < 0)
+		return -1;
+	*type = program_type(expr, operands);
+	return 0;
+}
+
+static void* register_block(ExpressionProgram* p, int slot) {
+	return p->blocks + (size_t) slot * EXPRESSION_BLOCK_VALUES * p->width;
+}
+
+static void* constant_block(ExpressionProgram* p, int instruction) {
+	return register_block(p, p->expr->num_instructions + instruction);
+}
+
+// fills a block with constant, converted to type
+static void broadcast(Value constant, DataType constant_type, DataType type, void* out) {
+	switch (type) {
+#define BROADCAST_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: { \
+			ctype value = constant_type == FLOAT ? (ctype) constant.f : (ctype) constant.l; \
+			for (size_t i = 0; i < EXPRESSION_BLOCK_VALUES; i++) \
+				((ctype*) out)[i] = value; \
+			break; \
+		}
+		FOR_EACH_DATA_TYPE(BROADCAST_CASE)
+#undef BROADCAST_CASE
+	}
+}
+
+// binds expr to its operands; the program must be released with unbind_program
+static int bind_program(ExpressionProgram* p, Expression* expr, ClientContext* context) {
+	p->expr = expr;
+	p->blocks = NULL;
+	memset(p->columns, 0, sizeof p->columns);
+	if (expr->num_operands == 0
+			|| resolve_operands(expr, context, p->operands, p->views, p->columns) < 0)
+		return -1;
+
+	p->type = program_type(expr, p->operands);
+	p->width = data_type_size(p->type);
+	p->length = p->operands[0]->length;
+	for (int i = 1; i < expr->num_operands; i++) {
+		if (p->operands[i]->length != p->length) {
+			log_err("Operands of an expression must have the same length.\n");
+			return -1;
+		}
+	}
+
+	p->blocks = malloc(2 * expr->num_instructions * EXPRESSION_BLOCK_VALUES * p->width);
+	if (!p->blocks)
+		return -1;
+	for (int i = 0; i < expr->num_instructions; i++) {
+		ExpressionInstruction* instr = &expr->instructions[i];
+		if (instr->opcode == EXPR_CONSTANT)
+			broadcast(instr->constant, instr->constant_type, p->type, constant_block(p, i));
+	}
+	return 0;
+}
+
+static void unbind_program(ExpressionProgram* p) {
+	free(p->blocks);
+	p->blocks = NULL;
+	for (int i = 0; i < p->expr->num_operands; i++)
+		if (p->columns[i])
+			free_column_values(p->columns[i], &p->views[i]);
+}
+
+#define CONVERT_BLOCK(src_ctype) \
+	for (size_t i = 0; i < n; i++) \
+		dst[i] = COLUMN_DATA(operand, src_ctype)[start + i]
+
+// copies positions [start, start + n) of operand into out, converting them to type
+static void load_block(Vector* operand, size_t start, size_t n, DataType type, void* out) {
+	switch (type) {
+#define LOAD_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: { \
+			ctype* dst = out; \
+			switch (operand->type) { \
+				case INT: CONVERT_BLOCK(int); break; \
+				case LONG: CONVERT_BLOCK(long); break; \
+				case FLOAT: CONVERT_BLOCK(float); break; \
+			} \
+			break; \
+		}
+		FOR_EACH_DATA_TYPE(LOAD_CASE)
+#undef LOAD_CASE
+	}
+}
+
+// runs one arithmetic instruction over a block; returns false on division by zero
+static bool apply_opcode(ExpressionOpcode opcode, DataType type, const void* a, const void* b,
+		size_t n, void* out) {
+	switch (type) {
+#define APPLY_CASE(TYPE, ctype, field, sum_type, format) \
+		case TYPE: \
+			switch (opcode) { \
+				case EXPR_ADD: add_values_##TYPE(a, b, n, out); return true; \
+				case EXPR_SUB: sub_values_##TYPE(a, b, n, out); return true; \
+				case EXPR_MUL: mul_values_##TYPE(a, b, n, out); return true; \
+				case EXPR_DIV: return div_values_##TYPE(a, b, n, out); \
+				default: return false; \
+			}
+		FOR_EACH_DATA_TYPE(APPLY_CASE)
+#undef APPLY_CASE
+	}
+	return false;
+}
+
+/*
+ * Evaluates positions [start, start + n) of the program, n <= EXPRESSION_BLOCK_VALUES.
+ * The last instruction writes to out if given, and to a register otherwise.
+ * Returns the block of values, or NULL on division by zero.
+ */
+static void* evaluate_block(ExpressionProgram* p, size_t start, size_t n, void* out) {
+	Expression* expr = p->expr;
+	void* stack[MAX_EXPRESSION_INSTRUCTIONS];
+	int top = 0;
+	for (int i = 0; i < expr->num_instructions; i++) {
+		ExpressionInstruction* instr = &expr->instructions[i];
+		switch (instr->opcode) {
+			case EXPR_OPERAND: {
+				// operands of the program's type are read in place
+				Vector* operand = p->operands[instr->operand];
+				if (operand->type == p->type) {
+					stack[top] = (char*) operand->data + start * p->width;
+				} else {
+					stack[top] = register_block(p, top);
+					load_block(operand, start, n, p->type, stack[top]);
+				}
+				top++;
+				break;
+			}
+			case EXPR_CONSTANT:
+				stack[top++] = constant_block(p, i);
+				break;
+			default: {
+				top--;
+				void* target = out && i == expr->num_instructions - 1
+					? out : register_block(p, top - 1);
+				if (!apply_opcode(instr->opcode, p->type, stack[top - 1], stack[top], n, target))
+					return NULL;
+				stack[top - 1] = target;
+				break;
+			}
+		}
+	}
+	return stack[0];
+}
+
+// views a block of the program's values as a vector
+static Vector block_vector(ExpressionProgram* p, void* values, size_t n) {
+	Vector block;
+	memset(&block, 0, sizeof block);
+	block.data = values;
+	block.type = p->type;
+	block.length = n;
+	block.capacity = n;
+	return block;
+}
+
+static size_t block_length(ExpressionProgram* p, size_t start) {
+	return p->length - start < EXPRESSION_BLOCK_VALUES
+		? p->length - start : EXPRESSION_BLOCK_VALUES;
+}
+
+/*
+ * evaluate_expression(Expression* expr, ClientContext* context, Status* status)
+ * Materializes the values of expr into a new vector, which the caller owns.
+ * Returns NULL and sets status on failure.
+ */
+Vector* evaluate_expression(Expression* expr, ClientContext* context, Status* status) {
+	ExpressionProgram program;
+	Vector* result = NULL;
+	if (bind_program(&program, expr, context) == 0) {
+		result = alloc_vector(program.type);
+		bool ok = result && vector_reserve(result, program.length) == 0;
+		for (size_t start = 0; ok && start < program.length; start += EXPRESSION_BLOCK_VALUES) {
+			char* out = (char*) result->data + start * program.width;
+			ok = evaluate_block(&program, start, block_length(&program, start), out) != NULL;
+			if (!ok)
+				log_err("Division by zero.\n");
+		}
+		if (ok) {
+			result->length = program.length;
+		} else {
+			release_vector(result);
+			result = NULL;
+		}
+	}
+	unbind_program(&program);
+	if (!result)
+		status->code = ERROR;
+	return result;
+}
+
+/*
+ * select_expression(Expression* expr, ClientContext* context, Vector* positions,
+ *		Value low, Value high, Status* status)
+ * Returns the positions whose expression value lies in [low, high), with bounds of the
+ * type expr evaluates to. If positions is given, the operands were fetched at those
+ * positions and the matching ones are returned instead of offsets into the operands.
+ */
+Vector* select_expression(Expression* expr, ClientContext* context, Vector* positions,
+		Value low, Value high, Status* status) {
+	ExpressionProgram program;
+	Vector* result = NULL;
+	bool ok = bind_program(&program, expr, context) == 0
+		&& (!positions || positions->length == program.length);
+	if (ok) {
+		result = alloc_vector(INT);
+		ok = result && vector_reserve(result, program.length) == 0;
+	}
+
+	size_t k = 0;
+	for (size_t start = 0; ok && start < program.length; start += EXPRESSION_BLOCK_VALUES) {
+		size_t n = block_length(&program, start);
+		void* values = evaluate_block(&program, start, n, NULL);
+		if (!values) {
+			log_err("Division by zero.\n");
+			ok = false;
+			break;
+		}
+
+		Vector block = block_vector(&program, values, n);
+		if (positions) {
+			Vector block_positions = *positions;
+			block_positions.data = positions->data + start;
+			block_positions.length = n;
+			k += select_fetch_scan(&block_positions, &block, low, high, result->data + k);
+		} else {
+			size_t matches = select_scan(&block, low, high, result->data + k);
+			for (size_t j = 0; j < matches; j++)
+				result->data[k + j] += start;
+			k += matches;
+		}
+	}
+	unbind_program(&program);
+
+	if (!ok) {
+		release_vector(result);
+		status->code = ERROR;
+		return NULL;
+	}
+	result->length = k;
+	vector_trim(result);
+	if (!positions || positions->sorted)
+		vector_mark_sorted(result);
+	return result;
+}
+
+// adds a block's values to the fold
+static void fold_block(ExpressionFold* fold, Vector* block, bool first) {
+	switch (fold->type) {
+		case SUM:
+			if (block->type == FLOAT)
+				fold->float_sum += sum_values(block);
+			else if (block->type == LONG)
+				fold->sum += sum_LONG(COLUMN_DATA(block, long), block->length);
+			else
+				fold->sum += sum_INT(block->data, block->length);
+			break;
+		case AVERAGE:
+			fold->float_sum += sum_values(block);
+			break;
+		case MIN:
+		case MAX: {
+			Value v = fold->type == MIN ? min_value(block) : max_value(block);
+			int order = compare_values(v, fold->extreme, block->type);
+			if (first || (fold->type == MIN ? order < 0 : order > 0))
+				fold->extreme = v;
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/*
+ * fold_expression(Expression* expr, ClientContext* context, ExpressionFold* fold)
+ * Computes the aggregate fold->type of the values of expr in one pass.
+ * Returns 0 on success, -1 on failure.
+ */
+int fold_expression(Expression* expr, ClientContext* context, ExpressionFold* fold) {
+	ExpressionProgram program;
+	int r = bind_program(&program, expr, context);
+	if (r == 0) {
+		fold->data_type = program.type;
+		fold->count = program.length;
+		fold->sum = 0;
+		fold->float_sum = 0;
+		for (size_t start = 0; start < program.length; start += EXPRESSION_BLOCK_VALUES) {
+			size_t n = block_length(&program, start);
+			void* values = evaluate_block(&program, start, n, NULL);
+			if (!values) {
+				log_err("Division by zero.\n");
+				r = -1;
+				break;
+			}
+			Vector block = block_vector(&program, values, n);
+			fold_block(fold, &block, start == 0);
+		}
+	}
+	unbind_program(&program);
+	return r;
+}
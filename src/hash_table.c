@@ -6,7 +6,7 @@
 // The size parameter is the expected number of elements to be inserted.
 // This method returns an error code, 0 for success and -1 otherwise (e.g., if the parameter passed to the method is not null, if malloc fails, etc).
 int allocate(Hashtable** ht, int size) {
-	*ht = malloc(sizeof *ht);
+	*ht = malloc(sizeof **ht);
 	if (ht == NULL) return -1;
 	(*ht)->size = size;
 
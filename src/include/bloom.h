@@ -0,0 +1,31 @@
+#ifndef BLOOM_H__
+#define BLOOM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// filter bits per key, at least, and bits each key sets; under 1% false positives
+#define BLOOM_BITS_PER_KEY 16
+#define BLOOM_HASH_BITS 4
+
+/**
+ * BloomFilter
+ * A register-blocked Bloom filter over 64-bit key hashes: each key sets and tests
+ * BLOOM_HASH_BITS bits of a single word, so a lookup is one load and one compare.
+ * - num_words: a power of two
+ **/
+typedef struct BloomFilter {
+	uint64_t* words;
+	size_t num_words;
+} BloomFilter;
+
+int bloom_init(BloomFilter* filter, size_t expected_keys);
+
+void bloom_add(BloomFilter* filter, uint64_t hash);
+
+size_t bloom_select(BloomFilter* filter, const uint64_t* hashes, size_t n, uint32_t* selected);
+
+void bloom_free(BloomFilter* filter);
+
+#endif
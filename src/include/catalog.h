@@ -0,0 +1,32 @@
+#ifndef CATALOG_H__
+#define CATALOG_H__
+
+#include <stdint.h>
+
+#include "cs165_api.h"
+
+#define CATALOG_BASE_CAPACITY 64
+
+/**
+ * CatalogEntry
+ * One fully qualified name of the current db, "db.tbl" for a table or "db.tbl.col"
+ * for a column. column is NULL for table entries.
+ **/
+typedef struct CatalogEntry {
+	char name[MAX_SIZE_QUALIFIED_NAME];
+	uint32_t hash;
+	Table* table;
+	Column* column;
+} CatalogEntry;
+
+void catalog_clear();
+
+int catalog_add_table(Db* db, Table* table);
+
+int catalog_add_column(Db* db, Table* table, Column* column);
+
+int catalog_build(Db* db);
+
+CatalogEntry* catalog_find(const char* name);
+
+#endif
@@ -19,4 +19,13 @@ int add_handle(ClientContext* context, char* handle, bool result);
 
 int remove_handle(ClientContext* context, char* handle);
 
+GeneralizedColumnHandle* assign_handle(ClientContext* context, char* handle,
+		GeneralizedColumn value);
+
+GeneralizedColumnHandle* assign_vector_to_handle(Vector* vec, char* handle, ClientContext* context);
+
+Vector* lookup_vector(ClientContext* context, char* handle);
+
+void free_client_context(ClientContext* context);
+
 #endif
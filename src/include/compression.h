@@ -0,0 +1,62 @@
+#ifndef COMPRESSION_H__
+#define COMPRESSION_H__
+
+#include <stdint.h>
+
+#include "cs165_api.h"
+
+// number of values unpacked at a time by the compressed scan kernels
+#define DECODE_BLOCK_SIZE 1024
+#define MAX_DICTIONARY_SIZE 65536
+
+/**
+ * CompressedColumn
+ * Holds the encoded form of a base column.
+ * - FOR: values are stored as (value - min) bit-packed with bit_width bits
+ * - DICTIONARY: values are stored as bit-packed codes into the sorted dict array
+ * - RLE: values are stored as runs; run i covers positions [run_ends[i-1], run_ends[i])
+ * min and max are kept so that min/max aggregates need not touch the data.
+ **/
+typedef struct CompressedColumn {
+	int min;
+	int max;
+
+	int bit_width;
+	uint64_t* packed;
+	size_t num_words;
+
+	int* dict;
+	int dict_size;
+
+	int* run_values;
+	int* run_ends;
+	size_t num_runs;
+} CompressedColumn;
+
+Status compress_column(Column* col);
+
+Status decompress_column(Column* col);
+
+int column_values(Column* col, Vector* values);
+
+void free_column_values(Column* col, Vector* values);
+
+void compress_table(Table* table);
+
+void decompress_table(Table* table);
+
+void free_compressed_column(Column* col);
+
+void decode_range(Column* col, size_t start, size_t count, int* out);
+
+void select_compressed(Column* col, int low, int high, Vector* result);
+
+void fetch_compressed(Column* col, Vector* positions, Vector* result);
+
+long sum_compressed(Column* col);
+
+Status write_compressed_column(FILE* f, Column* col);
+
+Status read_compressed_column(FILE* f, Column* col);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CRACKING_H__
+#define CRACKING_H__
+
+#include "cs165_api.h"
+
+#define DEFAULT_CRACKER_INDEX_CAPACITY 64
+#define DEFAULT_CRACKER_UPDATE_CAPACITY 16
+
+/**
+ * CrackerColumn
+ * Adaptive index over a base column (database cracking).
+ * - values/positions: copy of the column values and their base positions, physically
+ *   reorganized by every select so that each queried bound becomes a piece boundary
+ * - length: number of base column rows merged into the cracker so far; rows appended
+ *   to the base column after that are merged lazily by the next select
+ * - pivots/starts: the cracker index. For each k, values[i] < pivots[k] for all
+ *   i < starts[k] and values[i] >= pivots[k] for all i >= starts[k]. Kept sorted by pivot.
+ * - pending_*: updates to the base column not yet merged into the cracker
+ **/
+typedef struct CrackerColumn {
+	int* values;
+	int* positions;
+	size_t length;
+	size_t capacity;
+
+	int* pivots;
+	size_t* starts;
+	int num_pivots;
+	int pivots_capacity;
+
+	int* pending_positions;
+	int* pending_old_values;
+	int num_pending;
+	int pending_capacity;
+} CrackerColumn;
+
+CrackerColumn* alloc_cracker();
+
+void free_cracker(CrackerColumn* cracker);
+
+void reset_cracker(CrackerColumn* cracker);
+
+int cracker_record_update(CrackerColumn* cracker, int position, int old_value);
+
+void select_cracker(Column* col, int low, int high, Vector* result, Status* status);
+
+#endif
@@ -22,14 +22,20 @@ SOFTWARE.
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // Limits the size of a name in our database to 64 characters
 #define MAX_SIZE_NAME 64
 #define HANDLE_MAX_SIZE 64
+// longest text of a select bound whose type is only known when the select executes
+#define SELECT_BOUND_MAX_SIZE 32
+// a fully qualified name, db.tbl.col
+#define MAX_SIZE_QUALIFIED_NAME (3 * MAX_SIZE_NAME)
 
 // MILESTONE 1: Only support single table queries
-#define MAX_NUM_HANDLES 64 
+// initial number of slots of a client handle map, which grows as needed
+#define HANDLE_MAP_BASE_CAPACITY 64
 #define MAX_NUM_TABLES 16 
 #define MAX_NUM_COLUMNS 256
 
@@ -37,6 +43,8 @@ SOFTWARE.
 #define DEFAULT_RESULT_BUFFER_LENGTH 4096 
 #define DEFAULT_LOAD_BUFFER_LENGTH 4096 
 #define MAX_NUM_PRINT_HANDLES 12
+// columns one fetch_multi gathers at the same positions
+#define MAX_FETCH_COLUMNS 12
 
 // Internal persistence
 #define SESSION_PATH ".session"
@@ -46,12 +54,14 @@ SOFTWARE.
 #define BEGIN_BATCH_MESSAGE "batch_queries"
 #define EXECUTE_BATCH_MESSAGE "batch_execute"
 #define MAX_NUM_BATCH_OPERATORS 16
-#define MAX_NUM_SHARED_SCAN 2 
+// most selects or fetches of a batch one pass over their column serves
+#define MAX_NUM_SHARED_SCAN 32
 #define MAX_NUM_THREADS 16
 
 // MILESTONE 3: Index
 #define BTREE_IDX_ARG "btree"
 #define SORTED_IDX_ARG "sorted"
+#define CRACKED_IDX_ARG "cracked" // adaptive index, always unclustered
 
 #define CLUSTERED_IDX_ARG "clustered"
 #define UNCLUSTERED_IDX_ARG "unclustered"
@@ -61,6 +71,13 @@ SOFTWARE.
 // MILESTONE 4: Joins
 #define NESTED_LOOP_JOIN_ARG "nested-loop"
 #define HASH_JOIN_ARG "hash"
+#define SORT_MERGE_JOIN_ARG "sort-merge"
+#define INDEX_JOIN_ARG "index"
+#define AUTO_JOIN_ARG "auto"
+#define GRACE_JOIN_ARG "grace"
+#define CACHE_JOIN_ARG "cache"
+// dimensions a star join probes in one pass over the fact rows
+#define MAX_STAR_DIMENSIONS 4
 
 //MILESTONE 5: Updates
 #define UPDATE_BUF_SIZE 128
@@ -70,9 +87,8 @@ SOFTWARE.
  * EXTRA
  * DataType
  * Flag to mark what type of data is held in the struct.
- * You can support additional types by including this enum and using void*
- * in place of int* in db_operator simliar to the way IndexType supports
- * additional types.
+ * Columns of any type keep their values in Column.data, which points at `type`
+ * values (int, long or float); position vectors are always INT.
  **/
 
 typedef enum DataType {
@@ -81,12 +97,50 @@ typedef enum DataType {
      FLOAT
 } DataType;
 
+/*
+ * X-macro over the column data types: X(type, C type, Value field, sum type, print format).
+ * Type-specific kernels are generated once per entry so that each gets a monomorphic loop.
+ */
+#define FOR_EACH_DATA_TYPE(X) \
+	X(INT, int, i, long, "%d") \
+	X(LONG, long, l, long, "%ld") \
+	X(FLOAT, float, f, double, "%.2f")
+
+/*
+ * a single value of any DataType, e.g. a predicate bound or an inserted field
+ */
+typedef union Value {
+	int i;
+	long l;
+	float f;
+} Value;
+
+// typed view of a column's or vector's values, e.g. COLUMN_DATA(col, long)[i]
+#define COLUMN_DATA(col, ctype) ((ctype*) (col)->data)
+
+/**
+ * CompressionType
+ * Encoding of a base column's data, chosen at load/checkpoint time.
+ * A compressed column keeps its values in `compressed` and has data == NULL.
+ **/
+typedef enum CompressionType {
+	UNCOMPRESSED = 0,
+	DICTIONARY,
+	RLE,
+	FOR
+} CompressionType;
+
 struct Comparator;
 struct ColumnIndex;
+struct CompressedColumn;
+struct CrackerColumn;
+struct ColumnStats;
+struct ZoneMap;
 
 typedef struct Column {
     char name[MAX_SIZE_NAME]; 
-    int* data;
+    int* data; // `type` values, see COLUMN_DATA; committed segment by segment, see storage.h
+	DataType type;
 	bool stale_index;
 	int updated_positions[UPDATE_BUF_SIZE];
 	int num_updated;
@@ -94,15 +148,67 @@ typedef struct Column {
 	int num_deleted;
 	size_t length;
 	size_t capacity;
+	size_t reserved; // values data can grow to in place
+	struct ZoneMap* zones; // bounds of each segment of data
+	size_t num_zones; // leading segments whose zone maps are current
+	size_t zones_capacity;
+	size_t version; // bumped whenever values change, see invalidate_zones
     struct ColumnIndex* index;
     bool clustered;
+	CompressionType compression;
+	struct CompressedColumn* compressed;
+	struct CrackerColumn* cracker; // null unless column has a cracked index
+	struct ColumnStats* stats; // refreshed by load and analyze, or lazily by the cost model
 } Column;
 
+struct ArenaChunk;
+
+/**
+ * Vector
+ * An intermediate result held by client handles, e.g. the positions of a select or the
+ * values of a fetch. Unlike a Column it has no name, index or update buffers.
+ * - data: `type` values, see COLUMN_DATA; allocated from an arena chunk, see result_pool.h
+ * - sorted: the values are in ascending order, e.g. positions produced by a scan
+ * - has_range: min and max bound the values
+ * - stats: borrowed from the base column the values were fetched from, if any
+ * - column: the base column the values were fetched from, if any, e.g. to use its index;
+ *   column_version is the column's version at the time, so that later changes show
+ * - ref_count: number of handles referring to the vector
+ **/
+typedef struct Vector {
+	int* data;
+	DataType type;
+	size_t length;
+	size_t capacity;
+	bool sorted;
+	bool has_range;
+	Value min;
+	Value max;
+	struct ColumnStats* stats;
+	struct Column* column;
+	size_t column_version;
+	struct ArenaChunk* chunk;
+	int ref_count;
+} Vector;
+
 typedef enum IndexType {
 	BTREE,
-	SORTED
+	SORTED,
+	CRACKED
 } IndexType;
 
+/**
+ * AccessPath
+ * How select_all evaluates a range predicate on a column.
+ * Chosen per predicate by the cost model in index.c.
+ **/
+typedef enum AccessPath {
+	SCAN,
+	SORTED_PROBE,
+	BTREE_PROBE,
+	CRACKER_PROBE
+} AccessPath;
+
 typedef struct Node {
 	int vals[DEFAULT_BTREE_NODE_CAPACITY];
 	void* children[DEFAULT_BTREE_NODE_CAPACITY+1];
@@ -194,25 +300,26 @@ typedef struct Result {
     size_t num_tuples;
     DataType data_type;
     void *payload;
+    int ref_count; // number of handles referring to the result
 } Result;
 
 /*
- * an enum which allows us to differentiate between columns and results
+ * an enum which allows us to differentiate between vectors and results
  */
 typedef enum GeneralizedColumnType {
     RESULT,
-    COLUMN
+    VECTOR
 } GeneralizedColumnType;
 /*
-t* a union type holding either a column or a result struct
+t* a union type holding either a vector or a result struct
  */
 typedef union GeneralizedColumnPointer {
     Result* result;
-    Column* column;
+    Vector* vector;
 } GeneralizedColumnPointer;
 
 /*
- * unifying type holding either a column or a result
+ * unifying type holding either a vector or a result
  */
 typedef struct GeneralizedColumn {
     GeneralizedColumnType column_type;
@@ -224,12 +331,15 @@ typedef struct GeneralizedColumn {
  */
 
 typedef struct GeneralizedColumnHandle {
-    char name[HANDLE_MAX_SIZE];
+    char name[HANDLE_MAX_SIZE]; // empty for a free slot of the handle map
+    uint32_t hash;
     GeneralizedColumn generalized_column;
 } GeneralizedColumnHandle;
 
 /*
  * holds the information necessary to refer to generalized columns (results or columns)
+ * chandle_table is an open-addressing hash map from handle name to handle with
+ * chandle_slots slots (a power of two), at most half of them in use.
  */
 typedef struct ClientContext {
     GeneralizedColumnHandle* chandle_table;
@@ -269,7 +379,12 @@ typedef enum OperatorType {
 	MAX,
 	MIN,
 	ADD,
-	SUB
+	SUB,
+	MUL,
+	DIV,
+	ANALYZE,
+	STAR_JOIN,
+	FETCH_MULTI
 } OperatorType;
 
 /*
@@ -287,9 +402,10 @@ typedef enum CreateType {
  */
 typedef struct CreateOperator {
 	CreateType type;
-	char* name;
+	char name[MAX_SIZE_NAME]; // for create_db, create_table and create_col
 	size_t column_count; // for create_table
 	Table* table; // for create_col
+	DataType data_type; // for create_col
 	Column* column; // for create_idx
 	IndexType idx_type; // for create_idx
 	bool clustered; // for create_idx
@@ -300,7 +416,7 @@ typedef struct CreateOperator {
  */
 typedef struct InsertOperator {
     Table* table;
-    int* values;
+    Value* values;
 } InsertOperator;
 
 /*
@@ -308,9 +424,9 @@ typedef struct InsertOperator {
  */
 typedef struct UpdateOperator {
     Column* column;
-	char* positions_handle;
+	char positions_handle[HANDLE_MAX_SIZE];
 	Table* table;
-    int value;
+    Value value;
 } UpdateOperator;
 
 /*
@@ -318,9 +434,16 @@ typedef struct UpdateOperator {
  */
 typedef struct DeleteOperator {
     Table* table;
-	char* positions_handle;
+	char positions_handle[HANDLE_MAX_SIZE];
 } DeleteOperator;
 
+/*
+ * necessary fields for analyze
+ */
+typedef struct AnalyzeOperator {
+	Table* table;
+} AnalyzeOperator;
+
 /*
  * necessary fields for open
  */
@@ -328,15 +451,52 @@ typedef struct OpenOperator {
     char* filename;
 } OpenOperator;
 
+// bounds of the arithmetic expressions that can be passed to add, sub, mul, div, select and
+// the unary aggregates, e.g. sum(add(a,mul(b,2)))
+#define MAX_EXPRESSION_INSTRUCTIONS 16
+#define MAX_EXPRESSION_OPERANDS 8
+
+typedef enum ExpressionOpcode {
+	EXPR_OPERAND,
+	EXPR_CONSTANT,
+	EXPR_ADD,
+	EXPR_SUB,
+	EXPR_MUL,
+	EXPR_DIV
+} ExpressionOpcode;
+
+typedef struct ExpressionInstruction {
+	ExpressionOpcode opcode;
+	int operand; // index into the expression's operands, for EXPR_OPERAND
+	Value constant; // for EXPR_CONSTANT, a LONG or a FLOAT as given by constant_type
+	DataType constant_type;
+} ExpressionInstruction;
+
+/*
+ * An arithmetic expression over handles, columns and constants, compiled to postfix order.
+ * Operands are kept by name and resolved when the expression is evaluated.
+ */
+typedef struct Expression {
+	ExpressionInstruction instructions[MAX_EXPRESSION_INSTRUCTIONS];
+	int num_instructions; // 0 if the operator has no expression
+	char operands[MAX_EXPRESSION_OPERANDS][MAX_SIZE_QUALIFIED_NAME]; // handles or columns
+	int num_operands;
+} Expression;
+
 /*
  * necessary fields for select
  */
 typedef struct SelectOperator {
-	Column* column;
-	Column* values;
-	int low;
-	int high;
-	char* result_handle;
+	Column* column; // null when selecting from values or an expression
+	Expression expression;
+	Value low; // bounds of a select on a column, which have its type
+	Value high;
+	// bounds of a select on values, parsed once their type is known when it executes
+	char low_arg[SELECT_BOUND_MAX_SIZE];
+	char high_arg[SELECT_BOUND_MAX_SIZE];
+	char positions_handle[HANDLE_MAX_SIZE]; // names of positions and values, empty if unused
+	char values_handle[HANDLE_MAX_SIZE];
+	char result_handle[HANDLE_MAX_SIZE];
 } SelectOperator;
 
 /*
@@ -344,33 +504,81 @@ typedef struct SelectOperator {
  */
 typedef struct FetchOperator {
 	Column* column;
-	char* positions_handle;
-	char* result_handle;
+	char positions_handle[HANDLE_MAX_SIZE];
+	char result_handle[HANDLE_MAX_SIZE];
 } FetchOperator;
 
+/*
+ * necessary fields for fetching several columns of a table at the same positions
+ */
+typedef struct FetchMultiOperator {
+	Column* columns[MAX_FETCH_COLUMNS];
+	int num_columns;
+	char positions_handle[HANDLE_MAX_SIZE];
+	char result_handles[MAX_FETCH_COLUMNS][HANDLE_MAX_SIZE];
+} FetchMultiOperator;
+
 /*
  * necessary fields for fetch
  */
 typedef enum JoinType {
 	NESTED_LOOP,
-	HASH
+	HASH,
+	SORT_MERGE,
+	INDEX_NESTED_LOOP,
+	AUTO, // chosen by the join planner
+	GRACE_HASH // a hash join that spills to partition files whatever the free memory
 } JoinType;
 
+/**
+ * JoinPlan
+ * How a join runs: the algorithm, chosen by the planner for AUTO joins, and the sides.
+ * - first_is_a: whether the first input is side a, which is the inner side of a
+ *   nested-loop join, the build side of a hash join and the outer side of an index join
+ * - spill: whether a hash join partitions its inputs to temporary files first
+ * - semi_join: whether a hash join first drops the probe rows that a Bloom filter over the
+ *   build keys rules out
+ * - num_partitions: fan-out of a hash join over int keys, or number of partition files of
+ *   a spilling one
+ **/
+typedef struct JoinPlan {
+	JoinType type;
+	bool first_is_a;
+	bool spill;
+	bool semi_join;
+	int num_partitions;
+} JoinPlan;
+
 typedef struct JoinOperator {
-	char* positions_1;
-	char* values_1;
-	char* positions_2;
-	char* values_2;
-	char* result_1;
-	char* result_2;
+	char positions_1[HANDLE_MAX_SIZE];
+	char values_1[HANDLE_MAX_SIZE];
+	char positions_2[HANDLE_MAX_SIZE];
+	char values_2[HANDLE_MAX_SIZE];
+	char result_1[HANDLE_MAX_SIZE];
+	char result_2[HANDLE_MAX_SIZE];
 	JoinType type;
+	bool cache_build; // keep a hash join's build for later joins over the same rows
 } JoinOperator;
 
+/*
+ * necessary fields for star join: the fact positions and, per dimension, the fact side's
+ * foreign keys (a handle aligned with the fact positions or a base column) and the
+ * dimension's keys and positions
+ */
+typedef struct StarJoinOperator {
+	char fact_positions[HANDLE_MAX_SIZE];
+	char fact_keys[MAX_STAR_DIMENSIONS][MAX_SIZE_QUALIFIED_NAME];
+	char values[MAX_STAR_DIMENSIONS][HANDLE_MAX_SIZE];
+	char positions[MAX_STAR_DIMENSIONS][HANDLE_MAX_SIZE];
+	int num_dimensions;
+	char results[MAX_STAR_DIMENSIONS + 1][HANDLE_MAX_SIZE]; // fact, then each dimension
+} StarJoinOperator;
+
 /*
  * necessary fields for print
  */
 typedef struct PrintOperator {
-	char** handles;
+	char handles[MAX_NUM_PRINT_HANDLES][MAX_SIZE_QUALIFIED_NAME]; // handles or columns
 	int num_handles;
 } PrintOperator;
 
@@ -379,18 +587,18 @@ typedef struct PrintOperator {
  * e.g. sum, avg, min, max
  */
 typedef struct UnaryAggOperator {
-	char* result_handle;
-	char* handle;
+	char result_handle[HANDLE_MAX_SIZE];
+	char handle[MAX_SIZE_QUALIFIED_NAME]; // a handle or a column
+	Expression expression; // aggregated instead of handle if it has instructions
 } UnaryAggOperator;
 
 /*
- * necessary fields for any unary aggregate operator
- * e.g. sum, avg, min, max
+ * necessary fields for any binary aggregate operator
+ * e.g. add, sub, mul, div, whose operands may themselves be expressions
  */
 typedef struct BinaryAggOperator {
-	char* result_handle;
-	char* handle1;
-	char* handle2;
+	char result_handle[HANDLE_MAX_SIZE];
+	Expression expression;
 } BinaryAggOperator;
 
 /*
@@ -404,10 +612,13 @@ typedef union OperatorFields {
     OpenOperator open_operator;
 	SelectOperator select_operator;
 	FetchOperator fetch_operator;
+	FetchMultiOperator fetch_multi_operator;
 	JoinOperator join_operator;
+	StarJoinOperator star_join_operator;
 	PrintOperator print_operator;
 	UnaryAggOperator unary_aggregate_operator;
 	BinaryAggOperator binary_aggregate_operator;
+	AnalyzeOperator analyze_operator;
 } OperatorFields;
 
 /*
@@ -441,18 +652,47 @@ typedef struct BatchFetch {
 	ClientContext* context;
 } BatchFetch;
 
-typedef struct BatchOperator {
-	BatchSelect* batch_select;
-	int num_ops_select;
-	int ops_capacity_select;
+/*
+ * A batched select answered from the result of an earlier select over a range containing
+ * its own: the same positions if the ranges are equal, else those positions filtered
+ */
+typedef struct BatchRefine {
+	Column* column;
+	char source_handle[HANDLE_MAX_SIZE];
+	int low;
+	int high;
+	bool alias; // the source's range is the same
+	char result_handle[HANDLE_MAX_SIZE];
+	ClientContext* context;
+} BatchRefine;
+
+typedef enum BatchNodeType {
+	BATCH_SELECT,
+	BATCH_FETCH,
+	BATCH_REFINE,
+	BATCH_OTHER
+} BatchNodeType;
 
-	BatchFetch* batch_fetch;
-	int num_ops_fetch;
-	int ops_capacity_fetch;
+/*
+ * A unit of batch execution: shared selects or fetches over one column, or any other
+ * operator on its own. A node runs once every node it depends on has run.
+ */
+typedef struct BatchNode {
+	BatchNodeType type;
+	BatchSelect select; // for BATCH_SELECT
+	BatchFetch fetch; // for BATCH_FETCH
+	BatchRefine refine; // for BATCH_REFINE
+	DbOperator* op; // for BATCH_OTHER
+	int* successors; // nodes that depend on this one
+	int num_successors;
+	int successors_capacity;
+	int num_pending; // dependencies that have not run yet
+} BatchNode;
 
-	DbOperator** other_ops;
-	int num_ops_other;
-	int ops_capacity_other;
+typedef struct BatchOperator {
+	BatchNode* nodes; // in arrival order, so a node only depends on earlier nodes
+	int num_nodes;
+	int nodes_capacity;
 } BatchOperator;
 
 extern Db *current_db;
@@ -465,32 +705,36 @@ Status create_db(const char* db_name);
 
 Status create_table(Db* db, const char* name, size_t num_columns);
 
-Status create_column(char *name, Table *table, bool sorted);
+Status create_column(char *name, Table *table, DataType type, bool sorted);
 
 Status create_index(Column* col, IndexType type, bool clustered);
 
-Status load(char* header_line, int* data, int data_length);
+Status load(char* header_line, char* data, size_t data_length);
 
 Status open_db(char* db_name);
 
-Status relational_insert(Table* table, int* values);
+Status relational_insert(Table* table, Value* values);
+
+Status relational_update(Column* column, Vector* positions, Table* table, Value value);
+
+Status relational_delete(Table* table, Vector* positions);
 
-Status relational_update(Column* column, Column* positions, Table* table, int value);
+Vector* select_all(Column* col, Value low, Value high, AccessPath* path, Status* status);
 
-Status relational_delete(Table* table, Column* positions);
+Vector* select_fetch(Vector* positions, Vector* values, Value low, Value high, Status* status);
 
-Column* select_all(Column* col, int low, int high, Status* status);
+Vector* fetch(Column* col, Vector* positions, Status* status);
 
-Column* select_fetch(Column* positions, Column* values, int low, int high, Status* status);
+Vector** fetch_multi(Column** cols, int num_columns, Vector* positions, Status* status);
 
-Column* fetch(Column* col, Column* positions, Status* status);
+Vector** join(Vector* positions_1, Vector* positions_2, Vector* values_1, Vector* values_2, 
+		JoinType type, bool cache_build, JoinPlan* plan, Status* status);
 
-Column** join(Column* positions_1, Column* positions_2, Column* values_1, Column* values_2, 
-		JoinType type, Status* status);
+Vector** select_batch(Column* col, int* lows, int* highs, int num_ops, Status* status);
 
-Column** select_batch(Column* col, int* lows, int* highs, int num_ops, Status* status);
+Vector** fetch_batch(Column* col, Vector** positions, int num_ops, Status* status);
 
-Column** fetch_batch(Column* col, Column** positions, int num_ops, Status* status);
+Vector* refine_select(Column* col, Vector* positions, int low, int high, Status* status);
 
 double average_column(Column* col);
 
@@ -0,0 +1,84 @@
+#ifndef DATA_TYPES_H__
+#define DATA_TYPES_H__
+
+#include "cs165_api.h"
+
+size_t data_type_size(DataType type);
+
+int parse_data_type(char* token, DataType* type);
+
+int parse_value(char* token, DataType type, Value* value);
+
+int parse_bounds(char* low_arg, char* high_arg, DataType type, Value* low, Value* high);
+
+Value data_type_min(DataType type);
+
+Value data_type_max(DataType type);
+
+int compare_values(Value a, Value b, DataType type);
+
+Value get_value(Column* col, size_t i);
+
+void set_value(Column* col, size_t i, Value value);
+
+int format_value(Vector* vec, size_t i, char* buf, size_t size);
+
+Vector column_vector(Column* col);
+
+// positions fetched ahead of the one being read by the prefetching gathers
+#define GATHER_PREFETCH_DISTANCE 16
+// columns up to this many bytes stay cached during a gather, so it is never clustered
+#define GATHER_CACHE_BYTES ((size_t) 4 << 20)
+// fewer unsorted positions than this are gathered directly
+#define GATHER_CLUSTER_MIN 4096
+// most regions positions are clustered into, so that each gets its own write stream
+#define GATHER_MAX_REGIONS 1024
+
+/*
+ * Kernels generated per DataType, e.g. select_scan_LONG(const long* data, ...).
+ * - select_scan: writes positions start <= i < end with low <= data[i] < high to out, returns
+ *   their count
+ * - select_fetch_scan: same over a values vector, writing positions[i] instead of i
+ * - gather: out[i] = data[positions[i]]
+ * - gather_prefetch: the same, prefetching GATHER_PREFETCH_DISTANCE positions ahead
+ * - gather_scatter: out[order[i]] = data[positions[i]], prefetching likewise
+ * - add_values/sub_values/mul_values: element-wise sum, difference and product of a and b
+ * - div_values: element-wise out[i] = a[i] / b[i]; returns false if some b[i] is 0
+ */
+#define DECLARE_KERNELS(TYPE, ctype, field, sum_type, format) \
+	size_t select_scan_##TYPE(const ctype* data, size_t start, size_t end, ctype low, \
+			ctype high, int* out); \
+	size_t select_fetch_scan_##TYPE(const int* positions, const ctype* values, size_t n, \
+			ctype low, ctype high, int* out); \
+	void gather_##TYPE(const ctype* data, const int* positions, size_t n, ctype* out); \
+	void gather_prefetch_##TYPE(const ctype* data, const int* positions, size_t n, \
+			ctype* out); \
+	void gather_scatter_##TYPE(const ctype* data, const int* positions, const int* order, \
+			size_t n, ctype* out); \
+	sum_type sum_##TYPE(const ctype* data, size_t n); \
+	ctype min_##TYPE(const ctype* data, size_t n); \
+	ctype max_##TYPE(const ctype* data, size_t n); \
+	void add_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out); \
+	void sub_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out); \
+	void mul_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out); \
+	bool div_values_##TYPE(const ctype* a, const ctype* b, size_t n, ctype* out);
+
+FOR_EACH_DATA_TYPE(DECLARE_KERNELS)
+
+// dispatchers over the per-type kernels; base columns are passed as column_vector views
+size_t select_scan(Vector* vec, Value low, Value high, int* out);
+
+size_t select_scan_range(Vector* vec, size_t start, size_t end, Value low, Value high,
+		int* out);
+
+size_t select_fetch_scan(Vector* positions, Vector* values, Value low, Value high, int* out);
+
+void gather(Vector* vec, Vector* positions, void* out);
+
+double sum_values(Vector* vec);
+
+Value min_value(Vector* vec);
+
+Value max_value(Vector* vec);
+
+#endif
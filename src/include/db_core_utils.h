@@ -1,7 +1,11 @@
 #include "cs165_api.h"
 
-void realloc_column(Column* col, Status* status);
-
 void update_column_with_deletes(Column* col);
 
 Table* table_for_column(Column* col);
+
+int lower_bound(int* arr, int len, long val);
+
+int compare_ints(const void* a, const void* b);
+
+Vector* alloc_fetch_result(Column* col, size_t length);
@@ -23,13 +23,19 @@ char* execute_select(DbOperator* query);
 
 char* execute_fetch(DbOperator* query);
 
+char* execute_fetch_multi(DbOperator* query);
+
 char* execute_join(DbOperator* query);
 
+char* execute_star_join(DbOperator* query);
+
 char* execute_print(DbOperator* query);
 
 char* execute_unary_aggregate(DbOperator* query);
 
 char* execute_binary_aggregate(DbOperator* query);
 
+char* execute_analyze(DbOperator* query);
+
 char* execute_shutdown();
 #endif
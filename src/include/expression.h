@@ -0,0 +1,42 @@
+#ifndef EXPRESSION_H__
+#define EXPRESSION_H__
+
+#include "cs165_api.h"
+
+// values evaluated per pass over an expression; a block of every register fits in L1/L2
+#define EXPRESSION_BLOCK_VALUES 1024
+
+/**
+ * ExpressionFold
+ * Running aggregate of an expression's values, computed without materializing them.
+ * - type: the aggregate to compute, one of SUM, AVERAGE, MIN or MAX
+ * - data_type: type the expression evaluates to
+ * - sum: sum of INT and LONG values; float_sum: sum of FLOAT values, and of any values
+ *   for AVERAGE
+ * - extreme: the minimum or maximum value
+ **/
+typedef struct ExpressionFold {
+	OperatorType type;
+	DataType data_type;
+	size_t count;
+	long sum;
+	double float_sum;
+	Value extreme;
+} ExpressionFold;
+
+bool is_expression(const char* arg);
+
+int compile_expression(Expression* expr, char* text);
+
+int compile_arithmetic(Expression* expr, OperatorType type, char** args);
+
+int expression_type(Expression* expr, ClientContext* context, DataType* type);
+
+Vector* evaluate_expression(Expression* expr, ClientContext* context, Status* status);
+
+Vector* select_expression(Expression* expr, ClientContext* context, Vector* positions,
+		Value low, Value high, Status* status);
+
+int fold_expression(Expression* expr, ClientContext* context, ExpressionFold* fold);
+
+#endif
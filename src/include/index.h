@@ -9,7 +9,18 @@
  */
 int* sort(int* arr, int arr_len, int* positions, Table* table);
 
-void select_index(Column* col, int low, int high, Column* result, Status* status);
+int radix_sort(uint64_t* keys, int* payload, size_t n);
+
+// relative costs used to choose an access path, in units of one sequential row compare
+#define SCAN_ROW_COST 1.0
+#define INDEX_ROW_COST 1.0
+#define SORT_ROW_COST 1.0
+#define RANDOM_ACCESS_COST 20.0
+
+void select_index(Column* col, int low, int high, AccessPath path, Vector* result, 
+		Status* status);
+
+AccessPath choose_access_path(Column* col, int low, int high);
 
 Status construct_index(Column* col, Table* table);
 
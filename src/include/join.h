@@ -1,13 +1,92 @@
+#ifndef JOIN_H__
+#define JOIN_H__
+
+#include <pthread.h>
+
 #include "cs165_api.h"
+#include "hash_table.h"
+
+// keys a hash join gives partitions of their own at most
+#define MAX_HEAVY_KEYS 64
+
+/**
+ * JoinPartition
+ * One partition of the build side of a hash join over int keys: its side a rows and the
+ * table built over them, sized for expected_distinct keys.
+ **/
+typedef struct JoinPartition {
+	Vector* positions_a;
+	Vector* values_a;
+	size_t expected_distinct;
+	Hashtable* table;
+} JoinPartition;
+
+/**
+ * JoinBuild
+ * The build side of a hash join over int keys: num_partitions hash partitions followed
+ * by one partition per heavy hitter key. Shared through the build cache, so it is
+ * reference counted.
+ * - heavy: the heavy hitter keys in ascending order
+ * - bytes: approximate memory held
+ **/
+typedef struct JoinBuild {
+	int num_partitions;
+	int heavy[MAX_HEAVY_KEYS];
+	int num_heavy;
+	JoinPartition* parts;
+	size_t bytes;
+	int ref_count;
+} JoinBuild;
 
-typedef struct JoinThreadArgs {
-	Column* positions_a;
-	Column* positions_b;
-	Column* values_a;
-	Column* values_b;
+/**
+ * JoinTask
+ * A unit of hash join work: building the table of a partition or, if build is false,
+ * probing it with the side b rows in [start, end) of positions_b and values_b and
+ * keeping the pairs in results.
+ **/
+typedef struct JoinTask {
+	JoinPartition* partition;
+	bool build;
+	Vector* positions_b;
+	Vector* values_b;
+	size_t start;
+	size_t end;
+	Vector** results;
+} JoinTask;
+
+/**
+ * JoinWorkers
+ * Tasks shared by the threads of a hash join; each thread takes the next task until
+ * none are left.
+ **/
+typedef struct JoinWorkers {
+	JoinTask* tasks;
+	size_t num_tasks;
+	size_t next_task;
+	pthread_mutex_t lock;
 	Status* status;
-	Column*** results;
-} JoinThreadArgs;
+} JoinWorkers;
+
+/**
+ * StarDimension
+ * One dimension of a star join.
+ * - fact_keys: the fact side's foreign keys, aligned with the fact positions or, if
+ *   gather is set, a whole base column indexed by them
+ * - values, positions: the dimension's keys and their positions
+ **/
+typedef struct StarDimension {
+	Vector* fact_keys;
+	bool gather;
+	Vector* values;
+	Vector* positions;
+} StarDimension;
+
+Vector** join(Vector* positions_1, Vector* positions_2, Vector* values_1, Vector* values_2,
+		JoinType type, bool cache_build, JoinPlan* plan, Status* status);
+
+Vector** star_join(Vector* fact_positions, StarDimension* dimensions, int num_dimensions,
+		Status* status);
+
+void clear_build_cache();
 
-Column** join(Column* positions_1, Column* positions_2, Column* values_1, Column* values_2,
-		JoinType type, Status* status);
+#endif
@@ -2,6 +2,6 @@
 
 int send_load_data(char* read_buffer, int sock_fd);
 
-int read_data(FILE* fp, int* buf);
+int read_data(FILE* fp, char* buf);
 
 char* extract_load_filename(char* buffer);
@@ -4,36 +4,73 @@
 #include "message.h"
 #include "client_context.h"
 
-DbOperator* parse_command(char* query_command, message* send_message, int client, ClientContext* context);
+// relational_insert takes the table and one value per column
+#define MAX_NUM_QUERY_ARGS (MAX_NUM_COLUMNS + 1)
+
+/**
+ * QueryTokens
+ * A query split in place, e.g. handle=command(args[0],...,args[num_args-1]).
+ * All tokens point into the query string, with whitespace and quotes removed.
+ * - handle: the text left of '=', NULL if the query assigns no handle
+ * - has_args: whether the command was followed by a parenthesized argument list
+ **/
+typedef struct QueryTokens {
+	char* handle;
+	char* command;
+	char* args[MAX_NUM_QUERY_ARGS];
+	int num_args;
+	bool has_args;
+} QueryTokens;
+
+/*
+ * A parser builds the DbOperator of one command from its tokens. type is the operator
+ * type registered for the command, which lets e.g. sum and avg share a parser.
+ */
+typedef DbOperator* (*CommandParser)(QueryTokens* tokens, OperatorType type,
+		ClientContext* context, message* send_message);
 
-DbOperator* parse_create(char* create_arguments, message* send_message);
+DbOperator* parse_command(char* query_command, message* send_message, int client, ClientContext* context);
 
-DbOperator* parse_create_db(char* create_db_arguments, message* send_message);
+DbOperator* parse_create(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_create_tbl(char* create_tbl_arguments, message* send_message);
+DbOperator* parse_insert(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_create_col(char* create_col_arguments, message* send_message);
+DbOperator* parse_update(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_create_idx(char* create_idx_arguments, message* send_message);
+DbOperator* parse_delete(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_insert(char* insert_arguments, message* send_message);
+DbOperator* parse_select(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_update(char* update_arguments, message* send_message);
+DbOperator* parse_fetch(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_delete(char* delete_arguments, message* send_message);
+DbOperator* parse_fetch_multi(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_select(char* select_arguments, ClientContext* context, message* send_message);
+DbOperator* parse_join(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_fetch(char* fetch_arguments, message* send_message);
+DbOperator* parse_star_join(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_join(char* join_arguments, message* send_message);
+DbOperator* parse_print(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_print(char* print_arguments, message* send_message);
+DbOperator* parse_unary_aggregate(QueryTokens* tokens, OperatorType type,
+		ClientContext* context, message* send_message);
 
-DbOperator* parse_unary_aggregate(char* unary_agg_arguments, message* send_message);
+DbOperator* parse_binary_aggregate(QueryTokens* tokens, OperatorType type,
+		ClientContext* context, message* send_message);
 
-DbOperator* parse_binary_aggregate(char* binary_agg_arguments, message* send_message);
+DbOperator* parse_analyze(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
-DbOperator* parse_shutdown(message* send_message);
+DbOperator* parse_shutdown(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message);
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef RESULT_POOL_H__
+#define RESULT_POOL_H__
+
+#include "cs165_api.h"
+
+// number of vector headers carved from each slab
+#define RESULT_POOL_SLAB_SIZE 64
+// bytes of a regular arena chunk, which buffers of up to ARENA_DEDICATED_SIZE bytes share;
+// larger buffers get a chunk of their own that is resized along with them
+#define ARENA_CHUNK_SIZE (1 << 20)
+#define ARENA_DEDICATED_SIZE (ARENA_CHUNK_SIZE / 16)
+// vector buffers start on a cache line
+#define ARENA_ALIGNMENT 64
+
+/**
+ * ArenaChunk
+ * A block of memory that vector buffers are bump-allocated from.
+ * - used: bytes handed out so far; the next buffer starts at data + used
+ * - live: number of vectors with a buffer in the chunk
+ * - dedicated: whether the chunk holds the buffer of a single vector and nothing else
+ **/
+typedef struct ArenaChunk {
+	size_t capacity;
+	size_t used;
+	int live;
+	bool dedicated;
+	char data[];
+} ArenaChunk;
+
+Vector* alloc_vector(DataType type);
+
+int vector_reserve(Vector* vec, size_t num_values);
+
+int vector_grow(Vector* vec, size_t num_values);
+
+void vector_trim(Vector* vec);
+
+void vector_mark_sorted(Vector* positions);
+
+void retain_vector(Vector* vec);
+
+void release_vector(Vector* vec);
+
+Result* alloc_result();
+
+void retain_result(Result* result);
+
+void release_result(Result* result);
+
+void retain_generalized_column(GeneralizedColumn* gc);
+
+void release_generalized_column(GeneralizedColumn* gc);
+
+#endif
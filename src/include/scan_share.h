@@ -0,0 +1,19 @@
+#ifndef SCAN_SHARE_H__
+#define SCAN_SHARE_H__
+
+#include "cs165_api.h"
+
+// most selects of different clients one shared scan answers
+#define MAX_SHARED_SCAN_OPS 32
+
+/*
+ * Serialize the operators of concurrent clients. A client holds the database lock while
+ * it parses and executes a query, loads, collects or executes a batch, or disconnects.
+ */
+void lock_db(void);
+
+void unlock_db(void);
+
+char* execute_client_operator(DbOperator* query);
+
+#endif
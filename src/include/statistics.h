@@ -0,0 +1,48 @@
+#ifndef STATISTICS_H__
+#define STATISTICS_H__
+
+#include <stdint.h>
+
+#include "cs165_api.h"
+
+#define STATS_SAMPLE_SIZE 4096
+#define STATS_NUM_BUCKETS 64
+#define HLL_PRECISION 10
+#define HLL_NUM_REGISTERS (1 << HLL_PRECISION)
+
+/**
+ * ColumnStats
+ * Per-column statistics used to estimate predicate selectivity and join sizes.
+ * Holds no pointers so that it can be persisted with the catalog as is.
+ * - bounds: equi-depth histogram; each bucket [bounds[i], bounds[i+1]] holds about
+ *   num_rows / STATS_NUM_BUCKETS rows. bounds[0] = min and bounds[STATS_NUM_BUCKETS] = max.
+ *   Built from an evenly spaced sample of up to STATS_SAMPLE_SIZE values.
+ * - hll: HyperLogLog sketch over all values; num_distinct is its estimate
+ * - num_rows: column length when the statistics were computed
+ * - num_changed: values inserted, updated or deleted since then
+ **/
+typedef struct ColumnStats {
+	int min;
+	int max;
+	size_t num_rows;
+	size_t num_changed;
+	double num_distinct;
+	int bounds[STATS_NUM_BUCKETS + 1];
+	uint8_t hll[HLL_NUM_REGISTERS];
+} ColumnStats;
+
+Status compute_column_stats(Column* col);
+
+Status analyze_table(Table* table);
+
+void record_column_changes(Column* col, size_t num_values);
+
+bool column_stats_stale(Column* col);
+
+double estimate_selectivity(ColumnStats* stats, int low, int high);
+
+double estimate_distinct(Vector* values);
+
+void free_column_stats(ColumnStats* stats);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef STORAGE_H__
+#define STORAGE_H__
+
+#include "cs165_api.h"
+
+// values per column segment; segments are committed one at a time as a column grows and
+// are the unit of zone maps and of scan morsels
+#define COLUMN_SEGMENT_VALUES (1 << 16)
+// values of address space reserved per column; positions are ints, so no column is longer
+#define COLUMN_RESERVED_VALUES ((size_t) 1 << 31)
+// reservations are aligned so that segments can be backed by transparent huge pages
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+/**
+ * ZoneMap
+ * Bounds of the values in one segment of a column, in the column's type.
+ **/
+typedef struct ZoneMap {
+	Value min;
+	Value max;
+} ZoneMap;
+
+int alloc_column_data(Column* col, size_t capacity);
+
+int grow_column_data(Column* col, size_t capacity);
+
+void free_column_data(Column* col);
+
+void invalidate_zones(Column* col, size_t position);
+
+int refresh_zones(Column* col);
+
+bool zone_may_match(Column* col, size_t segment, Value low, Value high);
+
+size_t select_segments(Column* col, Value low, Value high, int* out);
+
+#endif
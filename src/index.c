@@ -1,8 +1,12 @@
 #include <string.h>
 
 #include "btree.h"
+#include "compression.h"
+#include "cracking.h"
 #include "cs165_api.h"
 #include "index.h"
+#include "statistics.h"
+#include "storage.h"
 #include "utils.h"
 
 Status construct_sorted_index(Column* column, Table* table, bool clustered) {
@@ -14,6 +18,9 @@ Status construct_sorted_index(Column* column, Table* table, bool clustered) {
 		idx_data = malloc(sizeof *idx_data * table->columns_size);
 		for (size_t i = 0; i < table->columns_size; i++) {
 			idx_data[i] = table->columns[i].data;
+			invalidate_zones(&table->columns[i], 0);
+			if (table->columns[i].cracker) // rows were reordered
+				reset_cracker(table->columns[i].cracker);
 			if (column != &table->columns[i] && table->columns[i].index)
 				construct_index(&table->columns[i], table);
 		}
@@ -73,6 +80,8 @@ Status construct_btree_index(Column* column) {
 
 Status construct_index(Column* column, Table* table) {
 	Status ret_status;
+	decompress_table(table); // index construction sorts and points into raw column data
+
 	ret_status = construct_sorted_index(column, table, column->clustered);
 	if (ret_status.code != OK) {
 		log_err("Could not construct sorted index on column %s\n", column->name);
@@ -93,6 +102,63 @@ Status construct_index(Column* column, Table* table) {
 	return ret_status;
 }
 
+static double log2_floor(double x) {
+	double bits = 0;
+	while (x >= 2) {
+		x /= 2;
+		bits++;
+	}
+	return bits;
+}
+
+/*
+ * choose_access_path(Column* col, int low, int high)
+ * Estimates the cost of answering low <= value < high by a full scan and by each probe
+ * the column's index supports, using the column statistics to estimate the result size,
+ * and returns the cheapest. Unclustered probes pay for sorting their positions and stale
+ * indexes pay for being rebuilt first.
+ */
+AccessPath choose_access_path(Column* col, int low, int high) {
+	if (!col->index)
+		return col->cracker ? CRACKER_PROBE : SCAN;
+
+	AccessPath index_path = col->index->type == BTREE ? BTREE_PROBE : SORTED_PROBE;
+	if (column_stats_stale(col) && compute_column_stats(col).code != OK)
+		return index_path;
+
+	double n = col->length;
+	double k = estimate_selectivity(col->stats, low, high) * n;
+
+	double result_cost = k * INDEX_ROW_COST;
+	if (!col->clustered)
+		result_cost += k * log2_floor(k) * SORT_ROW_COST;
+	if (col->stale_index)
+		result_cost += n * log2_floor(n) * SORT_ROW_COST;
+
+	double scan_cost = n * SCAN_ROW_COST;
+	double sorted_cost = log2_floor(n) * RANDOM_ACCESS_COST + result_cost;
+
+	// tree over one fence per DEFAULT_BTREE_NODE_CAPACITY values, plus the leaf scan
+	double levels = 1;
+	for (double m = n / DEFAULT_BTREE_NODE_CAPACITY; m > 1; m /= DEFAULT_BTREE_NODE_CAPACITY)
+		levels++;
+	double btree_cost = levels * (RANDOM_ACCESS_COST 
+			+ DEFAULT_BTREE_NODE_CAPACITY / 2 * SCAN_ROW_COST) + result_cost;
+
+	AccessPath path = SCAN;
+	double best_cost = scan_cost;
+	if (sorted_cost < best_cost) {
+		path = SORTED_PROBE;
+		best_cost = sorted_cost;
+	}
+	if (col->index->type == BTREE && btree_cost < best_cost)
+		path = BTREE_PROBE;
+
+	log_info("ACCESS PATH FOR %s [%d, %d): est. %.0f rows, scan %.0f, sorted %.0f, btree %.0f\n",
+			col->name, low, high, k, scan_cost, sorted_cost, btree_cost);
+	return path;
+}
+
 /*
  *
  * Sorting used for creating sorted indices
@@ -216,3 +282,68 @@ int* sort(int* arr, int arr_len, int* positions, Table* table) {
 	return positions;
 }
 
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_DIGITS (64 / RADIX_BITS)
+
+/*
+ * radix_sort(uint64_t* keys, int* payload, size_t n)
+ * Stably sorts keys in ascending order, moving payload along with them. Least significant
+ * digit first; the histograms of all digits are built in one pass and digits on which every
+ * key agrees are skipped, so small keys such as positions take few passes.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int radix_sort(uint64_t* keys, int* payload, size_t n) {
+	size_t (*counts)[RADIX_BUCKETS] = calloc(RADIX_DIGITS, sizeof *counts);
+	uint64_t* tmp_keys = malloc(sizeof *tmp_keys * (n > 0 ? n : 1));
+	int* tmp_payload = malloc(sizeof *tmp_payload * (n > 0 ? n : 1));
+	if (!counts || !tmp_keys || !tmp_payload) {
+		free(counts);
+		free(tmp_keys);
+		free(tmp_payload);
+		return -1;
+	}
+
+	for (size_t i = 0; i < n; i++)
+		for (int d = 0; d < RADIX_DIGITS; d++)
+			counts[d][(keys[i] >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+
+	uint64_t* src_keys = keys;
+	int* src_payload = payload;
+	uint64_t* dst_keys = tmp_keys;
+	int* dst_payload = tmp_payload;
+	for (int d = 0; d < RADIX_DIGITS; d++) {
+		size_t shift = d * RADIX_BITS;
+		if (n == 0 || counts[d][(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == n)
+			continue;
+
+		size_t offsets[RADIX_BUCKETS];
+		size_t offset = 0;
+		for (int b = 0; b < RADIX_BUCKETS; b++) {
+			offsets[b] = offset;
+			offset += counts[d][b];
+		}
+		for (size_t i = 0; i < n; i++) {
+			size_t k = offsets[(src_keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			dst_keys[k] = src_keys[i];
+			dst_payload[k] = src_payload[i];
+		}
+
+		uint64_t* swap_keys = src_keys;
+		src_keys = dst_keys;
+		dst_keys = swap_keys;
+		int* swap_payload = src_payload;
+		src_payload = dst_payload;
+		dst_payload = swap_payload;
+	}
+
+	if (src_keys != keys) {
+		memcpy(keys, src_keys, sizeof *keys * n);
+		memcpy(payload, src_payload, sizeof *payload * n);
+	}
+	free(counts);
+	free(tmp_keys);
+	free(tmp_payload);
+	return 0;
+}
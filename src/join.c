@@ -1,281 +1,1699 @@
+#define _DEFAULT_SOURCE
+#include <math.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "bloom.h"
 #include "cs165_api.h"
+#include "data_types.h"
 #include "db_core_utils.h"
 #include "hash_table.h"
 #include "index.h"
 #include "join.h"
+#include "result_pool.h"
+#include "statistics.h"
+#include "utils.h"
 
+// build rows per hash join partition worth a thread of its own
 #define DEFAULT_PARTITION_SIZE 1024
-#define DEFAULT_NUM_PARTITIONS 16
-
-Column** join_nested_loop(Column* positions_a, Column* positions_b, Column* values_a, 
-		Column* values_b, Status* status) {
-	Column** results = malloc(sizeof *results * 2);
-	Column* result_a = malloc(sizeof *result_a);
-	Column* result_b = malloc(sizeof *result_b);
-	if (!results || !result_a || !result_b) {
-		status->code = ERROR;
+#define MAX_NUM_PARTITIONS 64
+// bytes of cache a hash join partition's table should fit in
+#define JOIN_CACHE_BYTES (256 << 10)
+// relative cost of building or probing a hash table per row, in the units of index.h
+#define HASH_ROW_COST 4.0
+// share of the free memory a join may use before it spills to partition files
+#define JOIN_MEMORY_FRACTION 0.5
+
+// appends the pair (a, b) to the join result, growing it as needed
+static int append_pair(Vector** results, int a, int b) {
+	if (results[0]->length == results[0]->capacity
+			&& (vector_grow(results[0], results[0]->length + 1) < 0
+				|| vector_grow(results[1], results[1]->length + 1) < 0))
+		return -1;
+	results[0]->data[results[0]->length++] = a;
+	results[1]->data[results[1]->length++] = b;
+	return 0;
+}
+
+/*
+ * alloc_join_results(size_t expected_length)
+ * Returns the two position vectors of a join result, with room for expected_length pairs.
+ */
+static Vector** alloc_join_results(size_t expected_length) {
+	Vector** results = malloc(sizeof *results * 2);
+	if (!results)
+		return NULL;
+	results[0] = alloc_vector(INT);
+	results[1] = alloc_vector(INT);
+	if (!results[0] || !results[1] || vector_reserve(results[0], expected_length) < 0
+			|| vector_reserve(results[1], expected_length) < 0) {
+		release_vector(results[0]);
+		release_vector(results[1]);
+		free(results);
 		return NULL;
 	}
+	return results;
+}
 
-	result_a->data = malloc(sizeof *result_a->data * positions_a->length);
-	result_b->data  = malloc(sizeof *result_b->data * positions_a->length);
-	if (!result_a->data || !result_b->data) {
+// trims both join results to their length; the second was reserved last and gives back more
+static void trim_join_results(Vector** results) {
+	vector_trim(results[1]);
+	vector_trim(results[0]);
+}
+
+// splitmix64 finalizer over the key's bits
+static size_t hash_key_bits(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+Vector** join_nested_loop(Vector* positions_a, Vector* positions_b, Vector* values_a, 
+		Vector* values_b, Status* status) {
+	Vector** results = alloc_join_results(positions_a->length);
+	if (!results) {
 		status->code = ERROR;
 		return NULL;
 	}
 
-	int result_ix = 0;
 	for (size_t i = 0; i < positions_a->length; i++) {
 		for (size_t j = 0; j < positions_b->length; j++) {
-			if (values_a->data[i] == values_b->data[j]) {
-				result_a->data[result_ix] = positions_a->data[i];
-				result_b->data[result_ix++] = positions_b->data[j];
+			if (values_a->data[i] == values_b->data[j]
+					&& append_pair(results, positions_a->data[i], positions_b->data[j]) < 0) {
+				status->code = ERROR;
+				return NULL;
 			}
 		}
 	}
-	result_a->length = result_ix;
-	result_b->length = result_ix;
+	trim_join_results(results);
+	return results;
+}
 
-	realloc_column(result_a, status);
-	realloc_column(result_b, status);
+static void free_partitions(Vector** partitions, int num_vectors) {
+	for (int i = 0; i < num_vectors; i++) {
+		if (partitions[i])
+			free(partitions[i]->data);
+		free(partitions[i]);
+	}
+	free(partitions);
+}
 
-	if (status->code == ERROR) {
-		return NULL;
+/*
+ * Skew handling.
+ * Keys that hold a large share of either side on their own, found from a sample of each
+ * side, are heavy hitters: each gets a partition of its own instead of overloading the
+ * partition its hash selects. The probe side of any partition larger than the average is
+ * then split into several probe tasks that share the partition's table, so threads stay
+ * busy however the rows are spread over partitions.
+ */
+#define SKEW_SAMPLE_ROWS 1024
+// sampled rows below which a key is never heavy, so small samples do not flag noise
+#define SKEW_MIN_HITS 8
+
+/*
+ * Writes the heavy hitters of a join to heavy in ascending order and returns their count:
+ * keys that a sample of either side shows to hold at least half of a partition's fair
+ * share of that side.
+ */
+static int find_heavy_keys(Vector* values_a, Vector* values_b, int num_partitions, int* heavy) {
+	int sample[SKEW_SAMPLE_ROWS];
+	int num_heavy = 0;
+	Vector* sides[] = { values_a, values_b };
+	for (int s = 0; s < 2; s++) {
+		size_t length = sides[s]->length;
+		size_t n = length < SKEW_SAMPLE_ROWS ? length : SKEW_SAMPLE_ROWS;
+		for (size_t i = 0; i < n; i++)
+			sample[i] = sides[s]->data[i * length / n];
+		qsort(sample, n, sizeof *sample, compare_ints);
+
+		size_t min_hits = n / (2 * num_partitions);
+		if (min_hits < SKEW_MIN_HITS)
+			min_hits = SKEW_MIN_HITS;
+		for (size_t i = 0, run_end; i < n && num_heavy < MAX_HEAVY_KEYS; i = run_end) {
+			for (run_end = i + 1; run_end < n && sample[run_end] == sample[i]; run_end++)
+				;
+			if (run_end - i < min_hits)
+				continue;
+			bool known = false;
+			for (int h = 0; h < num_heavy; h++)
+				known = known || heavy[h] == sample[i];
+			if (!known)
+				heavy[num_heavy++] = sample[i];
+		}
 	}
+	qsort(heavy, num_heavy, sizeof *heavy, compare_ints);
+	return num_heavy;
+}
 
-	results[0] = result_a;
-	results[1] = result_b;
-	return results;
+// the partition of key: its own after the num_partitions hash partitions if it is heavy
+static int partition_of(int key, const int* heavy, int num_heavy, int num_partitions) {
+	int lo = 0;
+	int hi = num_heavy;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (heavy[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < num_heavy && heavy[lo] == key ? num_partitions + lo : hash(key, num_partitions);
 }
 
-Column** hash_partition(Column* positions_a, Column* positions_b, Column* values_a, Column* values_b, 
-		int num_partitions, Status* status) {
-	Column** result = malloc(sizeof *result * num_partitions * 4);
-	if (!result) {
-		status->code = ERROR;
+/*
+ * Splits one side into the partitions of build, two scratch vectors per partition
+ * (positions, then values) with malloc'ed data. Rows are counted per partition first so
+ * that each is allocated exactly. Returns NULL if out of memory.
+ */
+static Vector** partition_side(Vector* positions, Vector* values, JoinBuild* build) {
+	int total = build->num_partitions + build->num_heavy;
+	Vector** result = calloc(total * 2, sizeof *result);
+	size_t* counts = calloc(total, sizeof *counts);
+	if (!result || !counts) {
+		free(result);
+		free(counts);
 		return NULL;
 	}
 
-	// allocate result partition arrays
-	for (int i = 0; i < num_partitions * 4; i++)  {
-		result[i] = malloc(sizeof *result[i]);
-		if (!result[i]) {
-			status->code = ERROR;
+	for (size_t i = 0; i < values->length; i++)
+		counts[partition_of(values->data[i], build->heavy, build->num_heavy,
+				build->num_partitions)]++;
+	for (int i = 0; i < total * 2; i++)  {
+		result[i] = calloc(1, sizeof *result[i]);
+		if (result[i])
+			result[i]->data = malloc(sizeof *result[i]->data * (counts[i / 2] + 1));
+		if (!result[i] || !result[i]->data) {
+			free(counts);
+			free_partitions(result, total * 2);
 			return NULL;
 		}
-		result[i]->length = 0;
+	}
+	free(counts);
 
-		result[i]->data  = (i / 2) % 2 == 0 ? malloc(sizeof *result[i]->data * positions_a->length) 
-			: malloc(sizeof *result[i]->data * positions_b->length);
-		if (!result[i]->data) {
-			status->code = ERROR;
-			return NULL;
+	for (size_t i = 0; i < values->length; i++) {
+		int h = partition_of(values->data[i], build->heavy, build->num_heavy,
+				build->num_partitions);
+		Vector* result_p = result[h*2];
+		Vector* result_v = result[h*2 + 1];
+		result_p->data[result_p->length++] = positions->data[i];
+		result_v->data[result_v->length++] = values->data[i];
+	}
+	return result;
+}
+
+/*
+ * Builds the table of a partition over its side a rows. An odd bucket count keeps keys
+ * that share a partition (and so a residue mod the partition count) from crowding into
+ * the same buckets. Returns 0 on success, -1 if out of memory.
+ */
+static int build_partition(JoinPartition* part) {
+	size_t num_keys = part->expected_distinct < part->positions_a->length 
+		? part->expected_distinct : part->positions_a->length;
+	if (allocate(&part->table, num_keys | 1) < 0)
+		return -1;
+	for (size_t i = 0; i < part->positions_a->length; i++)
+		if (put(part->table, part->values_a->data[i], part->positions_a->data[i]) < 0)
+			return -1;
+	return 0;
+}
+
+/*
+ * Probes the table of a task's partition with the task's side b rows in [start, end) and
+ * returns the matching pairs as two vectors with malloc'ed data, or NULL if out of memory.
+ */
+static Vector** probe_partition(JoinTask* task) {
+	Vector** results = malloc(sizeof *results * 2);
+	if (!results)
+		return NULL;
+	results[0] = calloc(1, sizeof *results[0]);
+	results[1] = calloc(1, sizeof *results[0]);
+	size_t capacity = task->end > task->start ? task->end - task->start : 1;
+	if (results[0])
+		results[0]->data = malloc(sizeof *results[0]->data * capacity);
+	if (results[1])
+		results[1]->data = malloc(sizeof *results[1]->data * capacity);
+
+	Hashtable* ht = task->partition->table;
+	size_t result_ix = 0;
+	bool ok = results[0] && results[1] && results[0]->data && results[1]->data;
+	for (size_t i = task->start; i < task->end && ok; i++) {
+		int key = task->values_b->data[i];
+		for (Entry* e = ht->entries[hash(key, ht->size)]; e && ok; e = e->next) {
+			if (e->key != key)
+				continue;
+			if (result_ix == capacity) {
+				capacity *= 2;
+				int* new_a = realloc(results[0]->data, sizeof *new_a * capacity);
+				if (new_a)
+					results[0]->data = new_a;
+				int* new_b = new_a ? realloc(results[1]->data, sizeof *new_b * capacity) : NULL;
+				if (new_b)
+					results[1]->data = new_b;
+				ok = new_a && new_b;
+				if (!ok)
+					break;
+			}
+			results[0]->data[result_ix] = e->val;	
+			results[1]->data[result_ix++] = task->positions_b->data[i];
 		}
 	}
+	if (!ok) {
+		for (int k = 0; k < 2; k++) {
+			if (results[k])
+				free(results[k]->data);
+			free(results[k]);
+		}
+		free(results);
+		return NULL;
+	}
+	results[0]->length = result_ix;
+	results[1]->length = result_ix;
+	return results;
+}
 
-	for (size_t i = 0; i < values_a->length; i++) {
-		int h = hash(values_a->data[i], num_partitions);
-		Column* result_p_a = result[h*4];
-		Column* result_v_a = result[h*4 + 1];
-		result_p_a->data[result_p_a->length++] = positions_a->data[i];
-		result_v_a->data[result_v_a->length++] = values_a->data[i];
+static void free_task_results(Vector** results) {
+	if (!results)
+		return;
+	for (int k = 0; k < 2; k++) {
+		free(results[k]->data);
+		free(results[k]);
 	}
+	free(results);
+}
+
+void* run_join_tasks(void* join_workers) {
+	JoinWorkers* workers = (JoinWorkers*) join_workers;
+	for (;;) {
+		pthread_mutex_lock(&workers->lock);
+		size_t t = workers->next_task++;
+		pthread_mutex_unlock(&workers->lock);
+		if (t >= workers->num_tasks)
+			break;
 
-	for (size_t i = 0; i < values_a->length; i++) {
-		int h = hash(values_b->data[i], num_partitions);
-		Column* result_p_b = result[h*4 + 2];
-		Column* result_v_b = result[h*4 + 3];
-		result_p_b->data[result_p_b->length++] = positions_b->data[i];
-		result_v_b->data[result_v_b->length++] = values_b->data[i];
+		JoinTask* task = &workers->tasks[t];
+		bool ok = true;
+		if (task->build) {
+			ok = build_partition(task->partition) == 0;
+		} else {
+			task->results = probe_partition(task);
+			ok = task->results != NULL;
+		}
+		if (!ok)
+			workers->status->code = ERROR;
 	}
+	return NULL;
+}
 
-	for (int i = 0; i < num_partitions * 4; i++) {
-		realloc_column(result[i], status);
-		if (status->code == ERROR)
-			return NULL;
+// runs the tasks on the calling thread and up to num_threads - 1 more
+static void run_tasks(JoinTask* tasks, size_t num_tasks, int num_threads, Status* status) {
+	JoinWorkers workers;
+	workers.tasks = tasks;
+	workers.num_tasks = num_tasks;
+	workers.next_task = 0;
+	workers.status = status;
+	pthread_mutex_init(&workers.lock, NULL);
+
+	if ((size_t) num_threads > num_tasks)
+		num_threads = num_tasks > 0 ? num_tasks : 1;
+	pthread_t threads[num_threads];
+	int started = 0;
+	while (started < num_threads - 1
+			&& pthread_create(&threads[started], NULL, run_join_tasks, &workers) == 0)
+		started++;
+	run_join_tasks(&workers);
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&workers.lock);
+}
+
+static void free_join_build(JoinBuild* build) {
+	int total = build->num_partitions + build->num_heavy;
+	for (int p = 0; build->parts && p < total; p++) {
+		if (build->parts[p].table)
+			deallocate(build->parts[p].table);
+		Vector* side[] = { build->parts[p].positions_a, build->parts[p].values_a };
+		for (int k = 0; k < 2; k++) {
+			if (side[k])
+				free(side[k]->data);
+			free(side[k]);
+		}
 	}
-	
-	return result;
+	free(build->parts);
+	free(build);
 }
 
-Column** join_partition(Column* positions_a, Column* positions_b, Column* values_a, 
-		Column* values_b, Status* status) {
-	Column** results = malloc(sizeof *results * 2);
-	if (!results) {
+/*
+ * Partitions side a into num_partitions hash partitions plus one per heavy hitter and
+ * builds a table per partition, one task per partition. Returns NULL if out of memory.
+ */
+static JoinBuild* build_join(Vector* positions_a, Vector* values_a, Vector* values_b,
+		int num_partitions, Status* status) {
+	JoinBuild* build = calloc(1, sizeof *build);
+	if (!build) {
 		status->code = ERROR;
 		return NULL;
 	}
-	results[0] = malloc(sizeof *results[0]);
-	results[1] = malloc(sizeof *results[0]);
-	if (!results[0] || !results[1]) {
+	build->ref_count = 1;
+	build->num_partitions = num_partitions;
+	build->num_heavy = find_heavy_keys(values_a, values_b, num_partitions, build->heavy);
+	if (build->num_heavy > 0)
+		log_info("Hash join gives %d heavy hitter keys partitions of their own.\n",
+				build->num_heavy);
+	int total = num_partitions + build->num_heavy;
+	// light keys are spread over partitions by value, so each gets an even share of them
+	size_t partition_distinct = estimate_distinct(values_a) / num_partitions + 1;
+
+	Vector** vectors = partition_side(positions_a, values_a, build);
+	build->parts = vectors ? calloc(total, sizeof *build->parts) : NULL;
+	JoinTask* tasks = calloc(total, sizeof *tasks);
+	if (!vectors || !build->parts || !tasks) {
+		if (vectors)
+			free_partitions(vectors, total * 2);
+		free(tasks);
+		free_join_build(build);
 		status->code = ERROR;
 		return NULL;
 	}
 
-	results[0]->data = malloc(sizeof *results[0]->data * positions_a->length);
-	results[1]->data  = malloc(sizeof *results[1]->data * positions_a->length);
-	if (!results[0]->data || !results[1]->data) {
-		status->code = ERROR;
-		return NULL;
+	size_t num_tasks = 0;
+	build->bytes = sizeof *build + sizeof *build->parts * total;
+	for (int p = 0; p < total; p++) {
+		JoinPartition* part = &build->parts[p];
+		part->positions_a = vectors[p * 2];
+		part->values_a = vectors[p * 2 + 1];
+		part->expected_distinct = p < num_partitions ? partition_distinct : 1;
+		build->bytes += part->positions_a->length * (2 * sizeof(int) + sizeof(Entry))
+			+ part->expected_distinct * sizeof(Entry*);
+		if (part->positions_a->length > 0) {
+			tasks[num_tasks].partition = part;
+			tasks[num_tasks++].build = true;
+		}
 	}
-	
-	// build hashtable
-	Hashtable* ht = malloc(sizeof *ht);
-	if (allocate(&ht, 500) < 0) {
-		status->code = ERROR;
+	free(vectors);
+
+	run_tasks(tasks, num_tasks, num_partitions, status);
+	free(tasks);
+	if (status->code == ERROR) {
+		free_join_build(build);
 		return NULL;
 	}
+	return build;
+}
 
-	for (size_t i = 0; i < positions_a->length; i++) {
-		if (put(ht, values_a->data[i], positions_a->data[i]) < 0) {
-			status->code = ERROR;
-			return NULL;
+/*
+ * Build cache.
+ * Joins that ask for it keep their hash join build in a cache keyed by the base column the
+ * build keys were fetched from, the column's version and a fingerprint of the build
+ * positions, so that joining the same filtered column again skips partitioning and
+ * building side a. Any change to the column bumps its version and retires its entries.
+ * The least recently used entries are evicted to keep the cache within BUILD_CACHE_BUDGET
+ * bytes. Entries are reference counted, so an evicted build stays alive until the joins
+ * probing it finish.
+ */
+#define BUILD_CACHE_BUDGET ((size_t) 256 << 20)
+
+/**
+ * BuildCacheEntry
+ * A cached hash join build and what it was built from.
+ * - last_used: value of the cache clock when the entry was last looked up
+ **/
+typedef struct BuildCacheEntry {
+	Column* column;
+	size_t version;
+	uint64_t fingerprint;
+	size_t length;
+	JoinBuild* build;
+	size_t last_used;
+	struct BuildCacheEntry* next;
+} BuildCacheEntry;
+
+static BuildCacheEntry* build_cache = NULL;
+static size_t build_cache_bytes = 0;
+static size_t build_cache_clock = 0;
+static pthread_mutex_t build_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void release_join_build(JoinBuild* build) {
+	pthread_mutex_lock(&build_cache_lock);
+	bool last = --build->ref_count == 0;
+	pthread_mutex_unlock(&build_cache_lock);
+	if (last)
+		free_join_build(build);
+}
+
+// whether a build over values can be cached: they must be the current values of a column
+static bool can_cache_build(Vector* values) {
+	return values->column && values->column_version == values->column->version;
+}
+
+static uint64_t positions_fingerprint(Vector* positions) {
+	uint64_t fingerprint = positions->length;
+	for (size_t i = 0; i < positions->length; i++)
+		fingerprint = hash_key_bits(fingerprint ^ (uint32_t) positions->data[i]);
+	return fingerprint;
+}
+
+// unlinks *link from the cache and drops the cache's reference to its build; the cache
+// lock must be held and the build must still be referenced by the caller or a join
+static void unlink_entry(BuildCacheEntry** link) {
+	BuildCacheEntry* entry = *link;
+	*link = entry->next;
+	build_cache_bytes -= entry->build->bytes;
+	entry->build->ref_count--;
+	free(entry);
+}
+
+/*
+ * Returns a reference to the cached build over values at positions, or NULL. Entries of
+ * the column from before its current version are dropped on the way.
+ */
+static JoinBuild* lookup_build(Vector* positions, Vector* values, uint64_t fingerprint) {
+	JoinBuild* found = NULL;
+	JoinBuild* stale[8];
+	int num_stale = 0;
+	pthread_mutex_lock(&build_cache_lock);
+	for (BuildCacheEntry** link = &build_cache; *link; ) {
+		BuildCacheEntry* entry = *link;
+		if (entry->column == values->column && entry->version != values->column->version
+				&& num_stale < 8) {
+			entry->build->ref_count++; // released below, outside the lock
+			stale[num_stale++] = entry->build;
+			unlink_entry(link);
+			continue;
 		}
+		if (entry->column == values->column && entry->version == values->column_version
+				&& entry->fingerprint == fingerprint && entry->length == positions->length) {
+			entry->last_used = ++build_cache_clock;
+			entry->build->ref_count++;
+			found = entry->build;
+		}
+		link = &entry->next;
 	}
-	
-	int result_ix = 0;
-	int* pos_a;
-	for (size_t i = 0; i < positions_b->length; i++) {
-		pos_a = get(ht, values_b->data[i]);
-		if (pos_a) {
-			results[0]->data[result_ix] = *pos_a;	
-			results[1]->data[result_ix++] = positions_b->data[i];
+	pthread_mutex_unlock(&build_cache_lock);
+	for (int i = 0; i < num_stale; i++)
+		release_join_build(stale[i]);
+	return found;
+}
+
+// adds build to the cache, evicting the least recently used entries while over budget
+static void store_build(Vector* positions, Vector* values, uint64_t fingerprint,
+		JoinBuild* build) {
+	if (build->bytes > BUILD_CACHE_BUDGET)
+		return;
+	BuildCacheEntry* entry = malloc(sizeof *entry);
+	if (!entry)
+		return;
+	entry->column = values->column;
+	entry->version = values->column_version;
+	entry->fingerprint = fingerprint;
+	entry->length = positions->length;
+	entry->build = build;
+
+	JoinBuild* evicted[8];
+	int num_evicted = 0;
+	pthread_mutex_lock(&build_cache_lock);
+	build->ref_count++;
+	entry->last_used = ++build_cache_clock;
+	entry->next = build_cache;
+	build_cache = entry;
+	build_cache_bytes += build->bytes;
+	while (build_cache_bytes > BUILD_CACHE_BUDGET && num_evicted < 8) {
+		BuildCacheEntry** lru = &build_cache;
+		for (BuildCacheEntry** link = &build_cache; *link; link = &(*link)->next)
+			if ((*link)->last_used < (*lru)->last_used)
+				lru = link;
+		(*lru)->build->ref_count++;
+		evicted[num_evicted++] = (*lru)->build;
+		unlink_entry(lru);
+	}
+	pthread_mutex_unlock(&build_cache_lock);
+	for (int i = 0; i < num_evicted; i++)
+		release_join_build(evicted[i]);
+}
+
+// empties the build cache, e.g. when the database its columns belong to is closed
+void clear_build_cache() {
+	pthread_mutex_lock(&build_cache_lock);
+	BuildCacheEntry* entry = build_cache;
+	build_cache = NULL;
+	build_cache_bytes = 0;
+	pthread_mutex_unlock(&build_cache_lock);
+	while (entry) {
+		BuildCacheEntry* next = entry->next;
+		release_join_build(entry->build);
+		free(entry);
+		entry = next;
+	}
+}
+
+/*
+ * join_hash
+ * Partitioned hash join over int keys. Side a is partitioned and built into tables, or
+ * taken from the build cache if cache_build is set; side b is partitioned the same way
+ * and probed in tasks of at most an average partition's rows, on up to one thread per
+ * partition.
+ */
+Vector** join_hash(Vector* positions_a, Vector* positions_b, Vector* values_a, 
+		Vector* values_b, int num_partitions, bool cache_build, Status* status) {
+	cache_build = cache_build && can_cache_build(values_a);
+	uint64_t fingerprint = cache_build ? positions_fingerprint(positions_a) : 0;
+	JoinBuild* build = cache_build ? lookup_build(positions_a, values_a, fingerprint) : NULL;
+	if (build) {
+		log_info("Hash join reuses the cached build over %s.\n", values_a->column->name);
+	} else {
+		build = build_join(positions_a, values_a, values_b, num_partitions, status);
+		if (!build)
+			return NULL;
+		if (cache_build)
+			store_build(positions_a, values_a, fingerprint, build);
+	}
+	num_partitions = build->num_partitions;
+	int total = num_partitions + build->num_heavy;
+
+	Vector** vectors = partition_side(positions_b, values_b, build);
+	size_t chunk = positions_b->length / num_partitions;
+	if (chunk < DEFAULT_PARTITION_SIZE)
+		chunk = DEFAULT_PARTITION_SIZE;
+	size_t num_tasks = 0;
+	for (int p = 0; vectors && p < total; p++)
+		if (build->parts[p].positions_a->length > 0)
+			num_tasks += (vectors[p * 2]->length + chunk - 1) / chunk;
+
+	JoinTask* tasks = vectors ? calloc(num_tasks + 1, sizeof *tasks) : NULL;
+	size_t t = 0;
+	for (int p = 0; tasks && p < total; p++) {
+		if (build->parts[p].positions_a->length == 0)
+			continue;
+		for (size_t start = 0; start < vectors[p * 2]->length; start += chunk) {
+			tasks[t].partition = &build->parts[p];
+			tasks[t].positions_b = vectors[p * 2];
+			tasks[t].values_b = vectors[p * 2 + 1];
+			tasks[t].start = start;
+			tasks[t++].end = start + chunk < vectors[p * 2]->length 
+				? start + chunk : vectors[p * 2]->length;
 		}
 	}
-	results[0]->length = result_ix;
-	results[1]->length = result_ix;
 
-	realloc_column(results[0], status);
-	if (status->code == ERROR)
-		return NULL;
-	realloc_column(results[1], status);
-	if (status->code == ERROR)
-		return NULL;
+	Vector** results = NULL;
+	if (tasks)
+		run_tasks(tasks, num_tasks, num_partitions, status);
+	else
+		status->code = ERROR;
+
+	if (status->code != ERROR) {
+		size_t result_length = 0;
+		for (size_t i = 0; i < t; i++)
+			result_length += tasks[i].results[0]->length;
+		// the task results are counted first, so the join result is allocated right-sized
+		results = alloc_join_results(result_length);
+		for (size_t i = 0; results && i < t; i++) {
+			Vector** pairs = tasks[i].results;
+			memcpy(&results[0]->data[results[0]->length], pairs[0]->data, 
+					pairs[0]->length * sizeof *pairs[0]->data);
+			memcpy(&results[1]->data[results[1]->length], pairs[1]->data, 
+					pairs[1]->length * sizeof *pairs[1]->data);
+			results[0]->length += pairs[0]->length;
+			results[1]->length += pairs[1]->length;
+		}
+		if (!results)
+			status->code = ERROR;
+	}
 
+	for (size_t i = 0; tasks && i < t; i++)
+		free_task_results(tasks[i].results);
+	free(tasks);
+	if (vectors)
+		free_partitions(vectors, total * 2);
+	release_join_build(build);
 	return results;
 }
 
-void* run_join_partition(void* join_args) {
-	JoinThreadArgs* args = (JoinThreadArgs*) join_args;
-	Column** result = join_partition(args->positions_a, args->positions_b, 
-			args->values_a, args->values_b, args->status);	
-	*(args->results) = result;
-	pthread_exit(NULL);
-} 
+/*
+ * Join kernels for long and float keys, generated per type like the kernels in
+ * data_types.c. Int keys use the partitioned, multithreaded joins above.
+ */
+
+/*
+ * join_nested_loop_TYPE / join_hash_TYPE
+ * The hash join chains build rows by bucket through next[], so the table is two int
+ * arrays instead of one allocation per entry. Adding 0 maps a float -0 key to +0 so
+ * that keys comparing equal also hash equal.
+ */
+#define DEFINE_JOIN_KERNELS(TYPE, ctype) \
+static int join_nested_loop_##TYPE(Vector* positions_a, Vector* positions_b, \
+		Vector* values_a, Vector* values_b, Vector** results) { \
+	const ctype* keys_a = COLUMN_DATA(values_a, ctype); \
+	const ctype* keys_b = COLUMN_DATA(values_b, ctype); \
+	for (size_t i = 0; i < positions_a->length; i++) \
+		for (size_t j = 0; j < positions_b->length; j++) \
+			if (keys_a[i] == keys_b[j] \
+					&& append_pair(results, positions_a->data[i], positions_b->data[j]) < 0) \
+				return -1; \
+	return 0; \
+} \
+\
+static size_t hash_##TYPE(ctype key) { \
+	uint64_t bits = 0; \
+	key += 0; \
+	memcpy(&bits, &key, sizeof key); \
+	return hash_key_bits(bits); \
+} \
+\
+static int join_hash_##TYPE(Vector* positions_a, Vector* positions_b, \
+		Vector* values_a, Vector* values_b, Vector** results) { \
+	const ctype* keys_a = COLUMN_DATA(values_a, ctype); \
+	const ctype* keys_b = COLUMN_DATA(values_b, ctype); \
+	size_t num_buckets = 1; \
+	while (num_buckets < positions_a->length) \
+		num_buckets *= 2; \
+	int* heads = malloc(sizeof *heads * num_buckets); \
+	int* next = malloc(sizeof *next * (positions_a->length + 1)); \
+	if (!heads || !next) { \
+		free(heads); \
+		free(next); \
+		return -1; \
+	} \
+	for (size_t h = 0; h < num_buckets; h++) \
+		heads[h] = -1; \
+	for (size_t i = 0; i < positions_a->length; i++) { \
+		size_t h = hash_##TYPE(keys_a[i]) & (num_buckets - 1); \
+		next[i] = heads[h]; \
+		heads[h] = i; \
+	} \
+	int r = 0; \
+	for (size_t j = 0; j < positions_b->length && r == 0; j++) { \
+		size_t h = hash_##TYPE(keys_b[j]) & (num_buckets - 1); \
+		for (int i = heads[h]; i >= 0 && r == 0; i = next[i]) \
+			if (keys_a[i] == keys_b[j]) \
+				r = append_pair(results, positions_a->data[i], positions_b->data[j]); \
+	} \
+	free(heads); \
+	free(next); \
+	return r; \
+}
 
-Column** join_hash(Column* positions_a, Column* positions_b, Column* values_a, 
-		Column* values_b, Status* status) {
-	Column** results = malloc(sizeof *results * 2);
+DEFINE_JOIN_KERNELS(LONG, long)
+DEFINE_JOIN_KERNELS(FLOAT, float)
+
+static Vector** join_typed(Vector* positions_a, Vector* positions_b, Vector* values_a, 
+		Vector* values_b, JoinType type, Status* status) {
+	Vector** results = alloc_join_results(positions_b->length);
 	if (!results) {
 		status->code = ERROR;
 		return NULL;
 	}
-	results[0] = malloc(sizeof *results[0]);
-	results[1] = malloc(sizeof *results[0]);
-	if (!results[0] || !results[1]) {
+
+	int r = -1;
+	switch (values_a->type) {
+		case LONG:
+			r = type == HASH 
+				? join_hash_LONG(positions_a, positions_b, values_a, values_b, results)
+				: join_nested_loop_LONG(positions_a, positions_b, values_a, values_b, results);
+			break;
+		case FLOAT:
+			r = type == HASH 
+				? join_hash_FLOAT(positions_a, positions_b, values_a, values_b, results)
+				: join_nested_loop_FLOAT(positions_a, positions_b, values_a, values_b, results);
+			break;
+		default:
+			break;
+	}
+	if (r < 0) {
 		status->code = ERROR;
 		return NULL;
 	}
+	trim_join_results(results);
+	return results;
+}
+
+/*
+ * Sort-merge join.
+ * Each side becomes a run of (key, position) pairs in key order and the two runs are
+ * merged, pairing every position of a run of equal keys on one side with every position
+ * of the matching run on the other. A side whose values were fetched from a column with a
+ * sorted or btree index gets its order by walking the index; otherwise its keys are radix
+ * sorted. Keys of every type are mapped to unsigned integers with the same order.
+ */
+
+/**
+ * SortedRun
+ * One side of a sort-merge join: keys in ascending order and the position of each.
+ **/
+typedef struct SortedRun {
+	uint64_t* keys;
+	int* positions;
+	size_t length;
+} SortedRun;
+
+static uint64_t int_sort_key(int key) {
+	return (uint32_t) key ^ 0x80000000u;
+}
+
+static uint64_t long_sort_key(long key) {
+	return (uint64_t) key ^ 0x8000000000000000ull;
+}
+
+// negative floats have their bits flipped, positive ones their sign set; -0 maps to +0
+static uint64_t float_sort_key(float key) {
+	uint32_t bits;
+	key += 0;
+	memcpy(&bits, &key, sizeof bits);
+	return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+static int alloc_run(SortedRun* run, size_t length) {
+	run->length = 0;
+	run->keys = malloc(sizeof *run->keys * (length > 0 ? length : 1));
+	run->positions = malloc(sizeof *run->positions * (length > 0 ? length : 1));
+	return run->keys && run->positions ? 0 : -1;
+}
+
+static void free_run(SortedRun* run) {
+	free(run->keys);
+	free(run->positions);
+}
+
+// whether values were fetched from an int column whose sorted or btree index is current
+// and which has not changed since
+static bool has_current_index(Vector* values) {
+	Column* col = values->column;
+	return col && col->type == INT && col->version == values->column_version && col->index
+		&& col->index->type != CRACKED && !col->stale_index && col->index->data
+		&& !(col->clustered && col->compression != UNCOMPRESSED);
+}
+
+// whether a run over values is cheaper to get by walking the index of their column than by
+// sorting them; walking the index replaces one radix pass per key byte
+static bool walk_index(Vector* values) {
+	return has_current_index(values) && values->column->length * INDEX_ROW_COST
+		<= values->length * sizeof(int) * SORT_ROW_COST;
+}
+
+// estimated cost of building the sorted run of a side of a sort-merge join
+static double run_cost(Vector* values) {
+	if (walk_index(values))
+		return values->column->length * INDEX_ROW_COST;
+	return values->length * data_type_size(values->type) * SORT_ROW_COST;
+}
+
+/*
+ * Fills run by walking the index of the column values were fetched from, which costs one
+ * step per row of the column instead of a sort of the values. Every position must appear
+ * once and the index must hold the fetched value for it; otherwise, e.g. if the column
+ * changed since the fetch, returns false and run is left for sorting.
+ */
+static bool run_from_index(Vector* positions, Vector* values, SortedRun* run) {
+	Column* col = values->column;
+	if (!walk_index(values))
+		return false;
+
+	// slot[r] is the index into values of row r, or -1 if r was not fetched
+	int* slot = malloc(sizeof *slot * (col->length > 0 ? col->length : 1));
+	if (!slot)
+		return false;
+	memset(slot, -1, sizeof *slot * col->length);
+	bool valid = true;
+	for (size_t j = 0; j < positions->length && valid; j++) {
+		int r = positions->data[j];
+		valid = r >= 0 && (size_t) r < col->length && slot[r] < 0;
+		if (valid)
+			slot[r] = j;
+	}
+
+	const int* sorted_keys = col->index->data[0];
+	size_t k = 0;
+	for (size_t i = 0; i < col->length && valid; i++) {
+		int r = col->clustered ? (int) i : col->index->positions[i];
+		int j = slot[r];
+		if (j < 0)
+			continue;
+		valid = sorted_keys[i] == values->data[j];
+		run->keys[k] = int_sort_key(sorted_keys[i]);
+		run->positions[k++] = r;
+	}
+	free(slot);
+	run->length = valid ? k : 0;
+	return valid;
+}
 
-	results[0]->length = 0;
-	results[1]->length = 0;
-	results[0]->data = malloc(sizeof *results[0]->data * positions_a->length);
-	results[1]->data  = malloc(sizeof *results[1]->data * positions_a->length);
-	if (!results[0]->data || !results[1]->data) {
+// fills run with the keys of values and radix sorts it; NaN keys match nothing and are left out
+static int run_from_sort(Vector* positions, Vector* values, SortedRun* run) {
+	size_t k = 0;
+	for (size_t i = 0; i < values->length; i++) {
+		switch (values->type) {
+			case INT:
+				run->keys[k] = int_sort_key(values->data[i]);
+				break;
+			case LONG:
+				run->keys[k] = long_sort_key(COLUMN_DATA(values, long)[i]);
+				break;
+			case FLOAT:
+				if (isnan(COLUMN_DATA(values, float)[i]))
+					continue;
+				run->keys[k] = float_sort_key(COLUMN_DATA(values, float)[i]);
+				break;
+		}
+		run->positions[k++] = positions->data[i];
+	}
+	run->length = k;
+	return radix_sort(run->keys, run->positions, run->length);
+}
+
+static int build_run(Vector* positions, Vector* values, SortedRun* run) {
+	if (alloc_run(run, values->length) < 0)
+		return -1;
+	if (run_from_index(positions, values, run))
+		return 0;
+	return run_from_sort(positions, values, run);
+}
+
+/*
+ * Merges the runs, writing matching pairs to results if given, and returns the number of
+ * pairs. Called once to size the result and once to fill it.
+ */
+static size_t merge_runs(SortedRun* a, SortedRun* b, Vector** results) {
+	size_t count = 0;
+	size_t i = 0;
+	size_t j = 0;
+	while (i < a->length && j < b->length) {
+		if (a->keys[i] < b->keys[j]) {
+			i++;
+		} else if (a->keys[i] > b->keys[j]) {
+			j++;
+		} else {
+			size_t i_end = i + 1;
+			size_t j_end = j + 1;
+			while (i_end < a->length && a->keys[i_end] == a->keys[i])
+				i_end++;
+			while (j_end < b->length && b->keys[j_end] == b->keys[j])
+				j_end++;
+			if (results) {
+				for (size_t x = i; x < i_end; x++) {
+					for (size_t y = j; y < j_end; y++) {
+						results[0]->data[count] = a->positions[x];
+						results[1]->data[count++] = b->positions[y];
+					}
+				}
+			} else {
+				count += (i_end - i) * (j_end - j);
+			}
+			i = i_end;
+			j = j_end;
+		}
+	}
+	return count;
+}
+
+Vector** join_sort_merge(Vector* positions_a, Vector* positions_b, Vector* values_a,
+		Vector* values_b, Status* status) {
+	SortedRun run_a;
+	SortedRun run_b;
+	memset(&run_a, 0, sizeof run_a);
+	memset(&run_b, 0, sizeof run_b);
+	Vector** results = NULL;
+	if (build_run(positions_a, values_a, &run_a) == 0
+			&& build_run(positions_b, values_b, &run_b) == 0) {
+		results = alloc_join_results(merge_runs(&run_a, &run_b, NULL));
+		if (results) {
+			results[0]->length = merge_runs(&run_a, &run_b, results);
+			results[1]->length = results[0]->length;
+		}
+	}
+	free_run(&run_a);
+	free_run(&run_b);
+	if (!results)
+		status->code = ERROR;
+	return results;
+}
+
+/*
+ * Index nested-loop join.
+ * The outer keys are sorted and each distinct key probes the sorted array of the inner
+ * column's index (a btree index keeps one too), so the join costs O(outer log inner)
+ * however large the inner column is. Probes run in batches whose binary searches advance
+ * in lockstep, prefetching each search's next midpoint while the others are compared, so
+ * that the cache misses of a batch overlap. Index entries whose rows were not fetched on
+ * the inner side are skipped by a binary search over its sorted positions.
+ */
+#define INDEX_PROBE_BATCH 16
+
+// whether the inner side of an index join can be values, fetched at positions
+static bool can_probe_index(Vector* positions, Vector* values) {
+	return has_current_index(values) && positions->sorted
+		&& positions->length == values->length;
+}
+
+static int int_from_sort_key(uint64_t key) {
+	return (int) ((uint32_t) key ^ 0x80000000u);
+}
+
+/*
+ * Sets bounds[k] to the first entry of sorted not less than keys[k], for n keys. Every
+ * search halves a range of the same length, so they all take the same steps.
+ */
+static void lower_bounds(const int* sorted, size_t length, const int* keys, size_t n,
+		size_t* bounds) {
+	for (size_t k = 0; k < n; k++)
+		bounds[k] = 0;
+	if (length == 0)
+		return;
+
+	size_t size = length;
+	while (size > 1) {
+		size_t half = size / 2;
+		size -= half;
+		for (size_t k = 0; k < n; k++) {
+			bounds[k] = sorted[bounds[k] + half] < keys[k] ? bounds[k] + half : bounds[k];
+			__builtin_prefetch(&sorted[bounds[k] + size / 2]);
+		}
+	}
+	for (size_t k = 0; k < n; k++)
+		bounds[k] += sorted[bounds[k]] < keys[k];
+}
+
+// whether the sorted positions contain position
+static bool contains_position(Vector* positions, int position) {
+	size_t lo = 0;
+	size_t hi = positions->length;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (positions->data[mid] < position)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < positions->length && positions->data[lo] == position;
+}
+
+// side b must satisfy can_probe_index; side a is the outer side
+Vector** join_index_nested_loop(Vector* positions_a, Vector* positions_b, Vector* values_a,
+		Vector* values_b, Status* status) {
+	Column* col = values_b->column;
+	const int* sorted = col->index->data[0];
+	// inner positions that cover the whole column need no membership test
+	bool all_rows = positions_b->length == col->length && (col->length == 0
+			|| (positions_b->data[0] == 0
+				&& (size_t) positions_b->data[col->length - 1] == col->length - 1));
+
+	SortedRun outer;
+	Vector** results = NULL;
+	if (alloc_run(&outer, values_a->length) == 0
+			&& run_from_sort(positions_a, values_a, &outer) == 0)
+		results = alloc_join_results(outer.length);
+
+	int keys[INDEX_PROBE_BATCH];
+	size_t runs[INDEX_PROBE_BATCH + 1];
+	size_t bounds[INDEX_PROBE_BATCH];
+	int r = results ? 0 : -1;
+	size_t x = 0;
+	while (r == 0 && x < outer.length) {
+		// the next batch of distinct keys, each with the run of outer rows holding it
+		size_t n = 0;
+		for (; n < INDEX_PROBE_BATCH && x < outer.length; n++) {
+			runs[n] = x;
+			keys[n] = int_from_sort_key(outer.keys[x]);
+			while (x < outer.length && outer.keys[x] == outer.keys[runs[n]])
+				x++;
+		}
+		runs[n] = x;
+		lower_bounds(sorted, col->length, keys, n, bounds);
+
+		for (size_t k = 0; k < n && r == 0; k++) {
+			for (size_t i = bounds[k]; i < col->length && sorted[i] == keys[k] && r == 0; i++) {
+				int row = col->clustered ? (int) i : col->index->positions[i];
+				if (!all_rows && !contains_position(positions_b, row))
+					continue;
+				for (size_t y = runs[k]; y < runs[k + 1] && r == 0; y++)
+					r = append_pair(results, outer.positions[y], row);
+			}
+		}
+	}
+	free_run(&outer);
+	if (r < 0) {
+		if (results) {
+			release_vector(results[0]);
+			release_vector(results[1]);
+			free(results);
+		}
 		status->code = ERROR;
 		return NULL;
 	}
+	trim_join_results(results);
+	return results;
+}
 
-	int num_partitions = DEFAULT_NUM_PARTITIONS;
-	Column** partitions = hash_partition(positions_a, positions_b, values_a, values_b, 
-			num_partitions, status);
-
-	Column*** thread_results = malloc(sizeof *results * num_partitions);
-	JoinThreadArgs** args = malloc(sizeof *args * num_partitions);
-	pthread_t join_threads[num_partitions];
-	for (int i = 0; i < num_partitions; i++) {
-		args[i] = malloc(sizeof *args[i]);
-		args[i]->positions_a = partitions[i * 4];
-		args[i]->values_a = partitions[i * 4 + 1];
-		args[i]->positions_b = partitions[i * 4 + 2];
-		args[i]->values_b = partitions[i * 4 + 3];
-		args[i]->status = status;
-		args[i]->results = &(thread_results[i]);
-		pthread_create(&join_threads[i], NULL, run_join_partition, (void*) args[i]);
-		if (status->code == ERROR)
-			return NULL;
+/*
+ * Orders a join result by its first positions, keeping pairs with equal first positions
+ * in the order they were produced. Returns 0 on success, -1 if out of memory.
+ */
+static int sort_join_results(Vector** results) {
+	size_t n = results[0]->length;
+	size_t i = 1;
+	while (i < n && results[0]->data[i - 1] <= results[0]->data[i])
+		i++;
+	if (i >= n) // already ordered, e.g. a merge over a clustered left side
+		return 0;
+
+	uint64_t* keys = malloc(sizeof *keys * n);
+	if (!keys)
+		return -1;
+	for (i = 0; i < n; i++)
+		keys[i] = (uint32_t) results[0]->data[i];
+	int r = radix_sort(keys, results[1]->data, n);
+	if (r == 0)
+		for (i = 0; i < n; i++)
+			results[0]->data[i] = keys[i];
+	free(keys);
+	return r;
+}
+
+// approximate bytes of a hash table built over values: one entry per row plus one bucket
+// pointer per distinct key
+static double hash_table_footprint(Vector* values) {
+	return values->length * sizeof(Entry) + estimate_distinct(values) * sizeof(Entry*);
+}
+
+// bytes of memory the system has free, or infinity if it cannot tell
+static double available_memory(void) {
+	long pages = sysconf(_SC_AVPHYS_PAGES);
+	long page_size = sysconf(_SC_PAGESIZE);
+	return pages > 0 && page_size > 0 ? (double) pages * page_size : INFINITY;
+}
+
+// fan-out of a hash join building on values: enough partitions for each table to fit in
+// cache, and one per core while partitions keep DEFAULT_PARTITION_SIZE rows
+static int choose_partitions(Vector* values) {
+	double partitions = ceil(hash_table_footprint(values) / JOIN_CACHE_BYTES);
+	double parallel = values->length / DEFAULT_PARTITION_SIZE;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores > 0 && parallel > cores)
+		parallel = cores;
+	if (parallel > partitions)
+		partitions = parallel;
+	if (partitions > MAX_NUM_PARTITIONS)
+		partitions = MAX_NUM_PARTITIONS;
+	return partitions > 1 ? (int) partitions : 1;
+}
+
+/*
+ * Grace hash join.
+ * A hash join that would not fit in the join memory budget first splits both sides by key
+ * into partition files, then reads each pair of partition files back and hash joins it in
+ * memory, so that only one pair is resident at a time. Rows are staged per partition and
+ * written sequentially in blocks of SPILL_BLOCK_ROWS positions followed by as many keys.
+ */
+#define SPILL_BLOCK_ROWS 1024
+#define MAX_SPILL_PARTITIONS 128
+// relative cost of writing a row to a partition file and reading it back
+#define SPILL_ROW_COST 8.0
+
+/**
+ * SpillPartition
+ * The partition file of one side of a grace hash join and the rows staged for it.
+ * - length: rows written to the file
+ * - staged: rows waiting in positions and keys
+ **/
+typedef struct SpillPartition {
+	FILE* file;
+	size_t length;
+	size_t staged;
+	int positions[SPILL_BLOCK_ROWS];
+	char keys[SPILL_BLOCK_ROWS * sizeof(long)];
+} SpillPartition;
+
+// hash of the i-th key of values; equal keys of any type hash equal, -0 like +0
+static size_t key_hash(Vector* values, size_t i) {
+	uint64_t bits = 0;
+	float key;
+	switch (values->type) {
+		case INT:
+			bits = (uint32_t) values->data[i];
+			break;
+		case LONG:
+			bits = COLUMN_DATA(values, long)[i];
+			break;
+		case FLOAT:
+			key = COLUMN_DATA(values, float)[i] + 0;
+			memcpy(&bits, &key, sizeof key);
+			break;
 	}
+	return hash_key_bits(bits);
+}
 
-	int r;
-	for (int i = 0; i < num_partitions; i++) {
-		r = pthread_join(join_threads[i], NULL);
-		if (r != 0)
-			return NULL;
-		free(args[i]);
+static int flush_spill(SpillPartition* part, size_t width) {
+	if (part->staged == 0)
+		return 0;
+	if (fwrite(part->positions, sizeof(int), part->staged, part->file) != part->staged
+			|| fwrite(part->keys, width, part->staged, part->file) != part->staged)
+		return -1;
+	part->length += part->staged;
+	part->staged = 0;
+	return 0;
+}
+
+// writes the rows of one side to its num_partitions partition files
+static int spill_side(Vector* positions, Vector* values, SpillPartition* parts,
+		int num_partitions) {
+	size_t width = data_type_size(values->type);
+	for (size_t i = 0; i < values->length; i++) {
+		SpillPartition* part = &parts[key_hash(values, i) % num_partitions];
+		part->positions[part->staged] = positions->data[i];
+		memcpy(part->keys + part->staged * width, (char*) values->data + i * width, width);
+		if (++part->staged == SPILL_BLOCK_ROWS && flush_spill(part, width) < 0)
+			return -1;
+	}
+	for (int k = 0; k < num_partitions; k++)
+		if (flush_spill(&parts[k], width) < 0 || fflush(parts[k].file) != 0)
+			return -1;
+	return 0;
+}
+
+// reads a partition file back into positions and values; every block but the last is full
+static int load_spill(SpillPartition* part, Vector* positions, Vector* values) {
+	size_t width = data_type_size(values->type);
+	if (vector_reserve(positions, part->length) < 0 || vector_reserve(values, part->length) < 0)
+		return -1;
+	rewind(part->file);
+	for (size_t done = 0; done < part->length; ) {
+		size_t n = part->length - done < SPILL_BLOCK_ROWS ? part->length - done : SPILL_BLOCK_ROWS;
+		if (fread(positions->data + done, sizeof(int), n, part->file) != n
+				|| fread((char*) values->data + done * width, width, n, part->file) != n)
+			return -1;
+		done += n;
 	}
-	free(args);
+	positions->length = part->length;
+	values->length = part->length;
+	return 0;
+}
 
-	for (int i = 0; i < num_partitions; i++) {
-		memcpy(&results[0]->data[results[0]->length], thread_results[i][0]->data, 
-				thread_results[i][0]->length * sizeof *thread_results[i][0]->data);
-		memcpy(&results[1]->data[results[1]->length], thread_results[i][1]->data, 
-				thread_results[i][1]->length * sizeof *thread_results[i][1]->data);
+// appends the pairs of a partition's join result to results
+static int append_results(Vector** results, Vector** pairs) {
+	size_t length = results[0]->length;
+	size_t n = pairs[0]->length;
+	if (vector_grow(results[0], length + n) < 0 || vector_grow(results[1], length + n) < 0)
+		return -1;
+	memcpy(results[0]->data + length, pairs[0]->data, sizeof *pairs[0]->data * n);
+	memcpy(results[1]->data + length, pairs[1]->data, sizeof *pairs[1]->data * n);
+	results[0]->length += n;
+	results[1]->length += n;
+	return 0;
+}
 
-		results[0]->length += thread_results[i][0]->length;
-		results[1]->length += thread_results[i][1]->length;
+Vector** join_grace_hash(Vector* positions_a, Vector* positions_b, Vector* values_a,
+		Vector* values_b, int num_partitions, Status* status) {
+	// parts[k] is partition k of side a and parts[num_partitions + k] of side b
+	SpillPartition* parts = calloc(num_partitions * 2, sizeof *parts);
+	Vector** results = alloc_join_results(positions_b->length);
+	Vector* part_positions_a = alloc_vector(INT);
+	Vector* part_positions_b = alloc_vector(INT);
+	Vector* part_values_a = alloc_vector(values_a->type);
+	Vector* part_values_b = alloc_vector(values_b->type);
+	int r = parts && results && part_positions_a && part_positions_b && part_values_a
+		&& part_values_b ? 0 : -1;
+	for (int k = 0; k < num_partitions * 2 && r == 0; k++) {
+		parts[k].file = tmpfile();
+		if (!parts[k].file) {
+			log_err("Could not create a partition file for the join.\n");
+			r = -1;
+		}
+	}
+	if (r == 0)
+		r = spill_side(positions_a, values_a, parts, num_partitions);
+	if (r == 0)
+		r = spill_side(positions_b, values_b, parts + num_partitions, num_partitions);
 
-		// cleanup partitions after they've been used
-		for (int k = 0; k < 4; k++)
-			free(partitions[i*4 + k]->data);
+	for (int k = 0; k < num_partitions && r == 0; k++) {
+		if (parts[k].length == 0 || parts[num_partitions + k].length == 0)
+			continue;
+		if (load_spill(&parts[k], part_positions_a, part_values_a) < 0
+				|| load_spill(&parts[num_partitions + k], part_positions_b, part_values_b) < 0) {
+			r = -1;
+			break;
+		}
 
-		free(thread_results[i][0]->data);
-		free(thread_results[i][1]->data);
-		free(thread_results[i][0]);
-		free(thread_results[i][1]);
+		Status part_status;
+		part_status.code = OK;
+		Vector** pairs = part_values_a->type == INT
+			? join_hash(part_positions_a, part_positions_b, part_values_a, part_values_b,
+					choose_partitions(part_values_a), false, &part_status)
+			: join_typed(part_positions_a, part_positions_b, part_values_a, part_values_b,
+					HASH, &part_status);
+		if (!pairs) {
+			r = -1;
+			break;
+		}
+		r = append_results(results, pairs);
+		release_vector(pairs[0]);
+		release_vector(pairs[1]);
+		free(pairs);
 	}
 
-	realloc_column(results[0], status);
-	if (status->code == ERROR)
-		return NULL;
-	realloc_column(results[1], status);
-	if (status->code == ERROR)
+	for (int k = 0; parts && k < num_partitions * 2; k++)
+		if (parts[k].file)
+			fclose(parts[k].file);
+	free(parts);
+	release_vector(part_positions_a);
+	release_vector(part_positions_b);
+	release_vector(part_values_a);
+	release_vector(part_values_b);
+	if (r < 0) {
+		if (results) {
+			release_vector(results[0]);
+			release_vector(results[1]);
+			free(results);
+		}
+		status->code = ERROR;
 		return NULL;
-
+	}
+	trim_join_results(results);
 	return results;
 }
 
-Column** join(Column* positions_1, Column* positions_2, Column* values_1, Column* values_2, 
-		JoinType type, Status* status) {
-	// positions, values A are smaller than positions, values B
-	Column* positions_a = positions_1->length <= positions_2->length ? positions_1 : positions_2;
-	Column* positions_b = positions_a == positions_1 ? positions_2: positions_1; 
+/*
+ * Semi-join reduction.
+ * When the probe side of a hash join is much larger than the build side, the build keys
+ * go into a Bloom filter and probe rows whose keys cannot match are dropped before they
+ * are partitioned, spilled or probed. Rows are filtered in batches; if most rows of the
+ * first batch pass, the join has a high hit rate and the filter is given up.
+ */
+// probe rows per build row from which a hash join filters its probe side
+#define SEMI_JOIN_MIN_RATIO 4
+#define SEMI_JOIN_BATCH 1024
+#define SEMI_JOIN_MAX_PASS_RATE 0.5
+
+/*
+ * Sets *positions_b and *values_b to new vectors holding the rows of side b whose keys
+ * may occur in side a. Returns true if it did, false if the filter was given up or memory
+ * ran out, in which case side b is joined as is.
+ */
+static bool semi_join_reduce(Vector* values_a, Vector** positions_b, Vector** values_b) {
+	BloomFilter filter;
+	if (bloom_init(&filter, values_a->length) < 0)
+		return false;
+	for (size_t i = 0; i < values_a->length; i++)
+		bloom_add(&filter, key_hash(values_a, i));
 
-	Column* values_a = positions_a == positions_1 ? values_1 : values_2;
-	Column* values_b = positions_a == positions_1 ? values_2 : values_1;
+	Vector* in_values = *values_b;
+	Vector* out_positions = alloc_vector(INT);
+	Vector* out_values = alloc_vector(in_values->type);
+	bool reduced = out_positions && out_values
+		&& vector_reserve(out_positions, SEMI_JOIN_BATCH) == 0
+		&& vector_reserve(out_values, SEMI_JOIN_BATCH) == 0;
 
-	Column** results = NULL;
-	switch (type) {
-		case NESTED_LOOP: 
-			results = join_nested_loop(positions_a, positions_b, values_a, values_b, status);
+	size_t width = data_type_size(in_values->type);
+	uint64_t hashes[SEMI_JOIN_BATCH];
+	uint32_t selected[SEMI_JOIN_BATCH];
+	for (size_t start = 0; start < in_values->length && reduced; start += SEMI_JOIN_BATCH) {
+		size_t n = in_values->length - start < SEMI_JOIN_BATCH
+			? in_values->length - start : SEMI_JOIN_BATCH;
+		for (size_t i = 0; i < n; i++)
+			hashes[i] = key_hash(in_values, start + i);
+		size_t k = bloom_select(&filter, hashes, n, selected);
+		if (start == 0 && k > n * SEMI_JOIN_MAX_PASS_RATE) {
+			reduced = false;
 			break;
-		case HASH: 
-			results = join_hash(positions_a, positions_b, values_a, values_b, status);
+		}
+
+		size_t length = out_positions->length;
+		if (vector_grow(out_positions, length + k) < 0 || vector_grow(out_values, length + k) < 0) {
+			reduced = false;
 			break;
-		default:
-			status->code = ERROR;
-			return NULL;
+		}
+		for (size_t j = 0; j < k; j++) {
+			size_t i = start + selected[j];
+			out_positions->data[length + j] = (*positions_b)->data[i];
+			memcpy((char*) out_values->data + (length + j) * width,
+					(char*) in_values->data + i * width, width);
+		}
+		out_positions->length += k;
+		out_values->length += k;
+	}
+	bloom_free(&filter);
+
+	if (!reduced) {
+		release_vector(out_positions);
+		release_vector(out_values);
+		return false;
+	}
+	log_info("Semi-join reduction kept %zu of %zu probe rows.\n", out_values->length,
+			in_values->length);
+	*positions_b = out_positions;
+	*values_b = out_values;
+	return true;
+}
+
+static const char* join_type_names[] = { "nested-loop", "hash", "sort-merge", "index" };
+
+/*
+ * plan_join(positions_1, positions_2, values_1, values_2, type, plan)
+ * Chooses how to run a join of the given type. An AUTO join runs the algorithm with the
+ * lowest estimated cost given the input sizes, the indexes the values were fetched
+ * through, the estimated number of distinct keys and the free memory. A hash join that
+ * would not fit in the join memory budget spills to partition files, and a sort-merge
+ * join that would not fit is ruled out. Side a is the smaller input for nested-loop and
+ * sort-merge joins, the one with the smaller estimated table for hash joins and, for index
+ * joins, the outer side probing the larger side that has an index. Hash joins over int
+ * keys get a fan-out from choose_partitions. A GRACE_HASH join is a hash join that spills
+ * even if it would fit.
+ */
+static void plan_join(Vector* positions_1, Vector* positions_2, Vector* values_1,
+		Vector* values_2, JoinType type, JoinPlan* plan) {
+	double n1 = positions_1->length;
+	double n2 = positions_2->length;
+	bool grace = type == GRACE_HASH;
+	if (grace)
+		type = HASH;
+
+	bool build_1 = hash_table_footprint(values_1) <= hash_table_footprint(values_2);
+	Vector* build = build_1 ? values_1 : values_2;
+	int num_partitions = build->type == INT ? choose_partitions(build) : 1;
+	double hash_cost = (n1 + n2) * (HASH_ROW_COST + (num_partitions > 1 ? SCAN_ROW_COST : 0));
+
+	// a hash join whose partitions and table exceed the budget spills, into enough
+	// partition files for each pair to take at most half of it
+	double budget = available_memory() * JOIN_MEMORY_FRACTION;
+	double row_bytes = sizeof(int) + data_type_size(build->type);
+	double hash_bytes = (n1 + n2) * row_bytes + hash_table_footprint(build);
+	bool spill = grace || hash_bytes > budget;
+	if (spill) {
+		double partitions = ceil(2 * hash_bytes / budget);
+		num_partitions = partitions < MAX_SPILL_PARTITIONS ? (int) partitions : MAX_SPILL_PARTITIONS;
+		if (num_partitions < 2)
+			num_partitions = 2;
+		hash_cost = (n1 + n2) * (HASH_ROW_COST + SPILL_ROW_COST);
+	}
+
+	double nested_loop_cost = n1 * n2 * SCAN_ROW_COST;
+	// both runs and the radix sort's scratch copy of the larger one are resident
+	double sort_merge_cost = run_cost(values_1) + run_cost(values_2) + (n1 + n2) * SCAN_ROW_COST;
+	if ((n1 + n2 + (n1 > n2 ? n1 : n2)) * (sizeof(uint64_t) + sizeof(int)) > budget)
+		sort_merge_cost = INFINITY;
+
+	// the outer side is sorted, then each of its distinct keys is a binary search
+	bool probe_1 = can_probe_index(positions_1, values_1);
+	bool probe_2 = can_probe_index(positions_2, values_2);
+	bool outer_1 = probe_2 && (!probe_1 || n2 >= n1);
+	double index_cost = INFINITY;
+	if (probe_1 || probe_2) {
+		Vector* outer = outer_1 ? values_1 : values_2;
+		Vector* inner = outer_1 ? values_2 : values_1;
+		index_cost = outer->length * sizeof(int) * SORT_ROW_COST + estimate_distinct(outer)
+			* log2(inner->column->length + 1) * RANDOM_ACCESS_COST;
+	}
+
+	if (type == AUTO) {
+		double costs[] = { nested_loop_cost, hash_cost, sort_merge_cost, index_cost };
+		type = NESTED_LOOP;
+		for (JoinType t = HASH; t <= INDEX_NESTED_LOOP; t++)
+			if (costs[t] < costs[type])
+				type = t;
+	} else if (type == INDEX_NESTED_LOOP && !probe_1 && !probe_2) {
+		log_info("No current index on either side of the join; joining by hashing.\n");
+		type = HASH;
+	}
+
+	plan->type = type;
+	plan->spill = type == HASH && spill;
+	plan->semi_join = type == HASH && (build_1 ? n2 >= SEMI_JOIN_MIN_RATIO * n1
+			: n1 >= SEMI_JOIN_MIN_RATIO * n2);
+	plan->num_partitions = type == HASH ? num_partitions : 1;
+	if (type == HASH)
+		plan->first_is_a = build_1;
+	else if (type == INDEX_NESTED_LOOP)
+		plan->first_is_a = outer_1;
+	else
+		plan->first_is_a = n1 <= n2;
+
+	log_info("JOIN PLAN %s: %.0f x %.0f rows, nested-loop %.0f, hash %.0f (%d partitions%s%s), "
+			"sort-merge %.0f, index %.0f; side a is input %d\n", join_type_names[plan->type],
+			n1, n2, nested_loop_cost, hash_cost, num_partitions, spill ? ", spilled" : "",
+			plan->semi_join ? ", semi-join" : "", sort_merge_cost, index_cost,
+			plan->first_is_a ? 1 : 2);
+}
+
+/*
+ * join(positions_1, positions_2, values_1, values_2, type, cache_build, plan, status)
+ * Joins the two inputs by the algorithm plan_join chooses for type and stores that
+ * choice in plan. With cache_build, an in-memory hash join over int keys reuses and keeps
+ * its build side in the build cache. Returns the positions of the matching pairs, ordered
+ * by positions_1.
+ */
+Vector** join(Vector* positions_1, Vector* positions_2, Vector* values_1, Vector* values_2, 
+		JoinType type, bool cache_build, JoinPlan* plan, Status* status) {
+	if (values_1->type != values_2->type) {
+		log_err("Cannot join columns of different types.\n");
+		status->code = ERROR;
+		return NULL;
+	}
+
+	plan_join(positions_1, positions_2, values_1, values_2, type, plan);
+	type = plan->type;
+	bool first_is_a = plan->first_is_a;
+
+	Vector* positions_a = first_is_a ? positions_1 : positions_2;
+	Vector* positions_b = first_is_a ? positions_2 : positions_1; 
+	Vector* values_a = first_is_a ? values_1 : values_2;
+	Vector* values_b = first_is_a ? values_2 : values_1;
+	bool reduced = plan->semi_join && semi_join_reduce(values_a, &positions_b, &values_b);
+
+	Vector** results = NULL;
+	if (plan->spill) {
+		results = join_grace_hash(positions_a, positions_b, values_a, values_b,
+				plan->num_partitions, status);
+	} else if (type == SORT_MERGE) {
+		results = join_sort_merge(positions_a, positions_b, values_a, values_b, status);
+	} else if (type == INDEX_NESTED_LOOP) {
+		results = join_index_nested_loop(positions_a, positions_b, values_a, values_b, status);
+	} else if (values_a->type != INT) {
+		results = join_typed(positions_a, positions_b, values_a, values_b, type, status);
+	} else {
+		switch (type) {
+			case NESTED_LOOP: 
+				results = join_nested_loop(positions_a, positions_b, values_a, values_b, status);
+				break;
+			case HASH: 
+				results = join_hash(positions_a, positions_b, values_a, values_b,
+						plan->num_partitions, cache_build, status);
+				break;
+			default:
+				status->code = ERROR;
+				break;
+		}
+	}
+	if (reduced) {
+		release_vector(positions_b);
+		release_vector(values_b);
 	}
+	if (!results)
+		return NULL;
 
-	if (positions_1->length > positions_2->length) {
-		Column* tmp = results[0];
+	if (!first_is_a) {
+		Vector* tmp = results[0];
 		results[0] = results[1];
 		results[1] = tmp;
 	}
 
-	sort(results[0]->data, results[0]->length, results[1]->data, NULL);
-	
-	return results ? results : NULL;
+	if (sort_join_results(results) < 0) {
+		release_vector(results[0]);
+		release_vector(results[1]);
+		free(results);
+		status->code = ERROR;
+		return NULL;
+	}
+	return results;
+}
+
+/*
+ * Star join.
+ * Joins fact rows to several dimensions in one pass: a table is built over the keys of
+ * each dimension, then each block of fact rows probes them in turn, the rows that miss
+ * a dimension dropping out before the next is probed. Only the positions of rows that
+ * match every dimension are written, so no intermediate join result or fetch of the fact
+ * side is materialized. Keys are mapped to unsigned integers as for sort-merge joins.
+ */
+#define STAR_BLOCK_ROWS 1024
+
+/**
+ * DimensionTable
+ * Keys of a dimension chained by bucket: heads[b] is the first row in bucket b and
+ * next[i] the row after row i, or -1.
+ **/
+typedef struct DimensionTable {
+	uint64_t* keys;
+	int* heads;
+	int* next;
+	size_t num_buckets;
+} DimensionTable;
+
+// maps the i-th key of values to an unsigned integer; false for a NaN, which matches nothing
+static bool star_key(Vector* values, size_t i, uint64_t* key) {
+	switch (values->type) {
+		case INT:
+			*key = int_sort_key(values->data[i]);
+			return true;
+		case LONG:
+			*key = long_sort_key(COLUMN_DATA(values, long)[i]);
+			return true;
+		case FLOAT:
+			*key = float_sort_key(COLUMN_DATA(values, float)[i]);
+			return !isnan(COLUMN_DATA(values, float)[i]);
+	}
+	return false;
+}
+
+static void free_dimension_table(DimensionTable* table) {
+	free(table->keys);
+	free(table->heads);
+	free(table->next);
+}
+
+static int build_dimension_table(Vector* values, DimensionTable* table) {
+	size_t n = values->length;
+	table->num_buckets = 1;
+	while (table->num_buckets < n)
+		table->num_buckets *= 2;
+	table->keys = malloc(sizeof *table->keys * (n + 1));
+	table->heads = malloc(sizeof *table->heads * table->num_buckets);
+	table->next = malloc(sizeof *table->next * (n + 1));
+	if (!table->keys || !table->heads || !table->next)
+		return -1;
+
+	for (size_t b = 0; b < table->num_buckets; b++)
+		table->heads[b] = -1;
+	for (size_t i = n; i-- > 0; ) { // inserted backwards so that chains run in row order
+		if (!star_key(values, i, &table->keys[i]))
+			continue;
+		size_t b = hash_key_bits(table->keys[i]) & (table->num_buckets - 1);
+		table->next[i] = table->heads[b];
+		table->heads[b] = i;
+	}
+	return 0;
+}
+
+// the first row of table at or after row i in its chain that holds key, or -1
+static int next_match(DimensionTable* table, int i, uint64_t key) {
+	while (i >= 0 && table->keys[i] != key)
+		i = table->next[i];
+	return i;
+}
+
+/*
+ * Writes a row for every combination of the matches of fact row f in each dimension,
+ * starting from the first matches in first. Returns 0 on success, -1 if out of memory.
+ */
+static int emit_star_rows(Vector** results, Vector* fact_positions, StarDimension* dimensions,
+		DimensionTable* tables, int num_dimensions, size_t f, const int* first,
+		const uint64_t* keys) {
+	int match[MAX_STAR_DIMENSIONS];
+	memcpy(match, first, sizeof *match * num_dimensions);
+	for (;;) {
+		size_t length = results[0]->length;
+		for (int r = 0; r <= num_dimensions; r++)
+			if (vector_grow(results[r], length + 1) < 0)
+				return -1;
+		results[0]->data[length] = fact_positions->data[f];
+		for (int d = 0; d < num_dimensions; d++)
+			results[d + 1]->data[length] = dimensions[d].positions->data[match[d]];
+		for (int r = 0; r <= num_dimensions; r++)
+			results[r]->length++;
+
+		// advance the last dimension that has another match, restarting the ones after it
+		int d = num_dimensions - 1;
+		for (; d >= 0; d--) {
+			match[d] = next_match(&tables[d], tables[d].next[match[d]], keys[d]);
+			if (match[d] >= 0)
+				break;
+			match[d] = first[d];
+		}
+		if (d < 0)
+			return 0;
+	}
+}
+
+/*
+ * star_join(fact_positions, dimensions, num_dimensions, status)
+ * Returns num_dimensions + 1 position vectors: the fact positions that match a row in
+ * every dimension, followed by the positions of the matching row of each dimension.
+ * Fact rows keep their order.
+ */
+Vector** star_join(Vector* fact_positions, StarDimension* dimensions, int num_dimensions,
+		Status* status) {
+	for (int d = 0; d < num_dimensions; d++) {
+		StarDimension* dim = &dimensions[d];
+		if (dim->fact_keys->type != dim->values->type
+				|| dim->values->length != dim->positions->length
+				|| (!dim->gather && dim->fact_keys->length != fact_positions->length)) {
+			log_err("Star join dimension %d does not match the fact side.\n", d + 1);
+			status->code = ERROR;
+			return NULL;
+		}
+	}
+
+	Vector** results = calloc(num_dimensions + 1, sizeof *results);
+	DimensionTable tables[MAX_STAR_DIMENSIONS];
+	memset(tables, 0, sizeof tables);
+	int r = results ? 0 : -1;
+	for (int k = 0; k <= num_dimensions && r == 0; k++) {
+		results[k] = alloc_vector(INT);
+		r = results[k] ? 0 : -1;
+	}
+	for (int d = 0; d < num_dimensions && r == 0; d++)
+		r = build_dimension_table(dimensions[d].values, &tables[d]);
+
+	// rows of the block still matching, with their keys and first match per dimension
+	uint32_t selected[STAR_BLOCK_ROWS];
+	uint64_t keys[STAR_BLOCK_ROWS][MAX_STAR_DIMENSIONS];
+	int first[STAR_BLOCK_ROWS][MAX_STAR_DIMENSIONS];
+	size_t num_rows = fact_positions->length;
+	for (size_t start = 0; start < num_rows && r == 0; start += STAR_BLOCK_ROWS) {
+		size_t n = num_rows - start < STAR_BLOCK_ROWS ? num_rows - start : STAR_BLOCK_ROWS;
+		for (size_t i = 0; i < n; i++)
+			selected[i] = i;
+
+		for (int d = 0; d < num_dimensions && n > 0; d++) {
+			StarDimension* dim = &dimensions[d];
+			DimensionTable* table = &tables[d];
+			size_t buckets[STAR_BLOCK_ROWS];
+			size_t kept = 0;
+			// hash the block's keys and prefetch their buckets, then probe
+			for (size_t j = 0; j < n; j++) {
+				size_t f = start + selected[j];
+				size_t row = dim->gather ? (size_t) fact_positions->data[f] : f;
+				if (!star_key(dim->fact_keys, row, &keys[j][d])) {
+					buckets[j] = SIZE_MAX;
+					continue;
+				}
+				buckets[j] = hash_key_bits(keys[j][d]) & (table->num_buckets - 1);
+				__builtin_prefetch(&table->heads[buckets[j]]);
+			}
+			for (size_t j = 0; j < n; j++) {
+				int match = buckets[j] == SIZE_MAX ? -1
+					: next_match(table, table->heads[buckets[j]], keys[j][d]);
+				selected[kept] = selected[j];
+				memcpy(keys[kept], keys[j], sizeof keys[j]);
+				memcpy(first[kept], first[j], sizeof first[j]);
+				first[kept][d] = match;
+				kept += match >= 0;
+			}
+			n = kept;
+		}
+
+		for (size_t j = 0; j < n && r == 0; j++)
+			r = emit_star_rows(results, fact_positions, dimensions, tables, num_dimensions,
+					start + selected[j], first[j], keys[j]);
+	}
+
+	for (int d = 0; d < num_dimensions; d++)
+		free_dimension_table(&tables[d]);
+	if (r < 0) {
+		for (int k = 0; results && k <= num_dimensions; k++)
+			release_vector(results[k]);
+		free(results);
+		status->code = ERROR;
+		return NULL;
+	}
+	for (int k = 0; k <= num_dimensions; k++)
+		vector_trim(results[k]);
+	return results;
 }
@@ -80,7 +80,7 @@ int send_load_data(char* read_buffer, int client_socket)  {
 		return -1;
 	}
 
-	int* buf = malloc(file_stat.st_size);	
+	char* buf = malloc(file_stat.st_size);	
 	if (!buf) { 
 		log_err("Client could not allocate buffer for reading from loaded file.\n");
 		printf("--Client could not allocate buffer for reading from loaded file.\n");
@@ -184,18 +184,18 @@ int send_load_data(char* read_buffer, int client_socket)  {
 	return 0;
 }
 
-int read_data(FILE* fp, int* buf) {
-	char read_buf[DEFAULT_BUFFER_SIZE];
-	long data_read = 0;
-	while (fgets(read_buf, DEFAULT_BUFFER_SIZE, fp)) {
-		char* line_copy = strdup(read_buf);
-		char* token;
-		while ((token = strsep(&line_copy, ",")) != NULL) {
-			buf[data_read] = atoi(token);
-			data_read++;
-		}		
-	}
-	return data_read * sizeof *buf;
+/*
+ * read_data(FILE* fp, char* buf)
+ * Reads the csv rows following the header line into buf. Rows are sent to the server as
+ * text, which parses each field according to the type of its column.
+ * Returns the number of bytes read.
+ */
+int read_data(FILE* fp, char* buf) {
+	size_t data_read = 0;
+	size_t r;
+	while ((r = fread(buf + data_read, 1, DEFAULT_BUFFER_SIZE, fp)) > 0)
+		data_read += r;
+	return ferror(fp) ? -1 : (int) data_read;
 }
 
 char* extract_load_filename(char* buffer) {
@@ -15,832 +15,759 @@
 #include <ctype.h>
 
 #include "cs165_api.h"
+#include "data_types.h"
+#include "expression.h"
 #include "parse.h"
 #include "utils.h"
 #include "client_context.h"
 
-/**
- * Takes a pointer to a string.
- * This method returns the original string truncated to where its first comma lies.
- * In addition, the original string now points to the first character after that comma.
- * This method destroys its input.
- **/
-char* next_token(char** tokenizer, message_status* status) {
-    char* token = strsep(tokenizer, ",");
-    if (token == NULL) {
-        *status= INCORRECT_FORMAT;
-    }
-    return token;
-}
 
 /**
- * parse_command takes as input the send_message from the client and then
- * parses it into the appropriate query. Stores into send_message the
- * status to send back.
- * Returns a db_operator.
+ * tokenize_query splits a query of the form [handle=]command[(arg,...,arg)] in a single
+ * pass over the string. Whitespace and quotes are dropped by compacting the string
+ * behind the read cursor, and separators are overwritten with '\0', so every token
+ * points into the query itself and nothing is allocated. An argument may itself be a
+ * call such as add(a,b), whose separators are kept.
+ * Returns 0 on success, -1 if the query is malformed.
  **/
-DbOperator* parse_command(char* query_command, message* send_message, int client_socket, ClientContext* context) {
-    cs165_log(stdout, "QUERY: %s\n", query_command);
-
-    DbOperator *dbo = NULL;
-
-    char *equals_pointer = strchr(query_command, '=');
-    char *handle = query_command;
-    if (equals_pointer != NULL) {
-        // handle exists, store here. 
-        *equals_pointer = '\0';
-        cs165_log(stdout, "FILE HANDLE: %s\n", handle);
-        query_command = ++equals_pointer;
-    } else {
-        handle = NULL;
-    }
-
-    send_message->status = OK_DONE;
-    query_command = trim_whitespace(query_command);
-
-    // check what command is given. 
-    if (strncmp(query_command, "create", 6) == 0) {
-        query_command += 6;
-        dbo = parse_create(query_command, send_message);
-    } else if (strncmp(query_command, "relational_insert", 17) == 0) {
-        query_command += 17;
-        dbo = parse_insert(query_command, send_message);
-    } else if (strncmp(query_command, "relational_update", 17) == 0) {
-		query_command += 17;
-		dbo = parse_update(query_command, send_message);
-	} else if (strncmp(query_command, "relational_delete", 17) == 0) {
-		query_command += 17;
-		dbo = parse_delete(query_command, send_message);
-	} else if (strncmp(query_command, "select", 6) == 0) {
-		add_handle(context, handle, false);
-		query_command += 6;
-		dbo = parse_select(query_command, context, send_message); 
-		if (dbo)
-			dbo->operator_fields.select_operator.result_handle = handle;
-	} else if (strncmp(query_command, "fetch", 5) == 0) {
-		add_handle(context, handle, false);
-		query_command += 5;
-		dbo = parse_fetch(query_command, send_message);
-		if (dbo)
-			dbo->operator_fields.fetch_operator.result_handle = handle;
-	} else if (strncmp(query_command, "join", 4) == 0) {
-		query_command += 4;
-		char* handle_1 = next_token(&handle, &send_message->status);
-		char* handle_2 = next_token(&handle, &send_message->status);
-
-		// didn't specify handles	
-		if (send_message->status == INCORRECT_FORMAT)
-			return NULL;
-
-		add_handle(context, handle_1, false);
-		add_handle(context, handle_2, false);
-
-		dbo = parse_join(query_command, send_message);
-		if (dbo) {
-			dbo->operator_fields.join_operator.result_1 = handle_1;
-			dbo->operator_fields.join_operator.result_2 = handle_2;
+static int tokenize_query(char* query, QueryTokens* tokens) {
+	tokens->handle = NULL;
+	tokens->command = query;
+	tokens->num_args = 0;
+	tokens->has_args = false;
+
+	bool closed = false;
+	int depth = 0; // of parentheses nested inside the arguments
+	char* out = query;
+	char* token = query;
+	for (char* in = query; *in; in++) {
+		char c = *in;
+		if (isspace((unsigned char) c) || c == '"')
+			continue;
+		if (closed) // text after the closing parenthesis
+			return -1;
+
+		if (!tokens->has_args && c == '=' && !tokens->handle) {
+			*out++ = '\0';
+			tokens->handle = token;
+			tokens->command = token = out;
+		} else if (!tokens->has_args && c == '(') {
+			*out++ = '\0';
+			tokens->has_args = true;
+			token = out;
+		} else if (tokens->has_args && (c == '(' || (depth > 0 && c == ')'))) {
+			depth += c == '(' ? 1 : -1;
+			*out++ = c;
+		} else if (tokens->has_args && depth == 0 && (c == ',' || c == ')')) {
+			if (tokens->num_args == MAX_NUM_QUERY_ARGS)
+				return -1;
+			*out++ = '\0';
+			tokens->args[tokens->num_args++] = token;
+			token = out;
+			closed = c == ')';
+		} else {
+			*out++ = c;
 		}
-	} else if (strncmp(query_command, "print", 5) == 0) {
-		query_command += 5;
-		dbo = parse_print(query_command, send_message);
-	} else if (strncmp(query_command, "shutdown", 8) == 0) {
-		dbo = parse_shutdown(send_message);
-	} else if (strncmp(query_command, "avg", 3) == 0
-			|| strncmp(query_command, "sum", 3) == 0
-			|| strncmp(query_command, "min", 3) == 0 
-			|| strncmp(query_command, "max", 3) == 0) {
-		add_handle(context, handle, false);
-		OperatorType op_type;
-		if (strncmp(query_command, "avg", 3) == 0)
-			op_type = AVERAGE;
-		else if (strncmp(query_command, "sum", 3) == 0)
-			op_type = SUM;
-		else if (strncmp(query_command, "max", 3) == 0)
-			op_type = MAX;
-		else if (strncmp(query_command, "min", 3) == 0)
-			op_type = MIN;
-
-		query_command += 3;
-
-		dbo = parse_unary_aggregate(query_command, send_message);
-		dbo->type = op_type;
-		if (dbo)
-			dbo->operator_fields.unary_aggregate_operator.result_handle = handle;
-	} else if (strncmp(query_command, "add", 3) == 0
-			|| strncmp(query_command, "sub", 3) == 0) {
-		add_handle(context, handle, false);
-		OperatorType op_type;
-		if (strncmp(query_command, "add", 3) == 0)
-			op_type = ADD;
-		else if (strncmp(query_command, "sub", 3) == 0)
-			op_type = SUB;
-
-		query_command += 3;
-		dbo = parse_binary_aggregate(query_command, send_message);
-		dbo->type = op_type;
-		if (dbo)
-			dbo->operator_fields.binary_aggregate_operator.result_handle = handle;
-	} 
-
-    if (dbo == NULL) {
-        return dbo;
-    }
-    
-    dbo->client_fd = client_socket;
-    dbo->context = context;
-    return dbo;
+	}
+	*out = '\0';
+
+	if (tokens->has_args && !closed)
+		return -1;
+	// "f()" has no arguments rather than one empty argument
+	if (tokens->num_args == 1 && tokens->args[0][0] == '\0')
+		tokens->num_args = 0;
+	return 0;
 }
 
-/**
- * parse_create parses a create statement and then passes the necessary arguments off to the next function
- **/
-DbOperator* parse_create(char* create_arguments, message* send_message) {
-    // Since strsep destroys input, we create a copy of our input. 
-    char *tokenizer_copy, *to_free, *token;
-    tokenizer_copy = to_free = malloc((strlen(create_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, create_arguments);
-
-    if (strncmp(tokenizer_copy, "(", 1) == 0) {
-        tokenizer_copy++;
-        // token stores first argument. Tokenizer copy now points to just past first ","
-        token = next_token(&tokenizer_copy, &send_message->status);
-        if (send_message->status == INCORRECT_FORMAT) {
-            return NULL;
-        } else {
-            // pass off to next parse function. 
-            if (strcmp(token, "db") == 0) {
-                return parse_create_db(tokenizer_copy, send_message);
-            } else if (strcmp(token, "tbl") == 0) {
-                return parse_create_tbl(tokenizer_copy, send_message);
-			} else if (strcmp(token, "col") == 0) {
-				return parse_create_col(tokenizer_copy, send_message);
-            } else if (strcmp(token, "idx") == 0) { 
-				return parse_create_idx(tokenizer_copy, send_message);
-			} else {
-                send_message->status = UNKNOWN_COMMAND;
-            }
-        }
-    } else {
+/*
+ * Checks that the command was given between min_args and max_args arguments.
+ */
+static bool expect_args(QueryTokens* tokens, int min_args, int max_args, message* send_message) {
+	if (!tokens->has_args) {
 		send_message->status = UNKNOWN_COMMAND;
-    }
-    free(to_free);
-    return NULL;
+		return false;
+	}
+	if (tokens->num_args < min_args || tokens->num_args > max_args) {
+		send_message->status = INCORRECT_FORMAT;
+		return false;
+	}
+	return true;
 }
 
-
-/**
- * This method takes in a string representing the arguments to create a database.
- * It parses those arguments, checks that they are valid, and creates a database.
- **/
-DbOperator* parse_create_db(char* create_db_arguments, message* send_message) {
-    char *token;
-    token = strsep(&create_db_arguments, ",");
-    // not enough arguments if token is NULL
-    if (token == NULL) {
+/*
+ * Copies a name from the query into an operator, so that the operator stays valid after
+ * the receive buffer is reused (batched operators are executed much later).
+ * Returns false if the name is empty or does not fit.
+ */
+static bool copy_name(char* dst, const char* name, size_t size, message* send_message) {
+	size_t length = strlen(name);
+	if (length == 0 || length >= size) {
 		send_message->status = INCORRECT_FORMAT;
-        return NULL;                    
-    } else {
-        // create the database with given name
-        char* db_name = token;
-        // trim quotes and check for finishing parenthesis.
-        db_name = trim_quotes(db_name);
-        int last_char = strlen(db_name) - 1;
-        if (last_char < 0 || db_name[last_char] != ')') {
-			send_message->status = INCORRECT_FORMAT;
-            return NULL;
-        }
-        // replace final ')' with null-termination character.
-        db_name[last_char] = '\0';
+		return false;
+	}
+	memcpy(dst, name, length + 1);
+	return true;
+}
 
-        token = strsep(&create_db_arguments, ",");
-        if (token != NULL) {
-			send_message->status = INCORRECT_FORMAT;
-            return NULL;
-        }
+/*
+ * Stores the handle assigned by the query as the operator's result and registers it
+ * with the client.
+ */
+static bool assign_result_handle(char* result_handle, char* handle, ClientContext* context,
+		message* send_message) {
+	if (!handle || !copy_name(result_handle, handle, HANDLE_MAX_SIZE, send_message)) {
+		send_message->status = INCORRECT_FORMAT;
+		return false;
+	}
+	add_handle(context, result_handle, false);
+	return true;
+}
 
-		DbOperator* create_db_operator = (DbOperator*) malloc(sizeof(DbOperator));
-		create_db_operator->type = CREATE;
-		create_db_operator->operator_fields.create_operator.type = DB;
-		create_db_operator->operator_fields.create_operator.name = db_name;
+static DbOperator* new_operator(OperatorType type) {
+	DbOperator* dbo = malloc(sizeof *dbo);
+	dbo->type = type;
+	return dbo;
+}
 
-		return create_db_operator;
-    }
+typedef struct Command {
+	const char* name;
+	CommandParser parse;
+	OperatorType type;
+} Command;
+
+// sorted by name for binary search
+static const Command commands[] = {
+	{"add", parse_binary_aggregate, ADD},
+	{"analyze", parse_analyze, ANALYZE},
+	{"avg", parse_unary_aggregate, AVERAGE},
+	{"create", parse_create, CREATE},
+	{"div", parse_binary_aggregate, DIV},
+	{"fetch", parse_fetch, FETCH},
+	{"fetch_multi", parse_fetch_multi, FETCH_MULTI},
+	{"join", parse_join, JOIN},
+	{"max", parse_unary_aggregate, MAX},
+	{"min", parse_unary_aggregate, MIN},
+	{"mul", parse_binary_aggregate, MUL},
+	{"print", parse_print, PRINT},
+	{"relational_delete", parse_delete, DELETE},
+	{"relational_insert", parse_insert, INSERT},
+	{"relational_update", parse_update, UPDATE},
+	{"select", parse_select, SELECT},
+	{"shutdown", parse_shutdown, SHUTDOWN},
+	{"star_join", parse_star_join, STAR_JOIN},
+	{"sub", parse_binary_aggregate, SUB},
+	{"sum", parse_unary_aggregate, SUM},
+};
+
+static int compare_command(const void* name, const void* command) {
+	return strcmp(name, ((const Command*) command)->name);
 }
 
 /**
- * This method takes in a string representing the arguments to create a table.
- * It parses those arguments, checks that they are valid, and creates a table.
+ * parse_command takes as input the send_message from the client and then
+ * parses it into the appropriate query. Stores into send_message the
+ * status to send back. The query string is tokenized in place.
+ * Returns a db_operator.
  **/
-DbOperator* parse_create_tbl(char* create_tbl_arguments, message* send_message) {
-    char** create_arguments_index = &create_tbl_arguments;
-    char* table_name = next_token(create_arguments_index, &send_message->status);
-    char* db_name = next_token(create_arguments_index, &send_message->status);
-    char* col_cnt = next_token(create_arguments_index, &send_message->status);
-
-    // not enough arguments
-    if (send_message->status == INCORRECT_FORMAT) {
-        return NULL;
-    }
-
-    // get the table name free of quotation marks
-    table_name = trim_quotes(table_name);
+DbOperator* parse_command(char* query_command, message* send_message, int client_socket, ClientContext* context) {
+	cs165_log(stdout, "QUERY: %s\n", query_command);
 
-	// check if this table already exists
-	if (table_exists(db_name, table_name)) {
-		send_message->status = OBJECT_ALREADY_EXISTS;
-		return NULL;	
-	}
+	send_message->status = OK_DONE;
 
-    // read and chop off last char, which should be a ')'
-    int last_char = strlen(col_cnt) - 1;
-    if (col_cnt[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
-        return NULL;
-    }
-    // replace the ')' with a null terminating character. 
-    col_cnt[last_char] = '\0';
-
-    // check that the database argument is the current active database
-    if (strcmp(current_db->name, db_name) != 0) {
-        cs165_log(stdout, "query unsupported. Bad db name\n");
-		send_message->status = QUERY_UNSUPPORTED;
-        return NULL;
-    }
-
-    // turn the string column count into an integer, and check that the input is valid.
-    int column_cnt = atoi(col_cnt);
-    if (column_cnt < 1) {
+	QueryTokens tokens;
+	if (tokenize_query(query_command, &tokens) < 0) {
 		send_message->status = INCORRECT_FORMAT;
-        return NULL;
-    }
-
-	DbOperator* create_tbl_operator = (DbOperator*) malloc(sizeof(DbOperator));
-	create_tbl_operator->type = CREATE;
-	create_tbl_operator->operator_fields.create_operator.type = TBL;
-	create_tbl_operator->operator_fields.create_operator.name = table_name;
-	create_tbl_operator->operator_fields.create_operator.column_count = column_cnt;
-
-	return create_tbl_operator;
-}
+		return NULL;
+	}
+	if (tokens.handle)
+		cs165_log(stdout, "FILE HANDLE: %s\n", tokens.handle);
 
-/**
- * This method takes in a string representing the arguments to create a column.
- * It parses those arguments, checks that they are valid, and creates a column.
- **/
-DbOperator* parse_create_col(char* create_col_arguments, message* send_message) {
-	char** create_arguments_index = &create_col_arguments;
-    char* col_name = next_token(create_arguments_index, &send_message->status);
-    char* db_and_table_name = next_token(create_arguments_index, &send_message->status);
-
-    // Not enough arguments
-    if (send_message->status == INCORRECT_FORMAT) {
-        return NULL;
-    }
-	// Get the table name free of quotation marks
-    col_name = trim_quotes(col_name);
-
-    // read and chop off last char, which should be a ')'
-    int last_char = strlen(db_and_table_name) - 1;
-    if (db_and_table_name[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
-        return NULL;
-    }
-    // replace the ')' with a null terminating character. 
-	db_and_table_name[last_char] = '\0';
-
-	// Find table to pass to create_col
-	Table* current_table = lookup_table(db_and_table_name);
-	if (!current_table) {
-		send_message->status = INCORRECT_FORMAT;
+	const Command* command = bsearch(tokens.command, commands,
+			sizeof commands / sizeof commands[0], sizeof commands[0], compare_command);
+	if (!command)
 		return NULL;
-	} 
 
-	DbOperator* create_col_operator = malloc(sizeof *create_col_operator);
-	create_col_operator->type = CREATE;
-	create_col_operator->operator_fields.create_operator.type = COL;
-	create_col_operator->operator_fields.create_operator.name = col_name;
-	create_col_operator->operator_fields.create_operator.table = current_table;
+	DbOperator* dbo = command->parse(&tokens, command->type, context, send_message);
+	if (dbo == NULL) {
+		return dbo;
+	}
 
-    return create_col_operator;
+	dbo->client_fd = client_socket;
+	dbo->context = context;
+	return dbo;
 }
 
 /**
- * This method takes in a string representing the arguments to create a index.
- * It parses those arguments, checks that they are valid, and creates a index.
+ * parse_create parses create(db,...), create(tbl,...), create(col,...) and create(idx,...)
  **/
-DbOperator* parse_create_idx(char* create_idx_arguments, message* send_message) {
-	char** create_arguments_index = &create_idx_arguments;
-    char* col_name = next_token(create_arguments_index, &send_message->status);
-    char* idx_type_arg = next_token(create_arguments_index, &send_message->status);
-    char* cluster_arg = next_token(create_arguments_index, &send_message->status);
-
-    // Not enough arguments
-    if (send_message->status == INCORRECT_FORMAT) {
-        return NULL;
-    }
-
-	int last_char = strlen(cluster_arg) - 1;
-	if (cluster_arg[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
-		return NULL;
-	}
-	cluster_arg[last_char] = '\0';
-	
-	// Lookup column to create index on 
-	col_name = trim_quotes(col_name);
-	Column* column = lookup_column(col_name);
-	if (!column) {
-		send_message->status = OBJECT_NOT_FOUND;	
-		return NULL;
-	}
-
-	// check for index type - btree or sorted
-	IndexType idx_type;
-	if (strncmp(idx_type_arg, BTREE_IDX_ARG, strlen(BTREE_IDX_ARG)) == 0) {
-		idx_type = BTREE;
-	} else if (strncmp(idx_type_arg, SORTED_IDX_ARG, strlen(SORTED_IDX_ARG)) == 0) {
-		idx_type = SORTED;
+DbOperator* parse_create(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) context;
+	if (!expect_args(tokens, 2, 4, send_message))
+		return NULL;
+
+	char** args = tokens->args;
+	int num_args = tokens->num_args;
+	DbOperator* dbo = NULL;
+	if (strcmp(args[0], "db") == 0) {
+		// create(db,"db1")
+		if (num_args != 2) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		dbo = new_operator(type);
+		dbo->operator_fields.create_operator.type = DB;
+		if (!copy_name(dbo->operator_fields.create_operator.name, args[1], MAX_SIZE_NAME,
+					send_message)) {
+			free(dbo);
+			return NULL;
+		}
+	} else if (strcmp(args[0], "tbl") == 0) {
+		// create(tbl,"tbl1",db1,4)
+		if (num_args != 4) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		char* table_name = args[1];
+		char* db_name = args[2];
+		if (table_exists(db_name, table_name)) {
+			send_message->status = OBJECT_ALREADY_EXISTS;
+			return NULL;
+		}
+		// check that the database argument is the current active database
+		if (!current_db || strcmp(current_db->name, db_name) != 0) {
+			cs165_log(stdout, "query unsupported. Bad db name\n");
+			send_message->status = QUERY_UNSUPPORTED;
+			return NULL;
+		}
+		int column_cnt = atoi(args[3]);
+		if (column_cnt < 1) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		dbo = new_operator(type);
+		dbo->operator_fields.create_operator.type = TBL;
+		dbo->operator_fields.create_operator.column_count = column_cnt;
+		if (!copy_name(dbo->operator_fields.create_operator.name, table_name, MAX_SIZE_NAME,
+					send_message)) {
+			free(dbo);
+			return NULL;
+		}
+	} else if (strcmp(args[0], "col") == 0) {
+		// create(col,"col1",db1.tbl1) with an optional trailing type, e.g. ...,long)
+		if (num_args < 3) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		DataType data_type = INT;
+		if (num_args == 4 && parse_data_type(args[3], &data_type) < 0) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		Table* table = lookup_table(args[2]);
+		if (!table) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		dbo = new_operator(type);
+		dbo->operator_fields.create_operator.type = COL;
+		dbo->operator_fields.create_operator.table = table;
+		dbo->operator_fields.create_operator.data_type = data_type;
+		if (!copy_name(dbo->operator_fields.create_operator.name, args[1], MAX_SIZE_NAME,
+					send_message)) {
+			free(dbo);
+			return NULL;
+		}
+	} else if (strcmp(args[0], "idx") == 0) {
+		// create(idx,db1.tbl1.col1,btree,clustered)
+		if (num_args != 4) {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		Column* column = lookup_column(args[1]);
+		if (!column) {
+			send_message->status = OBJECT_NOT_FOUND;
+			return NULL;
+		}
+		IndexType idx_type;
+		if (strcmp(args[2], BTREE_IDX_ARG) == 0) {
+			idx_type = BTREE;
+		} else if (strcmp(args[2], SORTED_IDX_ARG) == 0) {
+			idx_type = SORTED;
+		} else if (strcmp(args[2], CRACKED_IDX_ARG) == 0) {
+			idx_type = CRACKED;
+		} else {
+			send_message->status = INCORRECT_FORMAT;
+			return NULL;
+		}
+		dbo = new_operator(type);
+		dbo->operator_fields.create_operator.type = IDX;
+		dbo->operator_fields.create_operator.column = column;
+		dbo->operator_fields.create_operator.idx_type = idx_type;
+		dbo->operator_fields.create_operator.clustered = strcmp(args[3], CLUSTERED_IDX_ARG) == 0;
 	} else {
-		send_message->status = INCORRECT_FORMAT;
-		return NULL;
+		send_message->status = UNKNOWN_COMMAND;
 	}
-
-	bool is_clustered = strncmp(cluster_arg, "clustered", strlen("clustered")) == 0 ? true : false;
-
-	DbOperator* create_idx_operator = malloc(sizeof *create_idx_operator);
-	create_idx_operator->type = CREATE;
-	create_idx_operator->operator_fields.create_operator.type = IDX;
-	create_idx_operator->operator_fields.create_operator.column = column;
-	create_idx_operator->operator_fields.create_operator.idx_type = idx_type;
-	create_idx_operator->operator_fields.create_operator.clustered = is_clustered;
-
-	return create_idx_operator;
+	return dbo;
 }
 
 /**
  * parse_insert reads in the arguments for a insert statement and 
  * then passes these arguments to a database function to insert a row.
+ * relational_insert(db1.tbl1,1,2,3)
  **/
-DbOperator* parse_insert(char* insert_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free, *token;
-    tokenizer_copy = to_free = malloc((strlen(insert_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, insert_arguments);
-
-    unsigned int columns_inserted = 0;
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) == 0) {
-        tokenizer_copy++;
-        char** command_index = &tokenizer_copy;
-        // parse table input
-        char* table_name = next_token(command_index, &send_message->status);
-        if (send_message->status == INCORRECT_FORMAT) {
-            return NULL;
-        }
-        // lookup the table and make sure it exists. 
-        Table* insert_table = lookup_table(table_name);
-        if (insert_table == NULL) {
-            send_message->status = OBJECT_NOT_FOUND;
-            return NULL;
-        }
-        // make insert operator. 
-        DbOperator* dbo = malloc(sizeof(DbOperator));
-        dbo->type = INSERT;
-        dbo->operator_fields.insert_operator.table = insert_table;
-        dbo->operator_fields.insert_operator.values = malloc(sizeof(int) * insert_table->columns_size);
-
-        // parse inputs until we reach the end. Turn each given string into an integer. 
-        while ((token = strsep(command_index, ",")) != NULL) {
-            int insert_val = atoi(token);
-            dbo->operator_fields.insert_operator.values[columns_inserted] = insert_val;
-            columns_inserted++;
-        }
-        // check that we received the correct number of input values
-        if (columns_inserted != insert_table->columns_size) {
-            send_message->status = INCORRECT_FORMAT;
-            free (dbo);
-            return NULL;
-        } 
-
-		free(to_free);
-        return dbo;
-    } else {
-        send_message->status = UNKNOWN_COMMAND;
-        return NULL;
-    }
-}
-
-DbOperator* parse_update(char* update_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc((strlen(update_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, update_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-        send_message->status = INCORRECT_FORMAT;
-        return NULL;
-	}
-	tokenizer_copy++;
-
-	char** command_index = &tokenizer_copy;
-
-	char* column_name = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+DbOperator* parse_insert(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) context;
+	if (!expect_args(tokens, 1, MAX_NUM_QUERY_ARGS, send_message))
 		return NULL;
-	}
 
 	// lookup the table and make sure it exists. 
-	Column* column = lookup_column(column_name);
-	if (!column) {
+	Table* insert_table = lookup_table(tokens->args[0]);
+	if (insert_table == NULL) {
 		send_message->status = OBJECT_NOT_FOUND;
 		return NULL;
 	}
-
-	Table* table = lookup_table_for_column(column_name);
-	if (!table) {
-		send_message->status = OBJECT_NOT_FOUND;
+	// check that we received the correct number of input values
+	size_t num_values = tokens->num_args - 1;
+	if (num_values != insert_table->columns_size) {
+		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
 
-	char* positions_handle = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
-		return NULL;
+	DbOperator* dbo = new_operator(type);
+	dbo->operator_fields.insert_operator.table = insert_table;
+	dbo->operator_fields.insert_operator.values = malloc(sizeof(Value) * num_values);
+
+	// turn each given string into a value of its column's type
+	for (size_t i = 0; i < num_values; i++) {
+		if (parse_value(tokens->args[i + 1], insert_table->columns[i].type,
+					&dbo->operator_fields.insert_operator.values[i]) < 0) {
+			send_message->status = INCORRECT_FORMAT;
+			free(dbo->operator_fields.insert_operator.values);
+			free(dbo);
+			return NULL;
+		}
 	}
+	return dbo;
+}
 
-	char* value_str = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+/*
+ * relational_update(db1.tbl1.col1,pos,value)
+ */
+DbOperator* parse_update(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) context;
+	if (!expect_args(tokens, 3, 3, send_message))
 		return NULL;
-	}
 
-	int last_char = strlen(value_str) - 1;
-	if (value_str[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
+	// lookup the column and its table and make sure they exist.
+	Column* column = lookup_column(tokens->args[0]);
+	Table* table = lookup_table_for_column(tokens->args[0]);
+	if (!column || !table) {
+		send_message->status = OBJECT_NOT_FOUND;
 		return NULL;
 	}
-	value_str[last_char] = '\0';
 
-	// make insert operator. 
-	DbOperator* dbo = malloc(sizeof(DbOperator));
-	dbo->type = UPDATE;
+	DbOperator* dbo = new_operator(type);
 	dbo->operator_fields.update_operator.column = column;
 	dbo->operator_fields.update_operator.table = table;
-	dbo->operator_fields.update_operator.positions_handle = positions_handle;
-	dbo->operator_fields.update_operator.value = atoi(value_str);
-
-	free(to_free);
+	if (!copy_name(dbo->operator_fields.update_operator.positions_handle, tokens->args[1],
+				HANDLE_MAX_SIZE, send_message)
+			|| parse_value(tokens->args[2], column->type,
+				&dbo->operator_fields.update_operator.value) < 0) {
+		send_message->status = INCORRECT_FORMAT;
+		free(dbo);
+		return NULL;
+	}
 	return dbo;
 }
 
-DbOperator* parse_delete(char* delete_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc((strlen(delete_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, delete_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-        send_message->status = INCORRECT_FORMAT;
-        return NULL;
-	}
-	tokenizer_copy++;
-
-	char** command_index = &tokenizer_copy;
-
-	char* table_name = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+/*
+ * relational_delete(db1.tbl1,pos)
+ */
+DbOperator* parse_delete(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) context;
+	if (!expect_args(tokens, 2, 2, send_message))
 		return NULL;
-	}
 
 	// lookup the table and make sure it exists. 
-	Table* table = lookup_table(table_name);
+	Table* table = lookup_table(tokens->args[0]);
 	if (!table) {
 		send_message->status = OBJECT_NOT_FOUND;
 		return NULL;
 	}
 
-	char* positions_handle = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
-		return NULL;
-	}
-
-	int last_char = strlen(positions_handle) - 1;
-	if (positions_handle[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
+	DbOperator* dbo = new_operator(type);
+	dbo->operator_fields.delete_operator.table = table;
+	if (!copy_name(dbo->operator_fields.delete_operator.positions_handle, tokens->args[1],
+				HANDLE_MAX_SIZE, send_message)) {
+		free(dbo);
 		return NULL;
 	}
-	positions_handle[last_char] = '\0';
-
-	// make insert operator. 
-	DbOperator* dbo = malloc(sizeof(DbOperator));
-	dbo->type = DELETE;
-	dbo->operator_fields.delete_operator.table = table;
-	dbo->operator_fields.delete_operator.positions_handle = positions_handle;
-
-	free(to_free);
 	return dbo;
 }
 
 /*
  * parse_select
+ * s=select(db1.tbl1.col1,low,high) or, on a fetched vector, s=select(pos,vals,low,high).
+ * The values may also be an expression, e.g. s=select(sub(a,b),low,high).
+ * Either bound may be null. Handles are only looked up when the select executes, as they
+ * may be assigned by earlier queries of the same batch.
  */
-DbOperator* parse_select(char* select_arguments, ClientContext* context, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc(strlen(select_arguments)+1);
-    strcpy(tokenizer_copy, select_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-		send_message->status = UNKNOWN_COMMAND;
-		return NULL;
-    }
-
-	tokenizer_copy++;
-	char** command_index = &tokenizer_copy;
-
-	char* column_name = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
-		return NULL;
-	}
-
-	// lookup the table and make sure it exists. 
-	Column* select_column = lookup_column(column_name);
-	if (!select_column) {
-		GeneralizedColumnHandle* generalized_handle = lookup_client_handle(context, column_name);
-		if (!generalized_handle) {
-			send_message->status = OBJECT_NOT_FOUND;
+DbOperator* parse_select(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	if (!expect_args(tokens, 3, 4, send_message))
+		return NULL;
+
+	char** args = tokens->args;
+	DbOperator* dbo = new_operator(type);
+	SelectOperator* select = &dbo->operator_fields.select_operator;
+	select->column = NULL;
+	select->expression.num_instructions = 0;
+	select->positions_handle[0] = '\0';
+	select->values_handle[0] = '\0';
+
+	char* values_arg = args[0];
+	char* low_arg = args[1];
+	char* high_arg = args[2];
+	if (tokens->num_args == 4) { // select-fetch
+		if (!copy_name(select->positions_handle, args[0], HANDLE_MAX_SIZE, send_message)) {
+			free(dbo);
 			return NULL;
 		}
-		select_column = generalized_handle->generalized_column.column_pointer.column;
-	}
-	
-	// parse upper and lower bounds
-	char* token2 = strsep(command_index, ",");
-	char* token3 = strsep(command_index, ",");
-	char* token4 = strsep(command_index, ",");
-	int high = INT_MAX;
-	int low = INT_MIN;
-	GeneralizedColumnHandle* values_vec = NULL;
-
-	// make select operator. 
-	DbOperator* dbo = malloc(sizeof(DbOperator));
-	dbo->type = SELECT;
-
-	if (!token4) { // regular select
-		if (strncmp(token2, "null", 4) != 0) {
-			low = atoi(token2);
-		}
-		if (strncmp(token3, "null", 4) != 0) {
-			high = atoi(token3);
-		}
-		dbo->operator_fields.select_operator.column = select_column;
-		dbo->operator_fields.select_operator.values = NULL; 
-	} else { // select-fetch
-		values_vec = lookup_client_handle(context, token2);
-		if (strncmp(token3, "null", 4) != 0) {
-			low = atoi(token3);
+		values_arg = args[1];
+		low_arg = args[2];
+		high_arg = args[3];
+	}
+	if (is_expression(values_arg)) {
+		if (compile_expression(&select->expression, values_arg) < 0) {
+			send_message->status = INCORRECT_FORMAT;
+			free(dbo);
+			return NULL;
 		}
-		if (strncmp(token4, "null", 4) != 0) {
-			high = atoi(token4);
+	} else if (tokens->num_args == 3 && (select->column = lookup_column(values_arg))) {
+		// bounds are parsed as values of the column's type
+		if (parse_bounds(low_arg, high_arg, select->column->type, &select->low,
+					&select->high) < 0) {
+			send_message->status = INCORRECT_FORMAT;
+			free(dbo);
+			return NULL;
 		}
-		dbo->operator_fields.select_operator.column = select_column;
-		dbo->operator_fields.select_operator.values = values_vec 
-			? values_vec->generalized_column.column_pointer.column
-			: NULL;
+	} else if (strchr(values_arg, '.')) { // names a column that does not exist
+		send_message->status = OBJECT_NOT_FOUND;
+		free(dbo);
+		return NULL;
+	} else if (!copy_name(select->values_handle, values_arg, HANDLE_MAX_SIZE, send_message)) {
+		free(dbo);
+		return NULL;
+	}
+
+	// other bounds must at least be numbers; their type is checked when the select executes
+	Value low;
+	Value high;
+	if ((!select->column && (parse_bounds(low_arg, high_arg, FLOAT, &low, &high) < 0
+				|| !copy_name(select->low_arg, low_arg, SELECT_BOUND_MAX_SIZE, send_message)
+				|| !copy_name(select->high_arg, high_arg, SELECT_BOUND_MAX_SIZE,
+					send_message)))
+			|| !assign_result_handle(select->result_handle, tokens->handle, context,
+				send_message)) {
+		send_message->status = INCORRECT_FORMAT;
+		free(dbo);
+		return NULL;
 	}
-	dbo->operator_fields.select_operator.low = low;
-	dbo->operator_fields.select_operator.high = high;
 	return dbo;
 }
 
 /* 
  * parse fetch
+ * f=fetch(db1.tbl1.col1,pos)
  */
-DbOperator* parse_fetch(char* fetch_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc(strlen(fetch_arguments)+1);
-    strcpy(tokenizer_copy, fetch_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-		send_message->status = UNKNOWN_COMMAND;
+DbOperator* parse_fetch(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	if (!expect_args(tokens, 2, 2, send_message))
 		return NULL;
-    }
-	tokenizer_copy++;
-	char** command_index = &tokenizer_copy;
 
-	char* column_name = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+	// lookup the column and make sure it exists. 
+	Column* fetch_column = lookup_column(tokens->args[0]);
+	if (!fetch_column) {
+		send_message->status = OBJECT_NOT_FOUND;
 		return NULL;
 	}
 
-	// lookup the table and make sure it exists. 
-	Column* fetch_column = lookup_column(column_name);
-	if (!fetch_column) {
-		send_message->status = OBJECT_NOT_FOUND;
+	DbOperator* dbo = new_operator(type);
+	dbo->operator_fields.fetch_operator.column = fetch_column;
+	if (!copy_name(dbo->operator_fields.fetch_operator.positions_handle, tokens->args[1],
+				HANDLE_MAX_SIZE, send_message)
+			|| !assign_result_handle(dbo->operator_fields.fetch_operator.result_handle,
+				tokens->handle, context, send_message)) {
+		free(dbo);
 		return NULL;
 	}
+	return dbo;
+}
 
-	char* handle = next_token(command_index, &send_message->status);
-	int last_char = strlen(handle) - 1;
-	if (last_char < 0 || handle[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
+/*
+ * f1,...=fetch_multi(db1.tbl1,col1,...,pos) fetches up to MAX_FETCH_COLUMNS columns of a
+ * table at the same positions, assigning one handle per column in order
+ */
+DbOperator* parse_fetch_multi(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	if (!expect_args(tokens, 3, MAX_FETCH_COLUMNS + 2, send_message))
 		return NULL;
+
+	int num_columns = tokens->num_args - 2;
+	char* handles[MAX_FETCH_COLUMNS];
+	int num_handles = 0;
+	for (char* h = tokens->handle; h && num_handles < MAX_FETCH_COLUMNS; num_handles++) {
+		handles[num_handles] = h;
+		h = strchr(h, ',');
+		if (h)
+			*h++ = '\0';
 	}
-	// replace final ')' with null-termination character.
-	handle[last_char] = '\0';
-	if (send_message->status == INCORRECT_FORMAT) {
+	if (num_handles != num_columns) {
+		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
 
-	// construct fetch operator. 
-	DbOperator* dbo = malloc(sizeof(DbOperator));
-	dbo->type = FETCH;
-	dbo->operator_fields.fetch_operator.column = fetch_column;
-	dbo->operator_fields.fetch_operator.positions_handle = handle;
+	char** args = tokens->args;
+	if (!lookup_table(args[0])) {
+		send_message->status = OBJECT_NOT_FOUND;
+		return NULL;
+	}
 
+	DbOperator* dbo = new_operator(type);
+	FetchMultiOperator* fetch_op = &dbo->operator_fields.fetch_multi_operator;
+	fetch_op->num_columns = num_columns;
+	for (int c = 0; c < num_columns; c++) {
+		char name[MAX_SIZE_QUALIFIED_NAME];
+		snprintf(name, sizeof name, "%s.%s", args[0], args[1 + c]);
+		fetch_op->columns[c] = lookup_column(name);
+		if (!fetch_op->columns[c]) {
+			send_message->status = OBJECT_NOT_FOUND;
+			free(dbo);
+			return NULL;
+		}
+	}
+	bool ok = copy_name(fetch_op->positions_handle, args[tokens->num_args - 1],
+			HANDLE_MAX_SIZE, send_message);
+	for (int h = 0; h < num_handles && ok; h++)
+		ok = assign_result_handle(fetch_op->result_handles[h], handles[h], context,
+				send_message);
+	if (!ok) {
+		free(dbo);
+		return NULL;
+	}
 	return dbo;
 }
 
-DbOperator* parse_join(char* join_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc((strlen(join_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, join_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-		send_message->status = UNKNOWN_COMMAND;
+/*
+ * r1,r2=join(vals1,pos1,vals2,pos2,type[,cache]) with type nested-loop, hash,
+ * sort-merge, index, auto or grace, a hash join that always spills; cache keeps a hash
+ * join's build for joins over the same rows
+ */
+DbOperator* parse_join(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	if (!expect_args(tokens, 5, 6, send_message))
 		return NULL;
-    }
-	tokenizer_copy++;
-	char** command_index = &tokenizer_copy;
 
-	char* values_1 = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+	// the query assigns two handles, one per side
+	char* handle_2 = tokens->handle ? strchr(tokens->handle, ',') : NULL;
+	if (!handle_2) {
+		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
-
-	char* positions_1 = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+	*handle_2++ = '\0';
+
+	char** args = tokens->args;
+	JoinType join_type;
+	if (strcmp(args[4], NESTED_LOOP_JOIN_ARG) == 0) {
+		join_type = NESTED_LOOP;
+	} else if (strcmp(args[4], HASH_JOIN_ARG) == 0) {
+		join_type = HASH;
+	} else if (strcmp(args[4], SORT_MERGE_JOIN_ARG) == 0) {
+		join_type = SORT_MERGE;
+	} else if (strcmp(args[4], INDEX_JOIN_ARG) == 0) {
+		join_type = INDEX_NESTED_LOOP;
+	} else if (strcmp(args[4], AUTO_JOIN_ARG) == 0) {
+		join_type = AUTO;
+	} else if (strcmp(args[4], GRACE_JOIN_ARG) == 0) {
+		join_type = GRACE_HASH;
+	} else {
+		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
-
-	char* values_2 = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+	if (tokens->num_args == 6 && strcmp(args[5], CACHE_JOIN_ARG) != 0) {
+		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
 
-	char* positions_2 = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+	DbOperator* dbo = new_operator(type);
+	JoinOperator* join_op = &dbo->operator_fields.join_operator;
+	join_op->type = join_type;
+	join_op->cache_build = tokens->num_args == 6;
+	if (!copy_name(join_op->values_1, args[0], HANDLE_MAX_SIZE, send_message)
+			|| !copy_name(join_op->positions_1, args[1], HANDLE_MAX_SIZE, send_message)
+			|| !copy_name(join_op->values_2, args[2], HANDLE_MAX_SIZE, send_message)
+			|| !copy_name(join_op->positions_2, args[3], HANDLE_MAX_SIZE, send_message)
+			|| !assign_result_handle(join_op->result_1, tokens->handle, context, send_message)
+			|| !assign_result_handle(join_op->result_2, handle_2, context, send_message)) {
+		free(dbo);
 		return NULL;
 	}
+	return dbo;
+}
 
-	char* join_type_arg = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+/*
+ * rf,r1,...=star_join(posf,keys1,vals1,pos1,...) with one to MAX_STAR_DIMENSIONS
+ * dimensions, each given by the fact side's foreign keys (a handle aligned with posf or
+ * a base column) and the dimension's keys and positions; assigns the fact positions and
+ * then the positions of each dimension
+ */
+DbOperator* parse_star_join(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	if (!expect_args(tokens, 4, 1 + 3 * MAX_STAR_DIMENSIONS, send_message))
 		return NULL;
-	}
-
-	int last_char = strlen(join_type_arg) - 1;
-	if (last_char < 0 || join_type_arg[last_char] != ')') {
+	if ((tokens->num_args - 1) % 3 != 0) {
 		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
-	// replace final ')' with null-termination character.
-	join_type_arg[last_char] = '\0';
 
-	JoinType type;
-	if (strncmp(join_type_arg, NESTED_LOOP_JOIN_ARG, strlen(NESTED_LOOP_JOIN_ARG)) == 0)
-		type = NESTED_LOOP;
-	else if (strncmp(join_type_arg, HASH_JOIN_ARG, strlen(HASH_JOIN_ARG)) == 0)
-		type = HASH;
-	else {
+	// one handle for the fact side and one per dimension
+	int num_dimensions = (tokens->num_args - 1) / 3;
+	char* handles[MAX_STAR_DIMENSIONS + 1];
+	int num_handles = 0;
+	for (char* h = tokens->handle; h && num_handles <= MAX_STAR_DIMENSIONS; num_handles++) {
+		handles[num_handles] = h;
+		h = strchr(h, ',');
+		if (h)
+			*h++ = '\0';
+	}
+	if (num_handles != num_dimensions + 1) {
 		send_message->status = INCORRECT_FORMAT;
 		return NULL;
 	}
 
-
-	// construct fetch operator. 
-	DbOperator* dbo = malloc(sizeof(DbOperator));
-	dbo->type = JOIN;
-	dbo->operator_fields.join_operator.positions_1 = positions_1;
-	dbo->operator_fields.join_operator.values_1 = values_1;
-	dbo->operator_fields.join_operator.positions_2 = positions_2;
-	dbo->operator_fields.join_operator.values_2 = values_2;
-	dbo->operator_fields.join_operator.type = type;
+	char** args = tokens->args;
+	DbOperator* dbo = new_operator(type);
+	StarJoinOperator* star_op = &dbo->operator_fields.star_join_operator;
+	star_op->num_dimensions = num_dimensions;
+	bool ok = copy_name(star_op->fact_positions, args[0], HANDLE_MAX_SIZE, send_message);
+	for (int d = 0; d < num_dimensions && ok; d++)
+		ok = copy_name(star_op->fact_keys[d], args[1 + 3 * d], MAX_SIZE_QUALIFIED_NAME, send_message)
+			&& copy_name(star_op->values[d], args[2 + 3 * d], HANDLE_MAX_SIZE, send_message)
+			&& copy_name(star_op->positions[d], args[3 + 3 * d], HANDLE_MAX_SIZE, send_message);
+	for (int h = 0; h < num_handles && ok; h++)
+		ok = assign_result_handle(star_op->results[h], handles[h], context, send_message);
+	if (!ok) {
+		free(dbo);
+		return NULL;
+	}
 	return dbo;
 }
 
-DbOperator* parse_print(char* print_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc((strlen(print_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, print_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-		send_message->status = UNKNOWN_COMMAND;
-		return NULL;
-    }
-	tokenizer_copy++;
-	char** command_index = &tokenizer_copy;
-	
-	int num_handles = 0;
-	char** handles = malloc(MAX_NUM_PRINT_HANDLES * sizeof *handles);
-
-	char* handle = NULL;
-	while ((handle = next_token(command_index, &send_message->status))) {
-		if (send_message->status == INCORRECT_FORMAT) {
+/*
+ * print(h1,...) with up to MAX_NUM_PRINT_HANDLES handles or columns
+ */
+DbOperator* parse_print(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) context;
+	if (!expect_args(tokens, 1, MAX_NUM_PRINT_HANDLES, send_message))
+		return NULL;
+
+	DbOperator* dbo = new_operator(type);
+	PrintOperator* print_op = &dbo->operator_fields.print_operator;
+	print_op->num_handles = tokens->num_args;
+	for (int i = 0; i < tokens->num_args; i++) {
+		if (!copy_name(print_op->handles[i], tokens->args[i], MAX_SIZE_QUALIFIED_NAME,
+					send_message)) {
+			free(dbo);
 			return NULL;
 		}
-		handles[num_handles++] = handle;
 	}
+	send_message->status = OK_DONE;
+	return dbo;
+}
 
-	char* last_handle = handles[num_handles - 1];
-	int last_char = strlen(last_handle) - 1;
-	if (last_char < 0 || last_handle[last_char] != ')') {
+/*
+ * a=sum(h), a=avg(h), a=min(h) or a=max(h) over a handle, a column or an expression such
+ * as sum(add(h1,h2))
+ */
+DbOperator* parse_unary_aggregate(QueryTokens* tokens, OperatorType type,
+		ClientContext* context, message* send_message) {
+	if (!expect_args(tokens, 1, 1, send_message))
+		return NULL;
+
+	DbOperator* dbo = new_operator(type);
+	UnaryAggOperator* agg_op = &dbo->operator_fields.unary_aggregate_operator;
+	agg_op->handle[0] = '\0';
+	agg_op->expression.num_instructions = 0;
+	bool parsed = is_expression(tokens->args[0])
+		? compile_expression(&agg_op->expression, tokens->args[0]) == 0
+		: copy_name(agg_op->handle, tokens->args[0], MAX_SIZE_QUALIFIED_NAME, send_message);
+	if (!parsed)
 		send_message->status = INCORRECT_FORMAT;
+	if (!parsed || !assign_result_handle(agg_op->result_handle, tokens->handle, context,
+				send_message)) {
+		free(dbo);
 		return NULL;
 	}
-	last_handle[last_char] = '\0';
-
-	DbOperator* dbo = (DbOperator*) malloc(sizeof(DbOperator));	
-	dbo->type = PRINT;
-	dbo->operator_fields.print_operator.handles = handles;
-	dbo->operator_fields.print_operator.num_handles = num_handles;
 	send_message->status = OK_DONE;
-
 	return dbo;
 }
 
-DbOperator* parse_unary_aggregate(char* unary_agg_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc((strlen(unary_agg_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, unary_agg_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-		send_message->status = UNKNOWN_COMMAND;
+/*
+ * a=add(x,y), a=sub(x,y), a=mul(x,y) or a=div(x,y) where x and y are handles, columns,
+ * constants or nested calls, e.g. a=add(h1,mul(db1.tbl1.col1,2))
+ */
+DbOperator* parse_binary_aggregate(QueryTokens* tokens, OperatorType type,
+		ClientContext* context, message* send_message) {
+	if (!expect_args(tokens, 2, 2, send_message))
 		return NULL;
-    }
-	tokenizer_copy++;
-	char** command_index = &tokenizer_copy;
 
-	char* handle = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+	DbOperator* dbo = new_operator(type);
+	BinaryAggOperator* agg_op = &dbo->operator_fields.binary_aggregate_operator;
+	if (compile_arithmetic(&agg_op->expression, type, tokens->args) < 0) {
+		send_message->status = INCORRECT_FORMAT;
+		free(dbo);
 		return NULL;
 	}
-
-	int last_char = strlen(handle) - 1;
-	if (last_char < 0 || handle[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
+	if (!assign_result_handle(agg_op->result_handle, tokens->handle, context,
+				send_message)) {
+		free(dbo);
 		return NULL;
 	}
-	handle[last_char] = '\0';
-
-	DbOperator* dbo = (DbOperator*) malloc(sizeof(DbOperator));	
-	dbo->operator_fields.unary_aggregate_operator.handle = handle;
 	send_message->status = OK_DONE;
-	
 	return dbo;
 }
 
-DbOperator* parse_binary_aggregate(char* binary_agg_arguments, message* send_message) {
-    char *tokenizer_copy, *to_free;
-    tokenizer_copy = to_free = malloc((strlen(binary_agg_arguments)+1) * sizeof(char));
-    strcpy(tokenizer_copy, binary_agg_arguments);
-
-    // check for leading '('
-    if (strncmp(tokenizer_copy, "(", 1) != 0) {
-		send_message->status = UNKNOWN_COMMAND;
-		return NULL;
-    }
-	tokenizer_copy++;
-	char** command_index = &tokenizer_copy;
-
-	char* handle1 = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
-		return NULL;
-	}
-
-	char* handle2 = next_token(command_index, &send_message->status);
-	if (send_message->status == INCORRECT_FORMAT) {
+/*
+ * parse_analyze
+ * analyze(db.tbl) recomputes the statistics of every column of the table
+ */
+DbOperator* parse_analyze(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) context;
+	if (!expect_args(tokens, 1, 1, send_message))
 		return NULL;
-	}
 
-	int last_char = strlen(handle2) - 1;
-	if (last_char < 0 || handle2[last_char] != ')') {
-		send_message->status = INCORRECT_FORMAT;
+	Table* table = lookup_table(tokens->args[0]);
+	if (!table) {
+		send_message->status = OBJECT_NOT_FOUND;
 		return NULL;
 	}
-	handle2[last_char] = '\0';
 
-	DbOperator* dbo = (DbOperator*) malloc(sizeof(DbOperator));	
-	dbo->operator_fields.binary_aggregate_operator.handle1 = handle1;
-	dbo->operator_fields.binary_aggregate_operator.handle2 = handle2;
-	send_message->status = OK_DONE;
-	
+	DbOperator* dbo = new_operator(type);
+	dbo->operator_fields.analyze_operator.table = table;
 	return dbo;
 }
 
-DbOperator* parse_shutdown(message* send_message) {
-	DbOperator* dbo = malloc(sizeof(DbOperator));
-	dbo->type = SHUTDOWN;
+DbOperator* parse_shutdown(QueryTokens* tokens, OperatorType type, ClientContext* context,
+		message* send_message) {
+	(void) tokens;
+	(void) context;
+	DbOperator* dbo = new_operator(type);
 	send_message->status = OK;
 	return dbo;
 }
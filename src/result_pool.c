@@ -0,0 +1,314 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "cs165_api.h"
+#include "data_types.h"
+#include "result_pool.h"
+
+/*
+ * Intermediate results.
+ * Vectors produced by queries (select, fetch, join, add/sub) take their headers from a
+ * slab pool and are reference counted by the client handles that refer to them. When the
+ * last handle is overwritten or removed, or its client disconnects, the header goes back
+ * on the free list.
+ *
+ * Vector buffers are bump-allocated from arena chunks. A kernel reserves the most values
+ * it can produce, writes them, and trims the reservation to the values it wrote; the tail
+ * goes back to the chunk as long as no other buffer was carved after it, so results are
+ * right-sized without a copy. Buffers larger than ARENA_DEDICATED_SIZE, such as the
+ * reservation of a select over a whole column, get a chunk of their own instead, which is
+ * reallocated when they are trimmed or grown; they never become the chunk small buffers
+ * are carved from, so a trimmed result does not keep its reservation alive and a small
+ * long-lived result pins at most one shared chunk. A chunk is freed once no vector uses
+ * it, or rewound if it is still the chunk new buffers come from.
+ * Batches and clients run operators on several threads, hence the lock, which also guards
+ * the reference counts of vectors and results.
+ */
+
+static Vector** free_vectors = NULL;
+static size_t num_free_vectors = 0;
+static size_t free_vectors_capacity = 0;
+static ArenaChunk* current_chunk = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// adds a slab of headers to the free list; called with pool_lock held
+static int add_slab() {
+	size_t new_capacity = free_vectors_capacity + RESULT_POOL_SLAB_SIZE;
+	Vector** new_free = realloc(free_vectors, sizeof *new_free * new_capacity);
+	if (!new_free)
+		return -1;
+	free_vectors = new_free;
+	free_vectors_capacity = new_capacity;
+
+	Vector* slab = malloc(sizeof *slab * RESULT_POOL_SLAB_SIZE);
+	if (!slab)
+		return -1;
+	for (int i = 0; i < RESULT_POOL_SLAB_SIZE; i++)
+		free_vectors[num_free_vectors++] = &slab[i];
+	return 0;
+}
+
+static size_t align_up(size_t bytes) {
+	return (bytes + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+}
+
+// start of the chunk's usable memory, aligned to ARENA_ALIGNMENT
+static char* chunk_base(ArenaChunk* chunk) {
+	return (char*) align_up((uintptr_t) chunk->data);
+}
+
+// drops a vector's use of chunk; called with pool_lock held
+static void unuse_chunk(ArenaChunk* chunk) {
+	if (--chunk->live > 0)
+		return;
+	if (chunk == current_chunk)
+		chunk->used = 0;
+	else
+		free(chunk);
+}
+
+static ArenaChunk* new_chunk(size_t capacity, bool dedicated) {
+	ArenaChunk* chunk = malloc(sizeof *chunk + capacity + ARENA_ALIGNMENT - 1);
+	if (!chunk)
+		return NULL;
+	chunk->capacity = capacity;
+	chunk->used = 0;
+	chunk->live = 0;
+	chunk->dedicated = dedicated;
+	return chunk;
+}
+
+// carves bytes out of the current chunk, starting a new chunk if they do not fit, or gives
+// them a dedicated chunk if they are large; called with pool_lock held
+static char* arena_alloc(size_t bytes, ArenaChunk** chunk_out) {
+	if (bytes > ARENA_DEDICATED_SIZE) {
+		ArenaChunk* chunk = new_chunk(bytes, true);
+		if (!chunk)
+			return NULL;
+		chunk->used = bytes;
+		chunk->live = 1;
+		*chunk_out = chunk;
+		return chunk_base(chunk);
+	}
+
+	if (!current_chunk || current_chunk->capacity - current_chunk->used < bytes) {
+		ArenaChunk* chunk = new_chunk(ARENA_CHUNK_SIZE, false);
+		if (!chunk)
+			return NULL;
+		if (current_chunk && current_chunk->live == 0)
+			free(current_chunk);
+		current_chunk = chunk;
+	}
+
+	char* buf = chunk_base(current_chunk) + current_chunk->used;
+	current_chunk->used += bytes;
+	current_chunk->live++;
+	*chunk_out = current_chunk;
+	return buf;
+}
+
+// whether vec's buffer is the last one carved from its chunk, so that it can be resized
+// in place; called with pool_lock held
+static bool is_chunk_top(Vector* vec) {
+	size_t end = (char*) vec->data - chunk_base(vec->chunk)
+		+ vec->capacity * data_type_size(vec->type);
+	return vec->chunk->used == end;
+}
+
+// resizes the dedicated chunk of vec to hold bytes, keeping its values; the buffer moves if
+// the chunk does. Returns 0 on success, -1 if out of memory; called with pool_lock held
+static int resize_dedicated(Vector* vec, size_t bytes) {
+	ArenaChunk* chunk = vec->chunk;
+	size_t offset = (char*) vec->data - chunk->data;
+	chunk = realloc(chunk, sizeof *chunk + bytes + ARENA_ALIGNMENT - 1);
+	if (!chunk)
+		return -1;
+
+	// the new block may be aligned differently, moving where the buffer has to start
+	char* base = chunk_base(chunk);
+	size_t keep = vec->length * data_type_size(vec->type);
+	if (base != chunk->data + offset)
+		memmove(base, chunk->data + offset, keep < bytes ? keep : bytes);
+	chunk->capacity = bytes;
+	chunk->used = bytes;
+	vec->chunk = chunk;
+	vec->data = (int*) base;
+	vec->capacity = bytes / data_type_size(vec->type);
+	return 0;
+}
+
+/*
+ * alloc_vector(DataType type)
+ * Returns an empty vector of the given type with no buffer and no references, or NULL.
+ */
+Vector* alloc_vector(DataType type) {
+	pthread_mutex_lock(&pool_lock);
+	Vector* vec = NULL;
+	if (num_free_vectors > 0 || add_slab() == 0)
+		vec = free_vectors[--num_free_vectors];
+	pthread_mutex_unlock(&pool_lock);
+
+	if (!vec)
+		return NULL;
+	memset(vec, 0, sizeof *vec);
+	vec->type = type;
+	return vec;
+}
+
+/*
+ * vector_reserve(Vector* vec, size_t num_values)
+ * Gives vec an empty buffer for at least num_values values, replacing any buffer it had.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int vector_reserve(Vector* vec, size_t num_values) {
+	size_t width = data_type_size(vec->type);
+	size_t bytes = align_up((num_values > 0 ? num_values : 1) * width);
+
+	pthread_mutex_lock(&pool_lock);
+	ArenaChunk* chunk;
+	char* buf = arena_alloc(bytes, &chunk);
+	if (buf) {
+		if (vec->chunk)
+			unuse_chunk(vec->chunk);
+		vec->data = (int*) buf;
+		vec->chunk = chunk;
+		vec->capacity = bytes / width;
+		vec->length = 0;
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return buf ? 0 : -1;
+}
+
+/*
+ * vector_grow(Vector* vec, size_t num_values)
+ * Makes room for at least num_values values, keeping the current ones. The buffer grows in
+ * place if it is the top of its chunk and the chunk has room, or with its chunk if the
+ * chunk is dedicated to it; otherwise it moves.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int vector_grow(Vector* vec, size_t num_values) {
+	if (num_values <= vec->capacity)
+		return 0;
+	if (!vec->chunk)
+		return vector_reserve(vec, num_values);
+
+	size_t width = data_type_size(vec->type);
+	if (num_values < vec->capacity * 2)
+		num_values = vec->capacity * 2;
+	size_t bytes = align_up(num_values * width);
+
+	pthread_mutex_lock(&pool_lock);
+	int r = 0;
+	size_t offset = (char*) vec->data - chunk_base(vec->chunk);
+	if (vec->chunk->dedicated) {
+		r = resize_dedicated(vec, bytes);
+	} else if (is_chunk_top(vec) && vec->chunk->capacity - offset >= bytes) {
+		vec->chunk->used = offset + bytes;
+	} else {
+		ArenaChunk* chunk;
+		char* buf = arena_alloc(bytes, &chunk);
+		if (buf) {
+			memcpy(buf, vec->data, vec->length * width);
+			unuse_chunk(vec->chunk);
+			vec->data = (int*) buf;
+			vec->chunk = chunk;
+		} else {
+			r = -1;
+		}
+	}
+	if (r == 0)
+		vec->capacity = bytes / width;
+	pthread_mutex_unlock(&pool_lock);
+	return r;
+}
+
+// shrinks vec's reservation to its length, returning the rest to the chunk if possible
+void vector_trim(Vector* vec) {
+	if (!vec->chunk)
+		return;
+	size_t width = data_type_size(vec->type);
+
+	pthread_mutex_lock(&pool_lock);
+	size_t bytes = align_up(vec->length * width);
+	if (vec->chunk->dedicated) {
+		if (bytes < vec->chunk->capacity)
+			resize_dedicated(vec, bytes); // on failure the buffer keeps its size
+	} else if (is_chunk_top(vec)) {
+		vec->chunk->used = (char*) vec->data - chunk_base(vec->chunk) + bytes;
+		vec->capacity = bytes / width;
+	}
+	pthread_mutex_unlock(&pool_lock);
+}
+
+// marks a vector of ascending positions as sorted, bounded by its first and last position
+void vector_mark_sorted(Vector* positions) {
+	positions->sorted = true;
+	positions->has_range = positions->length > 0;
+	if (positions->has_range) {
+		positions->min.i = positions->data[0];
+		positions->max.i = positions->data[positions->length - 1];
+	}
+}
+
+void retain_vector(Vector* vec) {
+	if (!vec)
+		return;
+	pthread_mutex_lock(&pool_lock);
+	vec->ref_count++;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+// drops one reference; the last one returns the buffer to its chunk and recycles the header
+void release_vector(Vector* vec) {
+	if (!vec)
+		return;
+	pthread_mutex_lock(&pool_lock);
+	if (--vec->ref_count <= 0) {
+		// stats of a fetched vector are borrowed from its base column and not freed here
+		if (vec->chunk)
+			unuse_chunk(vec->chunk);
+		vec->data = NULL;
+		vec->chunk = NULL;
+		free_vectors[num_free_vectors++] = vec;
+	}
+	pthread_mutex_unlock(&pool_lock);
+}
+
+Result* alloc_result() {
+	return calloc(1, sizeof(Result));
+}
+
+void retain_result(Result* result) {
+	if (!result)
+		return;
+	pthread_mutex_lock(&pool_lock);
+	result->ref_count++;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void release_result(Result* result) {
+	if (!result)
+		return;
+	pthread_mutex_lock(&pool_lock);
+	bool last = --result->ref_count <= 0;
+	pthread_mutex_unlock(&pool_lock);
+	if (!last)
+		return;
+	free(result->payload);
+	free(result);
+}
+
+void retain_generalized_column(GeneralizedColumn* gc) {
+	if (gc->column_type == RESULT)
+		retain_result(gc->column_pointer.result);
+	else
+		retain_vector(gc->column_pointer.vector);
+}
+
+void release_generalized_column(GeneralizedColumn* gc) {
+	if (gc->column_type == RESULT)
+		release_result(gc->column_pointer.result);
+	else
+		release_vector(gc->column_pointer.vector);
+	gc->column_pointer.vector = NULL;
+}
@@ -0,0 +1,162 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <sched.h>
+
+#include "client_context.h"
+#include "cs165_api.h"
+#include "index.h"
+#include "result_pool.h"
+#include "scan_share.h"
+#include "storage.h"
+
+/*
+ * Cross-client scan sharing.
+ * A range select that would scan an int column, issued while other clients wait for
+ * db_lock, is queued and yields db_lock once so that their selects can queue too. The
+ * first of them to take db_lock back answers every select queued on its column with one
+ * multi-predicate pass over the column. A queued select holds nothing but its range:
+ * which column it reads, and whether it can still be scanned, is decided under db_lock.
+ */
+
+static pthread_mutex_t db_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// clients holding or waiting for db_lock
+static pthread_mutex_t waiting_lock = PTHREAD_MUTEX_INITIALIZER;
+static int num_waiting;
+
+typedef struct QueuedSelect {
+	Column* column;
+	int low;
+	int high;
+	Vector* result;
+	bool done;
+	bool shared; // answered together with other selects
+	struct QueuedSelect* next;
+} QueuedSelect;
+
+// selects not answered yet; guarded by db_lock
+static QueuedSelect* queued_selects;
+
+void lock_db(void) {
+	pthread_mutex_lock(&waiting_lock);
+	num_waiting++;
+	pthread_mutex_unlock(&waiting_lock);
+	pthread_mutex_lock(&db_lock);
+}
+
+void unlock_db(void) {
+	pthread_mutex_lock(&waiting_lock);
+	num_waiting--;
+	pthread_mutex_unlock(&waiting_lock);
+	pthread_mutex_unlock(&db_lock);
+}
+
+// whether a client other than the one holding db_lock waits for it
+static bool others_waiting(void) {
+	pthread_mutex_lock(&waiting_lock);
+	bool waiting = num_waiting > 1;
+	pthread_mutex_unlock(&waiting_lock);
+	return waiting;
+}
+
+// whether the select would scan an int column that has no pending deletes
+static bool shareable(DbOperator* query) {
+	if (query->type != SELECT)
+		return false;
+	SelectOperator* op = &query->operator_fields.select_operator;
+	Column* col = op->column;
+	return col && col->type == INT && col->num_deleted == 0
+		&& choose_access_path(col, op->low.i, op->high.i) == SCAN;
+}
+
+// takes the queued selects of col, at most MAX_SHARED_SCAN_OPS, off the queue
+static int dequeue_selects(Column* col, QueuedSelect** selects) {
+	int num_selects = 0;
+	QueuedSelect** link = &queued_selects;
+	while (*link && num_selects < MAX_SHARED_SCAN_OPS) {
+		if ((*link)->column == col) {
+			selects[num_selects++] = *link;
+			*link = (*link)->next;
+		} else {
+			link = &(*link)->next;
+		}
+	}
+	return num_selects;
+}
+
+// answers selects over col with one pass; the column may have changed since they queued
+static void run_scan(Column* col, QueuedSelect** selects, int num_selects) {
+	Status status;
+	status.code = OK;
+	if (col->num_deleted > 0) {
+		// deleted positions are only dropped by the regular select
+		for (int i = 0; i < num_selects; i++) {
+			Value low = {.i = selects[i]->low};
+			Value high = {.i = selects[i]->high};
+			selects[i]->result = select_all(col, low, high, NULL, &status);
+		}
+		return;
+	}
+
+	int lows[MAX_SHARED_SCAN_OPS];
+	int highs[MAX_SHARED_SCAN_OPS];
+	for (int i = 0; i < num_selects; i++) {
+		lows[i] = selects[i]->low;
+		highs[i] = selects[i]->high;
+	}
+	if (col->compression == UNCOMPRESSED)
+		refresh_zones(col);
+	Vector** results = select_batch(col, lows, highs, num_selects, &status);
+	if (!results)
+		return;
+	for (int i = 0; i < num_selects; i++)
+		selects[i]->result = results[i];
+	free(results);
+}
+
+static char* execute_shared_select(DbOperator* query) {
+	SelectOperator op = query->operator_fields.select_operator;
+	QueuedSelect select = {
+		.column = op.column,
+		.low = op.low.i,
+		.high = op.high.i,
+		.next = queued_selects,
+	};
+	queued_selects = &select;
+
+	// lets the clients waiting for db_lock queue their selects; db_lock is taken back
+	// without leaving the clients that wait for it
+	pthread_mutex_unlock(&db_lock);
+	sched_yield();
+	pthread_mutex_lock(&db_lock);
+
+	if (!select.done) {
+		QueuedSelect* selects[MAX_SHARED_SCAN_OPS];
+		int num_selects = dequeue_selects(select.column, selects);
+		if (current_db)
+			run_scan(select.column, selects, num_selects);
+		for (int i = 0; i < num_selects; i++) {
+			selects[i]->shared = num_selects > 1;
+			selects[i]->done = true;
+		}
+	}
+
+	if (!select.result)
+		return "-- Error: could not execute select";
+	if (!assign_vector_to_handle(select.result, op.result_handle, query->context)) {
+		release_vector(select.result);
+		return "-- Error in assigning select result to client context";
+	}
+	return select.shared ? "-- Select executed (shared scan)" : "-- Select executed (scan)";
+}
+
+/*
+ * execute_client_operator(DbOperator* query)
+ * Executes a client's operator, which must hold db_lock. Selects that would scan an int
+ * column are answered by a scan shared with the selects of other clients waiting for it.
+ */
+char* execute_client_operator(DbOperator* query) {
+	if (query && current_db && shareable(query) && others_waiting())
+		return execute_shared_select(query);
+	return execute_db_operator(query);
+}
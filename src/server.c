@@ -14,6 +14,9 @@
  **/
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/un.h>
@@ -29,6 +32,7 @@
 #include "message.h"
 #include "utils.h"
 #include "client_context.h"
+#include "scan_share.h"
 
 #define DEFAULT_QUERY_BUFFER_SIZE 1024
 
@@ -38,8 +42,6 @@ typedef enum mode {
 	BATCH
 } mode;
 
-static mode current_mode = DEFAULT;
-
 /*
  * create_client_context()
  * Creates client context and returns pointer to it
@@ -50,9 +52,13 @@ ClientContext* create_client_context() {
 		return NULL;
 	}
 	context->chandles_in_use = 0;
-	context->chandle_slots = MAX_NUM_HANDLES;
-	context->chandle_table = (GeneralizedColumnHandle*) malloc(sizeof(GeneralizedColumnHandle)
-			* context->chandle_slots);
+	context->chandle_slots = HANDLE_MAP_BASE_CAPACITY;
+	context->chandle_table = (GeneralizedColumnHandle*) calloc(context->chandle_slots,
+			sizeof(GeneralizedColumnHandle));
+	if (!context->chandle_table) {
+		free(context);
+		return NULL;
+	}
 	return context;
 }
 
@@ -84,7 +90,8 @@ int send_result(int client_socket, message send_message, char* result) {
 	return 0;
 }
 
-int handle_client_default(int client_socket, ClientContext* client_context) {
+int handle_client_default(int client_socket, ClientContext* client_context,
+		mode* current_mode) {
 	message recv_message;
 	int length = recv(client_socket, &recv_message, sizeof(message), 0);
 	if (length <=  0) {
@@ -103,32 +110,36 @@ int handle_client_default(int client_socket, ClientContext* client_context) {
 	int shutdown = 0;
 	if (strncmp(recv_message.payload.text, BEGIN_LOAD_MESSAGE, 
 				strlen(BEGIN_LOAD_MESSAGE)) == 0) {
-		current_mode = LOAD;
+		*current_mode = LOAD;
 		result = "-- Load message received!";
 		send_message.status = OK_BEGIN_LOAD;
 	} else if (strncmp(recv_message.payload.text, BEGIN_BATCH_MESSAGE, 
 				strlen(BEGIN_BATCH_MESSAGE)) == 0) {
-		current_mode = BATCH;
+		*current_mode = BATCH;
 		result = "-- Batching operators!";
 	} else {
 		// Parse command
+		lock_db();
 		DbOperator* query = parse_command(recv_message.payload.text, &send_message, 
 				client_socket, client_context);
 		if (query) {
 			shutdown = query->type == SHUTDOWN ? 1 : 0;
-			result = execute_db_operator(query);
+			result = execute_client_operator(query);
 			db_operator_free(query);
 		}
+		unlock_db();
 	}
-	send_result(client_socket, send_message, result);
+	// a client that stopped reading has disconnected
+	int r = send_result(client_socket, send_message, result);
 	if (shutdown) {
 		exit(0);
 	}
 
-	return 0;
+	return r;
 }
 
-int handle_client_batch(int client_socket, ClientContext* client_context, BatchOperator* batch) {
+int handle_client_batch(int client_socket, ClientContext* client_context, BatchOperator* batch,
+		mode* current_mode) {
 	message recv_message;
 	int length = recv(client_socket, &recv_message, sizeof(message), 0);
 	if (length <=  0) {
@@ -147,23 +158,25 @@ int handle_client_batch(int client_socket, ClientContext* client_context, BatchO
 
 	if (strncmp(recv_message.payload.text, EXECUTE_BATCH_MESSAGE,
 				strlen(EXECUTE_BATCH_MESSAGE)) == 0) {
+		lock_db();
 		result = execute_db_batch(batch);
-		current_mode = DEFAULT;
+		unlock_db();
+		*current_mode = DEFAULT;
 	} else {
-		// Collect DbOperators into operators batch_ops
+		// Collect DbOperators into operators batch_ops; scheduling looks up base columns
+		lock_db();
 		DbOperator* op = parse_command(recv_message.payload.text, &send_message, 
 				client_socket, client_context);
 		int r = handle_db_operator(op, batch);
+		unlock_db();
 		result = "-- Batch operator received";
 		if (r < 0) 
 			result = "-- Could not collect batch operator";
 	}
-	send_result(client_socket, send_message, result);
-
-	return 0;
+	return send_result(client_socket, send_message, result);
 }
 
-int handle_client_load(int client_socket) {
+int handle_client_load(int client_socket, mode* current_mode) {
 	log_err("LOADING!\n"); // for debugging testing server
 	message recv_message, send_message;
 	int length_received = recv(client_socket, &recv_message, sizeof(message), 0);
@@ -172,7 +185,8 @@ int handle_client_load(int client_socket) {
 		return 1;
 	} 
 
-	char* header_line = malloc(recv_message.length);
+	// the header is not sent with a terminator
+	char* header_line = malloc(recv_message.length + 1);
 	length_received = recv(client_socket, header_line, recv_message.length, 0);
 	if (length_received < 0) {
 		log_err("Client connection closed!\n");
@@ -180,6 +194,7 @@ int handle_client_load(int client_socket) {
 	} else if (length_received == 0) {
 		return -1;
 	} 
+	header_line[length_received] = '\0';
 
 	send_message.status = OK_WAIT_FOR_RESPONSE;
 	send_message.payload.text = "-- Beginning load...";
@@ -195,7 +210,7 @@ int handle_client_load(int client_socket) {
 
 	int total_length_received = 0;
 	int buf_capacity = DEFAULT_LOAD_BUFFER_LENGTH;
-	int* buf = malloc(buf_capacity);
+	char* buf = malloc(buf_capacity); // csv text, parsed by load
 	if (!buf) {
 		log_err("Could not allocate buffer for receiving data for load.\n");
 	}
@@ -205,7 +220,7 @@ int handle_client_load(int client_socket) {
 			|| recv_message.status == OK_DONE)) {
 
 		if (recv_message.length + total_length_received >= buf_capacity) {
-			int* new_buf = realloc(buf, buf_capacity * 2);
+			char* new_buf = realloc(buf, buf_capacity * 2);
 			if (!new_buf) {
 				log_err("Could not reallocate buffer for receiving data for load.\n");
 			}
@@ -213,7 +228,7 @@ int handle_client_load(int client_socket) {
 			buf_capacity *= 2;
 		}
 
-		length_received = recv(client_socket, (char*) buf + total_length_received, 
+		length_received = recv(client_socket, buf + total_length_received, 
 				recv_message.length, 0);
 		if (length_received <= 0) {
 			log_err("Error in receiving load data.\n");
@@ -259,13 +274,16 @@ int handle_client_load(int client_socket) {
 		return -1;
 	} 
 
-	Status load_status = load(header_line, buf, total_length_received / sizeof(int));
+	// the buffer always keeps a byte past the data for load's terminator
+	lock_db();
+	Status load_status = load(header_line, buf, total_length_received);
+	unlock_db();
 	if (load_status.code != OK) {
 		log_err("Error occured when loading the database.\n");
 		return -1;
 	}
 
-	current_mode = DEFAULT;
+	*current_mode = DEFAULT;
 	free(buf);
 	free(header_line);
 	return 0;
@@ -293,24 +311,35 @@ void handle_client(int client_socket) {
 	if (r < 0)
 		log_err("Could not allocate batch operator");
 
+	mode current_mode = DEFAULT;
     do {
 		switch (current_mode) {
 			case LOAD:
-				done = handle_client_load(client_socket);
+				done = handle_client_load(client_socket, &current_mode);
 				break;
 			case BATCH:
-				done = handle_client_batch(client_socket, client_context, &batch);
+				done = handle_client_batch(client_socket, client_context, &batch,
+						&current_mode);
 				break;
 			default:
-				done = handle_client_default(client_socket, client_context);
+				done = handle_client_default(client_socket, client_context, &current_mode);
 				break;
 		}
     } while (!done);
 
     log_info("Connection closed at socket %d!\n", client_socket);
+	lock_db();
+	free_client_context(client_context);
+	unlock_db();
     close(client_socket);
 }
 
+// pthread routine serving one client
+static void* run_client(void* client_socket) {
+	handle_client((int) (intptr_t) client_socket);
+	return NULL;
+}
+
 /**
  * setup_server()
  *
@@ -356,12 +385,13 @@ int setup_server() {
     return server_socket;
 }
 
-// Currently this main will setup the socket and accept a single client.
-// After handling the client, it will exit.
-// You will need to extend this to handle multiple concurrent clients
-// and remain running until it receives a shut-down command.
+// Sets up the socket and serves each client that connects on its own thread until a
+// client shuts the server down.
 int main(void)
 {
+	// a client disconnecting mid-reply must fail only its own send, not stop the server
+	signal(SIGPIPE, SIG_IGN);
+
 	// startup db
 	Status ret_status = db_startup();
 	if (ret_status.code != OK) {
@@ -387,7 +417,13 @@ int main(void)
 		}
 
 		// Handle client messages
-		handle_client(client_socket);
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, run_client, (void*) (intptr_t) client_socket) != 0) {
+			log_err("L%d: Failed to start a thread for a new connection.\n", __LINE__);
+			close(client_socket);
+			continue;
+		}
+		pthread_detach(thread);
 	}
 
     return 0;
@@ -0,0 +1,190 @@
+#include <math.h>
+#include <string.h>
+
+#include "compression.h"
+#include "cs165_api.h"
+#include "db_core_utils.h"
+#include "statistics.h"
+#include "utils.h"
+
+// 64-bit finalizer (splitmix64) so that nearby ints spread over all HyperLogLog registers
+static uint64_t hash_value(int value) {
+	uint64_t x = (uint32_t) value;
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+static void hll_add(uint8_t* registers, int value) {
+	uint64_t h = hash_value(value);
+	int reg = h >> (64 - HLL_PRECISION);
+	uint64_t rest = h << HLL_PRECISION;
+
+	// rank is the position of the first set bit in the remaining bits
+	uint8_t rank = 1;
+	while (rank <= 64 - HLL_PRECISION && !(rest & (1ULL << 63))) {
+		rest <<= 1;
+		rank++;
+	}
+	if (rank > registers[reg])
+		registers[reg] = rank;
+}
+
+static double hll_estimate(uint8_t* registers) {
+	double m = HLL_NUM_REGISTERS;
+	double sum = 0;
+	int zeros = 0;
+	for (int i = 0; i < HLL_NUM_REGISTERS; i++) {
+		sum += ldexp(1.0, -registers[i]);
+		if (registers[i] == 0)
+			zeros++;
+	}
+
+	double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+	if (estimate <= 2.5 * m && zeros > 0) // small range correction
+		estimate = m * log(m / zeros);
+	return estimate;
+}
+
+/*
+ * compute_column_stats(Column* col)
+ * Computes min/max and a HyperLogLog distinct count over all values of the column and an
+ * equi-depth histogram over an evenly spaced sample, replacing any previous statistics.
+ */
+Status compute_column_stats(Column* col) {
+	Status ret_status;
+	ColumnStats* stats = col->stats;
+	if (!stats) {
+		stats = malloc(sizeof *stats);
+		if (!stats) {
+			ret_status.code = ERROR;
+			return ret_status;
+		}
+		col->stats = stats;
+	}
+	memset(stats, 0, sizeof *stats);
+	stats->num_rows = col->length;
+	if (col->length == 0) {
+		ret_status.code = OK;
+		return ret_status;
+	}
+
+	int block[DECODE_BLOCK_SIZE];
+	stats->min = stats->max = col->compression == UNCOMPRESSED ? col->data[0] : col->compressed->min;
+	for (size_t i = 0; i < col->length; i += DECODE_BLOCK_SIZE) {
+		size_t n = col->length - i < DECODE_BLOCK_SIZE ? col->length - i : DECODE_BLOCK_SIZE;
+		decode_range(col, i, n, block);
+		for (size_t j = 0; j < n; j++) {
+			if (block[j] < stats->min)
+				stats->min = block[j];
+			if (block[j] > stats->max)
+				stats->max = block[j];
+			hll_add(stats->hll, block[j]);
+		}
+	}
+	stats->num_distinct = hll_estimate(stats->hll);
+	if (stats->num_distinct > col->length)
+		stats->num_distinct = col->length;
+
+	int num_samples = col->length < STATS_SAMPLE_SIZE ? (int) col->length : STATS_SAMPLE_SIZE;
+	int* sample = malloc(sizeof *sample * num_samples);
+	if (!sample) {
+		ret_status.code = ERROR;
+		return ret_status;
+	}
+	double stride = (double) col->length / num_samples;
+	for (int i = 0; i < num_samples; i++)
+		decode_range(col, (size_t) (i * stride), 1, &sample[i]);
+	qsort(sample, num_samples, sizeof *sample, compare_ints);
+
+	stats->bounds[0] = stats->min;
+	for (int b = 1; b < STATS_NUM_BUCKETS; b++)
+		stats->bounds[b] = sample[(long) b * num_samples / STATS_NUM_BUCKETS];
+	stats->bounds[STATS_NUM_BUCKETS] = stats->max;
+	free(sample);
+
+	log_info("COMPUTED STATISTICS FOR COLUMN %s: min %d, max %d, ~%.0f distinct\n", col->name,
+			stats->min, stats->max, stats->num_distinct);
+	ret_status.code = OK;
+	return ret_status;
+}
+
+// statistics are kept for int columns only
+Status analyze_table(Table* table) {
+	Status ret_status;
+	for (size_t i = 0; i < table->columns_size; i++) {
+		if (table->columns[i].type != INT)
+			continue;
+		ret_status = compute_column_stats(&table->columns[i]);
+		if (ret_status.code != OK) {
+			log_err("Could not compute statistics for column %s.\n", table->columns[i].name);
+			return ret_status;
+		}
+	}
+	ret_status.code = OK;
+	return ret_status;
+}
+
+// counts values of col that were inserted, updated or deleted towards its statistics
+void record_column_changes(Column* col, size_t num_values) {
+	if (col->stats)
+		col->stats->num_changed += num_values;
+}
+
+// statistics are recomputed once more than 10% of the column has changed, whether or not
+// its length has
+bool column_stats_stale(Column* col) {
+	if (!col->stats)
+		return true;
+	size_t n = col->stats->num_rows;
+	size_t diff = col->length > n ? col->length - n : n - col->length;
+	return diff * 10 > n || col->stats->num_changed * 10 > n;
+}
+
+// estimated fraction of values < x, interpolating linearly within a histogram bucket
+static double estimate_fraction_below(ColumnStats* stats, long x) {
+	int b = lower_bound(stats->bounds, STATS_NUM_BUCKETS + 1, x);
+	if (b == 0)
+		return 0;
+	if (b > STATS_NUM_BUCKETS)
+		return 1;
+
+	double lo = stats->bounds[b - 1];
+	double hi = stats->bounds[b];
+	return (b - 1 + (x - lo) / (hi - lo)) / STATS_NUM_BUCKETS;
+}
+
+/*
+ * estimate_selectivity(ColumnStats* stats, int low, int high)
+ * Returns the estimated fraction of rows with low <= value < high.
+ */
+double estimate_selectivity(ColumnStats* stats, int low, int high) {
+	if (!stats || stats->num_rows == 0 || high <= low)
+		return 0;
+
+	return estimate_fraction_below(stats, high) - estimate_fraction_below(stats, low);
+}
+
+/*
+ * estimate_distinct(Vector* values)
+ * Estimates the number of distinct values in a base column or in a vector fetched from
+ * one. A fetched vector of k values drawn from a column with d distinct values is expected
+ * to hold d * (1 - e^(-k/d)) of them. Without statistics every value is assumed distinct.
+ */
+double estimate_distinct(Vector* values) {
+	ColumnStats* stats = values->stats;
+	if (!stats || stats->num_distinct < 1)
+		return values->length;
+
+	double k = values->length;
+	double d = stats->num_distinct;
+	if (k >= stats->num_rows)
+		return d;
+	double estimate = d * (1 - exp(-k / d));
+	return estimate < 1 ? 1 : estimate;
+}
+
+void free_column_stats(ColumnStats* stats) {
+	free(stats);
+}
@@ -0,0 +1,187 @@
+#define _DEFAULT_SOURCE
+#include <string.h>
+#include <sys/mman.h>
+
+#include "cs165_api.h"
+#include "data_types.h"
+#include "storage.h"
+#include "utils.h"
+
+/*
+ * Base column storage.
+ * Each column reserves one contiguous range of address space large enough for any column
+ * and commits it a segment at a time as the column grows. Appends therefore never move
+ * existing values: there is no realloc copy, no transient 2-3x footprint, and pointers
+ * into the data (clustered index arrays, views) stay valid. Reserved but uncommitted
+ * memory costs no RAM.
+ *
+ * Scans walk the column segment by segment and keep a zone map of each segment's bounds,
+ * skipping segments that cannot match a predicate and copying out whole segments that
+ * match entirely.
+ */
+
+static size_t round_up_segments(size_t values) {
+	size_t segments = (values + COLUMN_SEGMENT_VALUES - 1) / COLUMN_SEGMENT_VALUES;
+	return (segments > 0 ? segments : 1) * COLUMN_SEGMENT_VALUES;
+}
+
+// reserves address space for up to *values values of width bytes, halving the request if
+// the process is not allowed that much; returns the huge page aligned start or NULL
+static char* reserve_range(size_t* values, size_t width) {
+	for (; *values >= COLUMN_SEGMENT_VALUES; *values /= 2) {
+		size_t bytes = *values * width;
+		char* range = mmap(NULL, bytes + HUGE_PAGE_SIZE, PROT_NONE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (range == MAP_FAILED)
+			continue;
+
+		// unmap the slack around the aligned range
+		char* start = (char*) (((uintptr_t) range + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+		if (start > range)
+			munmap(range, start - range);
+		munmap(start + bytes, range + HUGE_PAGE_SIZE - start);
+#ifdef MADV_HUGEPAGE
+		madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+		return start;
+	}
+	return NULL;
+}
+
+/*
+ * alloc_column_data(Column* col, size_t capacity)
+ * Reserves the address range of col's data and commits room for at least capacity values.
+ * Replaces any data col had. Returns 0 on success, -1 otherwise.
+ */
+int alloc_column_data(Column* col, size_t capacity) {
+	free_column_data(col);
+
+	size_t width = data_type_size(col->type);
+	size_t reserved = COLUMN_RESERVED_VALUES;
+	char* data = reserve_range(&reserved, width);
+	if (!data) {
+		log_err("Could not reserve memory for column %s.\n", col->name);
+		return -1;
+	}
+
+	col->data = (int*) data;
+	col->reserved = reserved;
+	col->capacity = 0;
+	if (grow_column_data(col, capacity) < 0) {
+		free_column_data(col);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * grow_column_data(Column* col, size_t capacity)
+ * Commits whole segments until col has room for capacity values. The data stays in place.
+ * Returns 0 on success, -1 if the reservation is exhausted or memory cannot be committed.
+ */
+int grow_column_data(Column* col, size_t capacity) {
+	if (capacity <= col->capacity)
+		return 0;
+	capacity = round_up_segments(capacity);
+	if (capacity > col->reserved) {
+		log_err("Column %s is full; it can hold %zu values.\n", col->name, col->reserved);
+		return -1;
+	}
+
+	size_t width = data_type_size(col->type);
+	char* data = (char*) col->data;
+	if (mprotect(data + col->capacity * width, (capacity - col->capacity) * width,
+				PROT_READ | PROT_WRITE) != 0) {
+		log_err("Could not commit memory for column %s.\n", col->name);
+		return -1;
+	}
+	col->capacity = capacity;
+	return 0;
+}
+
+void free_column_data(Column* col) {
+	if (col->data)
+		munmap(col->data, col->reserved * data_type_size(col->type));
+	col->data = NULL;
+	col->capacity = 0;
+	col->reserved = 0;
+	free(col->zones);
+	col->zones = NULL;
+	col->num_zones = 0;
+	col->zones_capacity = 0;
+}
+
+// marks the zone maps of the segment holding position and all later ones as out of date
+// and bumps the column's version; called whenever values of the column change
+void invalidate_zones(Column* col, size_t position) {
+	col->version++;
+	size_t segment = position / COLUMN_SEGMENT_VALUES;
+	if (segment < col->num_zones)
+		col->num_zones = segment;
+}
+
+/*
+ * refresh_zones(Column* col)
+ * Recomputes the zone maps of every segment that is out of date.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int refresh_zones(Column* col) {
+	size_t num_segments = (col->length + COLUMN_SEGMENT_VALUES - 1) / COLUMN_SEGMENT_VALUES;
+	if (num_segments > col->zones_capacity) {
+		ZoneMap* zones = realloc(col->zones, sizeof *zones * num_segments);
+		if (!zones)
+			return -1;
+		col->zones = zones;
+		col->zones_capacity = num_segments;
+	}
+
+	Vector values = column_vector(col);
+	for (size_t s = col->num_zones; s < num_segments; s++) {
+		size_t start = s * COLUMN_SEGMENT_VALUES;
+		Vector segment = values;
+		segment.data = (int*) ((char*) col->data + start * data_type_size(col->type));
+		segment.length = col->length - start < COLUMN_SEGMENT_VALUES
+			? col->length - start : COLUMN_SEGMENT_VALUES;
+		col->zones[s].min = min_value(&segment);
+		col->zones[s].max = max_value(&segment);
+	}
+	col->num_zones = num_segments;
+	return 0;
+}
+
+// whether the segment may hold values in [low, high); zone maps must be current
+bool zone_may_match(Column* col, size_t segment, Value low, Value high) {
+	ZoneMap* zone = &col->zones[segment];
+	return compare_values(zone->max, low, col->type) >= 0
+		&& compare_values(zone->min, high, col->type) < 0;
+}
+
+/*
+ * select_segments(Column* col, Value low, Value high, int* out)
+ * Writes the positions of values in [low, high) of an uncompressed column to out and
+ * returns their count, scanning only the segments whose zone maps overlap the range.
+ */
+size_t select_segments(Column* col, Value low, Value high, int* out) {
+	Vector values = column_vector(col);
+	if (refresh_zones(col) < 0) // fall back to scanning everything
+		return select_scan(&values, low, high, out);
+
+	size_t k = 0;
+	for (size_t s = 0; s < col->num_zones; s++) {
+		if (!zone_may_match(col, s, low, high))
+			continue;
+
+		size_t start = s * COLUMN_SEGMENT_VALUES;
+		size_t end = col->length - start < COLUMN_SEGMENT_VALUES
+			? col->length : start + COLUMN_SEGMENT_VALUES;
+		ZoneMap* zone = &col->zones[s];
+		if (compare_values(zone->min, low, col->type) >= 0
+				&& compare_values(zone->max, high, col->type) < 0) {
+			for (size_t i = start; i < end; i++) // every value matches
+				out[k++] = i;
+		} else {
+			k += select_scan_range(&values, start, end, low, high, out + k);
+		}
+	}
+	return k;
+}
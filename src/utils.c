@@ -140,3 +140,12 @@ void log_info(const char *format, ...) {
 }
 
 
+
+uint32_t hash_string(const char* str) {
+    uint32_t h = 2166136261u;
+    for (; *str; str++) {
+        h ^= (unsigned char) *str;
+        h *= 16777619u;
+    }
+    return h;
+}